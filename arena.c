@@ -0,0 +1,61 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "arena.h"
+
+static uint32_t arena[ARENA_SIZE / sizeof(uint32_t)];
+static unsigned int arena_used;
+static unsigned int arena_max;
+
+void *
+arena_alloc(size_t size)
+{
+	void *p;
+
+	/* keep everything word aligned */
+	size = (size + 3) & ~3U;
+	if (size > ARENA_SIZE - arena_used)
+		return NULL;
+
+	p = (uint8_t *)arena + arena_used;
+	arena_used += size;
+	if (arena_used > arena_max)
+		arena_max = arena_used;
+	return p;
+}
+
+unsigned int
+arena_mark(void)
+{
+	return arena_used;
+}
+
+void
+arena_release(unsigned int mark)
+{
+	if (mark < arena_used)
+		arena_used = mark;
+}
+
+unsigned int
+arena_peak(void)
+{
+	return arena_max;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdlib.h>
+
+/*
+ * Scratch memory for apps. Allocations are cut off the
+ * end of one static region and given back all at once
+ * by releasing to a mark taken earlier.
+ *
+ * menu() marks before running an entry and releases when
+ * it returns, so an app can take its FATFS, FIL and path
+ * from here without ever freeing them. Helpers that only
+ * need a buffer while they run, like dp_showbmp(), mark
+ * and release around it themselves.
+ *
+ * Only use it from thread context, never from interrupts.
+ * arena_alloc() returns NULL when the arena is full, which
+ * FatFs users report as FR_NOT_ENOUGH_CORE.
+ *
+ * The deepest user is IR file sending: FATFS, FIL, path,
+ * the irpkt and a raw and a packed block come to 3152
+ * bytes. The Stack usage app shows the peak so far to
+ * check this against.
+ */
+#define ARENA_SIZE 3200
+
+void *arena_alloc(size_t size);
+unsigned int arena_mark(void);
+void arena_release(unsigned int mark);
+unsigned int arena_peak(void);
+
+#endif
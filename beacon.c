@@ -0,0 +1,260 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "power.h"
+#include "latency.h"
+#include "ir.h"
+#include "irframe.h"
+#include "uid.h"
+#include "beacon.h"
+
+#define BEACON_TYPE 0x28 /* 16bit id, 24bit ms since start */
+#define BEACON_LEN  6
+#define BEACON_RATE IR_9600
+
+enum {
+	BEACON_WAKE,
+	BEACON_SLEEP,
+};
+
+struct beacon_timer {
+	struct timer_node n;
+	uint16_t arg;
+	volatile bool armed;
+};
+
+static struct beacon_peer beacon_peers[BEACON_PEERS];
+static struct beacon_stats beacon_st;
+static struct irframe_rx beacon_rx;
+static uint32_t beacon_rand;
+static uint16_t beacon_id;
+
+static uint32_t
+ms_since(uint32_t start)
+{
+	return (timer_now() - start) & 0xFFFFFFU;
+}
+
+static void
+beacon_timer_cb(struct timer_node *n)
+{
+	struct beacon_timer *t = (struct beacon_timer *)n;
+
+	t->armed = false;
+	event_post(EV_BEACON, t->arg, 0);
+}
+
+static void
+beacon_timer(struct beacon_timer *t, uint32_t ms, uint16_t arg)
+{
+	t->n.timeout = timer_now() + ms;
+	t->n.cb = beacon_timer_cb;
+	t->arg = arg;
+	t->armed = true;
+	timer_add(&t->n);
+}
+
+/* the timer list is only safe to touch while the timer is in it */
+static void
+beacon_timer_stop(struct beacon_timer *t)
+{
+	irq_off();
+	if (t->armed)
+		timer_remove(&t->n);
+	t->armed = false;
+	irq_on();
+}
+
+/* interval +- 1/8 */
+static uint32_t
+beacon_jitter(uint32_t interval)
+{
+	uint32_t x = beacon_rand;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	beacon_rand = x;
+	return interval - interval / 8 + x % (interval / 4 + 1);
+}
+
+static void
+beacon_send(uint32_t start)
+{
+	uint8_t buf[IRFRAME_MAX + IRFRAME_OVERHEAD];
+	uint8_t msg[BEACON_LEN];
+	uint32_t ms = ms_since(start);
+	size_t len;
+	size_t i;
+
+	msg[0] = BEACON_TYPE;
+	msg[1] = beacon_id;
+	msg[2] = beacon_id >> 8;
+	msg[3] = ms;
+	msg[4] = ms >> 8;
+	msg[5] = ms >> 16;
+	len = irframe_encode(buf, msg, sizeof(msg));
+	for (i = 0; i < len; i++)
+		ir_send(buf[i]);
+	/* don't hear ourselves */
+	ir_tx_wait();
+	ir_rx_clear();
+}
+
+static struct beacon_peer *
+beacon_heard(const uint8_t *msg, uint32_t start)
+{
+	uint16_t id = msg[1] | msg[2] << 8;
+	uint32_t theirs = msg[3] | (uint32_t)msg[4] << 8 | (uint32_t)msg[5] << 16;
+	uint32_t ours = ms_since(start);
+	struct beacon_peer *p = NULL;
+	unsigned int i;
+
+	beacon_st.heard += 1;
+	for (i = 0; i < BEACON_PEERS; i++) {
+		if (beacon_peers[i].heard && beacon_peers[i].id == id) {
+			p = &beacon_peers[i];
+			goto out;
+		}
+	}
+	/* new peer, forget the one we heard from longest ago */
+	for (i = 0; i < BEACON_PEERS; i++) {
+		struct beacon_peer *q = &beacon_peers[i];
+
+		if (q->heard == 0) {
+			p = q;
+			break;
+		}
+		if (p == NULL || ms_since(q->last) > ms_since(p->last))
+			p = q;
+	}
+	p->id = id;
+	p->heard = 0;
+	/* we could have met since the later of us started */
+	p->latency = (theirs < ours) ? theirs : ours;
+	beacon_st.discovered += 1;
+	beacon_st.latency_total += p->latency;
+	if (p->latency > beacon_st.latency_max)
+		beacon_st.latency_max = p->latency;
+out:
+	p->heard += 1;
+	p->last = timer_now();
+	return p;
+}
+
+/*
+ * Runs until an event of type exit arrives, and
+ * calls cb when a peer is heard and after every
+ * listen window. Returns 0, or -1 right away if the
+ * window doesn't fit in the shortest time between
+ * wake ups, as a wake up must never find us awake.
+ */
+int
+beacon_run(const struct beacon_config *cfg, uint8_t exit, beacon_cb *cb)
+{
+	struct beacon_timer wake = { .armed = false, };
+	struct beacon_timer sleep = { .armed = false, };
+	uint32_t start = timer_now();
+	uint32_t woke = start;
+	bool awake = false;
+
+	if (cfg->window >= cfg->interval - cfg->interval / 8)
+		return -1;
+
+	memset(beacon_peers, 0, sizeof(beacon_peers));
+	memset(&beacon_st, 0, sizeof(beacon_st));
+	beacon_rand = DEVINFO->UNIQUEL ^ timer_cycles();
+	if (beacon_rand == 0)
+		beacon_rand = 0x2019;
+	beacon_id = uid16();
+	irframe_rx_init(&beacon_rx);
+
+	/* start out of step with anyone pressing go at the same time */
+	power_em2(true);
+	beacon_timer(&wake, beacon_jitter(cfg->interval) / 2, BEACON_WAKE);
+
+	while (1) {
+		struct event ev;
+		int ch;
+
+		event_pend(&ev);
+		if (ev.type == exit)
+			break;
+		if (ev.type == EV_BEACON && ev.arg == BEACON_WAKE) {
+			power_em2(false);
+			ir_init();
+			ir_rate(BEACON_RATE);
+			awake = true;
+			woke = timer_now();
+			beacon_st.wakeups += 1;
+			beacon_send(start);
+			beacon_timer(&sleep, cfg->window, BEACON_SLEEP);
+			beacon_timer(&wake, beacon_jitter(cfg->interval), BEACON_WAKE);
+			continue;
+		}
+		if (!awake)
+			continue;
+
+		while ((ch = ir_recv()) >= 0) {
+			const uint8_t *msg = beacon_rx.buf;
+
+			if (irframe_feed(&beacon_rx, ch) == BEACON_LEN && msg[0] == BEACON_TYPE)
+				cb(&beacon_st, beacon_heard(msg, start));
+		}
+
+		if (ev.type == EV_BEACON && ev.arg == BEACON_SLEEP) {
+			ir_uninit();
+			power_em2(true);
+			awake = false;
+			beacon_st.awake_ms += ms_since(woke);
+			beacon_st.ms = ms_since(start);
+			cb(&beacon_st, NULL);
+		}
+	}
+
+	beacon_timer_stop(&wake);
+	beacon_timer_stop(&sleep);
+	if (awake)
+		ir_uninit();
+	power_em2(false);
+	return 0;
+}
+
+/*
+ * Roughly how long two badges with this config take
+ * to find each other. Each window catches a beacon
+ * sent during it, and both ends listen, so about
+ * 2 * window / interval of the wake ups find the other.
+ */
+uint32_t
+beacon_expected(const struct beacon_config *cfg)
+{
+	uint32_t chance = 2U * cfg->window;
+
+	if (chance >= cfg->interval)
+		return cfg->interval / 2;
+	return (uint32_t)cfg->interval * cfg->interval / chance;
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BEACON_H
+#define _BEACON_H
+
+#include <stdint.h>
+
+/*
+ * Find other badges without keeping the IR receiver on.
+ *
+ * Every interval ms, give or take an eighth to keep two
+ * badges from staying in step, we wake up, send a short
+ * beacon and listen for window ms. The rest of the time
+ * the usart is off and the badge sleeps in EM2.
+ *
+ * Beacons carry how long the sender has been at it, so
+ * when two badges start next to each other the time to
+ * first hear the other is the discovery latency.
+ */
+#define BEACON_PEERS 8
+
+struct beacon_config {
+	uint16_t interval; /* ms between wake ups */
+	uint16_t window;   /* ms listening each time */
+};
+
+struct beacon_peer {
+	uint16_t id;      /* see uid.h */
+	uint32_t heard;
+	uint32_t last;    /* timer_now() when last heard */
+	uint32_t latency; /* ms until we first heard it */
+};
+
+struct beacon_stats {
+	uint32_t ms;        /* since beacon_run() */
+	uint32_t awake_ms;  /* with the receiver on */
+	uint32_t wakeups;
+	uint32_t heard;
+	uint32_t discovered;
+	uint32_t latency_total;
+	uint32_t latency_max;
+};
+
+/* peer is NULL after each listen window */
+typedef void beacon_cb(const struct beacon_stats *st,
+		const struct beacon_peer *peer);
+
+int beacon_run(const struct beacon_config *cfg, uint8_t exit, beacon_cb *cb);
+uint32_t beacon_expected(const struct beacon_config *cfg);
+
+#endif
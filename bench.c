@@ -0,0 +1,367 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "bus.h"
+#include "sdcard.h"
+#include "ff.h"
+#include "arena.h"
+#include "ramfunc.h"
+
+/*
+ * Time the things that make the badge feel slow so
+ * badges, cards and firmware builds can be compared
+ * in the field with the same numbers. Everything is
+ * timed with the RTC and repeated enough times that
+ * the millisecond resolution doesn't matter.
+ *
+ * "Run and save" appends a line to BENCH_FILE on the
+ * card with the chip id, the numbers and the build date.
+ * "Flash vs RAM" runs the same numbers with the flash
+ * and RAM copies of the loops in ramfunc.h.
+ */
+
+#define FG444 0xCB0
+#define BG444 0x000
+
+#define BENCH_FILE "BENCH.TXT"
+#define BENCH_BMP  "LOGO.BMP"
+
+#define FILL_RUNS  8
+#define PUTS_RUNS  4
+#define LOGO_RUNS  8
+#define OPEN_RUNS  8
+#define SD_BLOCKS  128
+
+enum events {
+	EV_EXIT = 1,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+struct results {
+	uint32_t fill_ms;   /* one full screen dp_fill */
+	uint32_t puts_cps;  /* dp_puts characters per second */
+	uint32_t logo_ms;   /* one dp_cimage of the logo */
+	uint32_t sd_kbps;   /* raw sd_readblock */
+	uint32_t open_us;   /* one f_open + f_close of BENCH_BMP */
+	uint32_t read_kbps; /* f_read of all of BENCH_BMP */
+	uint32_t bmp_ms;    /* dp_showbmp_at of BENCH_BMP */
+	FRESULT fr;
+};
+
+extern const struct dp_cimage logo;
+
+static uint32_t
+ms_since(uint32_t start)
+{
+	uint32_t ms = (timer_now() - start) & 0xFFFFFFU;
+
+	return ms ? ms : 1;
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+bench_display(struct results *r)
+{
+	static const char text[] = "0123456789abcdefghij";
+	unsigned int lines = 240 / font.height;
+	unsigned int i, j;
+	uint32_t start;
+
+	start = timer_now();
+	for (i = 0; i < FILL_RUNS; i++)
+		dp_fill(0, 0, 240, 240, (i & 1) ? 0xFFF : 0x000);
+	r->fill_ms = ms_since(start) / FILL_RUNS;
+
+	start = timer_now();
+	for (i = 0; i < PUTS_RUNS; i++) {
+		for (j = 0; j < lines; j++)
+			dp_puts(0, j * font.height, FG444, BG444, text);
+	}
+	r->puts_cps = PUTS_RUNS * lines * (ARRAY_SIZE(text) - 1)
+		* 1000 / ms_since(start);
+
+	dp_fill(0, 0, 240, 240, 0x000);
+	start = timer_now();
+	for (i = 0; i < LOGO_RUNS; i++)
+		dp_cimage(0, 10, &logo);
+	r->logo_ms = ms_since(start) / LOGO_RUNS;
+}
+
+static FRESULT
+bench_sdraw(struct results *r)
+{
+	uint8_t buf[512];
+	uint32_t start;
+	uint32_t lba;
+	uint8_t ret = 0;
+
+	bus_acquire(BUS_SD);
+	start = timer_now();
+	for (lba = 0; lba < SD_BLOCKS; lba++) {
+		ret = sd_readblock(lba, buf);
+		if (ret != 0x00)
+			break;
+	}
+	r->sd_kbps = SD_BLOCKS * 512 / ms_since(start);
+	bus_release(BUS_SD);
+
+	return ret ? FR_DISK_ERR : FR_OK;
+}
+
+static FRESULT
+bench_fatfs(struct results *r)
+{
+	uint8_t buf[512];
+	FIL f;
+	FRESULT res;
+	uint32_t start;
+	uint32_t bytes = 0;
+	unsigned int i;
+	UINT len;
+
+	start = timer_now();
+	for (i = 0; i < OPEN_RUNS; i++) {
+		res = f_open(&f, BENCH_BMP, FA_READ);
+		if (res != FR_OK)
+			return res;
+		f_close(&f);
+	}
+	r->open_us = ms_since(start) * 1000 / OPEN_RUNS;
+
+	res = f_open(&f, BENCH_BMP, FA_READ);
+	if (res != FR_OK)
+		return res;
+	start = timer_now();
+	do {
+		res = f_read(&f, buf, sizeof(buf), &len);
+		bytes += len;
+	} while (res == FR_OK && len == sizeof(buf));
+	r->read_kbps = bytes / ms_since(start);
+	f_close(&f);
+	if (res != FR_OK)
+		return res;
+
+	dp_fill(0, 0, 240, 240, 0x000);
+	start = timer_now();
+	res = dp_showbmp_at(BENCH_BMP, 0, 0);
+	r->bmp_ms = ms_since(start);
+	return res;
+}
+
+static FRESULT
+bench_save(const struct results *r)
+{
+	char buf[160];
+	FIL f;
+	FRESULT res;
+	UINT len;
+
+	res = f_open(&f, BENCH_FILE, FA_OPEN_APPEND | FA_WRITE);
+	if (res != FR_OK)
+		return res;
+
+	len = sprintf(buf, "%08lx%08lx fill=%lu puts=%lu logo=%lu"
+			" sd=%lu open=%lu read=%lu bmp=%lu "
+			__DATE__ " " __TIME__ "\r\n",
+			(unsigned long)DEVINFO->UNIQUEH,
+			(unsigned long)DEVINFO->UNIQUEL,
+			(unsigned long)r->fill_ms,
+			(unsigned long)r->puts_cps,
+			(unsigned long)r->logo_ms,
+			(unsigned long)r->sd_kbps,
+			(unsigned long)r->open_us,
+			(unsigned long)r->read_kbps,
+			(unsigned long)r->bmp_ms);
+	res = f_write(&f, buf, len, &len);
+	if (res != FR_OK) {
+		f_close(&f);
+		return res;
+	}
+	return f_close(&f);
+}
+
+static void
+bench_run(bool save)
+{
+	struct results r = {};
+	struct event ev;
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	char buf[24];
+
+	bench_display(&r);
+
+	sd_init();
+	r.fr = fs ? f_mount(fs, "", 1) : FR_NOT_ENOUGH_CORE;
+	if (r.fr == FR_OK)
+		r.fr = bench_sdraw(&r);
+	if (r.fr == FR_OK)
+		r.fr = bench_fatfs(&r);
+	if (r.fr == FR_OK && save)
+		r.fr = bench_save(&r);
+	sd_uninit();
+
+	dp_fill(0, 0, 240, 240, BG444);
+	show(0, "Benchmarks");
+	sprintf(buf, "fill   %5lu ms", (unsigned long)r.fill_ms);
+	show(2, buf);
+	sprintf(buf, "puts   %5lu ch/s", (unsigned long)r.puts_cps);
+	show(3, buf);
+	sprintf(buf, "logo   %5lu ms", (unsigned long)r.logo_ms);
+	show(4, buf);
+	sprintf(buf, "sd raw %5lu kB/s", (unsigned long)r.sd_kbps);
+	show(5, buf);
+	sprintf(buf, "f_open %5lu us", (unsigned long)r.open_us);
+	show(6, buf);
+	sprintf(buf, "f_read %5lu kB/s", (unsigned long)r.read_kbps);
+	show(7, buf);
+	sprintf(buf, "bmp    %5lu ms", (unsigned long)r.bmp_ms);
+	show(8, buf);
+	if (r.fr != FR_OK) {
+		sprintf(buf, "SD error: %u", r.fr);
+		show(9, buf);
+	} else if (save)
+		show(9, "Saved " BENCH_FILE);
+
+	/* don't let presses during the run skip the results */
+	buttons_config(buttons);
+	while (event_poll(&ev))
+		/* drain */;
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+}
+
+#if RAMFUNC
+static void
+bench_ramfunc_show(unsigned int line, const char *name, enum ramfunc_id id,
+		uint32_t flash, uint32_t ram, bool rate, const char *unit)
+{
+	char buf[24];
+	long gain = 0;
+
+	/* higher rates and shorter times are better */
+	if (rate && flash)
+		gain = ((long)ram - (long)flash) * 100 / (long)flash;
+	else if (!rate && ram)
+		gain = ((long)flash - (long)ram) * 100 / (long)ram;
+
+	sprintf(buf, "%-8s%+4ld%% %3uB", name, gain, ramfunc_budget[id]);
+	show(line, buf);
+	sprintf(buf, "  %lu > %lu %s",
+			(unsigned long)flash, (unsigned long)ram, unit);
+	show(line + 1, buf);
+}
+
+static void
+bench_ramfunc(void)
+{
+	struct results flash = {};
+	struct results ram = {};
+	struct event ev;
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	FRESULT fr = FR_NOT_ENOUGH_CORE;
+
+	sd_init();
+	if (fs)
+		fr = f_mount(fs, "", 1);
+
+	ramfunc_flash = true;
+	bench_display(&flash);
+	if (fr == FR_OK)
+		fr = bench_sdraw(&flash);
+
+	ramfunc_flash = false;
+	bench_display(&ram);
+	if (fr == FR_OK)
+		fr = bench_sdraw(&ram);
+	sd_uninit();
+
+	dp_fill(0, 0, 240, 240, BG444);
+	show(0, "Flash > RAM");
+	bench_ramfunc_show(1, "fill", RAMFUNC_dp__fill_pixels,
+			flash.fill_ms, ram.fill_ms, false, "ms");
+	bench_ramfunc_show(3, "puts", RAMFUNC_dp__putchar_pixels,
+			flash.puts_cps, ram.puts_cps, true, "ch/s");
+	bench_ramfunc_show(5, "logo", RAMFUNC_dp__cimage_pixels,
+			flash.logo_ms, ram.logo_ms, false, "ms");
+	if (fr == FR_OK)
+		bench_ramfunc_show(7, "sd raw", RAMFUNC_sd__rxblock,
+				flash.sd_kbps, ram.sd_kbps, true, "kB/s");
+	else {
+		char buf[24];
+
+		sprintf(buf, "SD error: %u", fr);
+		show(7, buf);
+	}
+
+	buttons_config(buttons);
+	while (event_poll(&ev))
+		/* drain */;
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+}
+#endif
+
+static void
+bench_show(void)
+{
+	bench_run(false);
+}
+
+static void
+bench_save_run(void)
+{
+	bench_run(true);
+}
+
+void
+benchmarks(void)
+{
+	static const struct menuitem bench_menu[] = {
+		{ .label = "Run",          .cb = bench_show, },
+		{ .label = "Run and save", .cb = bench_save_run, },
+#if RAMFUNC
+		{ .label = "Flash vs RAM", .cb = bench_ramfunc, },
+#endif
+	};
+
+	menu(bench_menu, ARRAY_SIZE(bench_menu), FG444, BG444);
+}
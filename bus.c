@@ -0,0 +1,147 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "geckonator/clock.h"
+
+#include "timer.h"
+#include "speed.h"
+#include "bus.h"
+
+#define BUS_NONE BUS_USERS
+
+static const struct bus_client *bus_clients[BUS_USERS];
+static enum bus_user bus_owner = BUS_NONE;
+static struct bus_stats stats;
+
+static void
+bus_switch(enum bus_user u)
+{
+	uint32_t switches;
+	uint32_t start;
+	uint32_t cycles;
+
+	if (bus_owner == u)
+		return;
+
+	switches = speed_switches();
+	start = timer_cycles();
+	if (bus_owner != BUS_NONE)
+		bus_clients[bus_owner]->detach();
+	bus_owner = u;
+	if (u != BUS_NONE)
+		bus_clients[u]->attach();
+	cycles = timer_cycles_since(start);
+
+	stats.switches += 1;
+	if (speed_switches() != switches)
+		return;
+	stats.timed += 1;
+	stats.cycles_total += cycles;
+	if (cycles > stats.cycles_max)
+		stats.cycles_max = cycles;
+}
+
+/* hand the usart to whoever listens, if anyone */
+static void
+bus_idle(void)
+{
+	enum bus_user u;
+
+	for (u = 0; u < BUS_USERS; u++) {
+		if (bus_clients[u] && bus_clients[u]->listen) {
+			bus_switch(u);
+			return;
+		}
+	}
+}
+
+static bool
+bus_used(void)
+{
+	enum bus_user u;
+
+	for (u = 0; u < BUS_USERS; u++) {
+		if (bus_clients[u])
+			return true;
+	}
+	return false;
+}
+
+void
+bus_enable(enum bus_user u, const struct bus_client *c)
+{
+	if (!bus_used())
+		clock_usart0_enable();
+	bus_clients[u] = c;
+	if (c->listen || bus_owner == BUS_NONE)
+		bus_switch(u);
+}
+
+void
+bus_disable(enum bus_user u)
+{
+	if (bus_owner == u)
+		bus_switch(BUS_NONE);
+	bus_clients[u] = NULL;
+	if (bus_used())
+		bus_idle();
+	else
+		clock_usart0_disable();
+}
+
+void
+bus_acquire(enum bus_user u)
+{
+	stats.acquires += 1;
+	bus_switch(u);
+}
+
+void
+bus_release(enum bus_user u)
+{
+	if (bus_owner == u && !bus_clients[u]->listen)
+		bus_idle();
+}
+
+bool
+bus_attached(enum bus_user u)
+{
+	return bus_owner == u;
+}
+
+void
+bus_missed(uint32_t n)
+{
+	stats.missed += n;
+}
+
+void
+bus_stats(struct bus_stats *st)
+{
+	*st = stats;
+}
+
+void
+bus_stats_reset(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
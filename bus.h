@@ -0,0 +1,64 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BUS_H
+#define _BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * USART0 is shared by the SD card (SPI at location 4)
+ * and IR (UART at location 0). Drivers register with
+ * bus_enable() and get the usart attached whenever
+ * they hold it. A client that listens, like IR, gets
+ * the usart back every time the others release it.
+ * Input it misses in between is reported to
+ * bus_missed(), so apps can show what sharing cost.
+ */
+enum bus_user {
+	BUS_SD,
+	BUS_IR,
+	BUS_USERS,
+};
+
+struct bus_client {
+	void (*attach)(void); /* configure and route the usart */
+	void (*detach)(void); /* finish what's in flight */
+	bool listen;
+};
+
+struct bus_stats {
+	uint32_t acquires;
+	uint32_t switches;
+	uint32_t timed;        /* switches without a clock switch */
+	uint32_t cycles_total; /* of those, spent in detach and attach */
+	uint32_t cycles_max;
+	uint32_t missed;       /* listener input while detached */
+};
+
+void bus_enable(enum bus_user u, const struct bus_client *c);
+void bus_disable(enum bus_user u);
+void bus_acquire(enum bus_user u);
+void bus_release(enum bus_user u);
+bool bus_attached(enum bus_user u);
+void bus_missed(uint32_t n);
+void bus_stats(struct bus_stats *st);
+void bus_stats_reset(void);
+
+#endif
@@ -21,8 +21,11 @@
 #include "geckonator/gpio.h"
 
 #include "timer.h"
+#include "work.h"
 #include "events.h"
 #include "buttons.h"
+#include "latency.h"
+#include "photon.h"
 
 #define POLL_RATE 50
 
@@ -57,21 +60,21 @@ button_cb(struct timer_node *n)
 
 	if (gpio_in(buttonpin[btn])) {
 		if (c->release > 0)
-			event_add(c->release);
+			event_post(c->release, 1, EVENT_HIGH);
 		gpio_flag_clear(buttonpin[btn]);
 		gpio_flag_enable(buttonpin[btn]);
 		pressed -= 1;
 	} else if (s->delay_left == 0) {
 		if (c->repeat > 0)
-			event_add(c->repeat);
+			event_post(c->repeat, 1, EVENT_HIGH | EVENT_COALESCE);
 		s->n.timeout += (c->rate > 0) ? c->rate : POLL_RATE;
 		timer_add(&s->n);
 	} else if (s->delay_left <= POLL_RATE) {
 		s->delay_left = 0;
 		if (c->longpress > 0)
-			event_add(c->longpress);
+			event_post(c->longpress, 1, EVENT_HIGH);
 		else if (c->repeat > 0)
-			event_add(c->repeat);
+			event_post(c->repeat, 1, EVENT_HIGH | EVENT_COALESCE);
 		s->n.timeout += (c->rate > 0) ? c->rate : POLL_RATE;
 		timer_add(&s->n);
 	} else {
@@ -88,9 +91,6 @@ button_click(enum button btn)
 	struct button_state *s;
 	uint16_t delay;
 
-	gpio_flag_disable(buttonpin[btn]);
-	pressed += 1;
-
 	c = &buttonconfig[btn];
 	delay = (c->delay > 0) ? c->delay : POLL_RATE;
 
@@ -100,7 +100,46 @@ button_click(enum button btn)
 	s->n.timeout += (delay > POLL_RATE) ? POLL_RATE : delay;
 	timer_add(&s->n);
 	if (c->press > 0)
-		event_add(c->press);
+		event_post(c->press, 1, EVENT_HIGH);
+	photon_posted(btn, c->press);
+}
+
+static volatile uint8_t clicked;
+
+static void
+buttons_work(struct work *w)
+{
+	unsigned int mask;
+	unsigned int i;
+
+	irq_off();
+	mask = clicked;
+	clicked = 0;
+	irq_on();
+
+	for (i = 0; i < BTN_MAX; i++) {
+		if (mask & (1U << i))
+			button_click(i);
+	}
+}
+
+static struct work button_work = {
+	.cb = buttons_work,
+};
+
+/*
+ * Called from the GPIO interrupt handlers. Only mask
+ * the pin and leave the rest to button_work, so the
+ * timer list is never walked from an interrupt.
+ */
+static void
+button_irq(enum button btn)
+{
+	gpio_flag_disable(buttonpin[btn]);
+	photon_press(btn);
+	pressed += 1;
+	clicked |= 1U << btn;
+	work_post(&button_work);
 }
 
 void
@@ -109,17 +148,17 @@ GPIO_EVEN_IRQHandler(void)
 	uint32_t flags = gpio_flags_enabled(gpio_flags());
 
 	if (gpio_flag(flags, GPIO_PF2))
-		button_click(BTN_UP);
+		button_irq(BTN_UP);
 	/*
 	if (gpio_flag(flags, GPIO_PC4))
-		button_click(BTN_POWER);
+		button_irq(BTN_POWER);
 	*/
 	if (gpio_flag(flags, GPIO_PF4))
-		button_click(BTN_LEFT);
+		button_irq(BTN_LEFT);
 	if (gpio_flag(flags, GPIO_PC8))
-		button_click(BTN_SDOWN);
+		button_irq(BTN_SDOWN);
 	if (gpio_flag(flags, GPIO_PE10))
-		button_click(BTN_SUP);
+		button_irq(BTN_SUP);
 }
 
 void
@@ -128,13 +167,13 @@ GPIO_ODD_IRQHandler(void)
 	uint32_t flags = gpio_flags_enabled(gpio_flags());
 
 	if (gpio_flag(flags, GPIO_PF3))
-		button_click(BTN_DOWN);
+		button_irq(BTN_DOWN);
 	if (gpio_flag(flags, GPIO_PF5))
-		button_click(BTN_RIGHT);
+		button_irq(BTN_RIGHT);
 	if (gpio_flag(flags, GPIO_PC9))
-		button_click(BTN_SMID);
+		button_irq(BTN_SMID);
 	if (gpio_flag(flags, GPIO_PB11))
-		button_click(BTN_CENTER);
+		button_irq(BTN_CENTER);
 }
 
 void
@@ -189,14 +228,16 @@ buttons_uninit(void)
 void
 buttons_config(const struct button_config config[BTN_MAX])
 {
+	photon_wait_begin();
 	while (1) {
-		__disable_irq();
+		irq_off();
 		if (pressed == 0)
 			break;
-		__enable_irq();
+		irq_on();
 		__WFI();
 	}
+	photon_wait_end();
 	events_clear();
 	buttonconfig = config;
-	__enable_irq();
+	irq_on();
 }
@@ -0,0 +1,288 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cir.h"
+
+enum coding {
+	PULSE_DISTANCE, /* a bit is a mark and a space */
+	PULSE_WIDTH,    /* same, but with the mark varying */
+	BIPHASE,        /* manchester, mark0 is half a bit */
+};
+
+/* table flags */
+#define STOP 0x80 /* a mark after the last bit */
+
+struct cir_proto {
+	uint8_t protocol;
+	uint8_t coding;
+	uint8_t bits;
+	uint8_t flags;
+	uint16_t hdr_mark;
+	uint16_t hdr_space;
+	uint16_t mark0;
+	uint16_t space0;
+	uint16_t mark1;
+	uint16_t space1;
+	int (*fields)(uint32_t v, struct cir_code *code);
+};
+
+static const char *const cir_names[CIR_PROTOCOLS] = {
+	[CIR_NEC]     = "NEC",
+	[CIR_SAMSUNG] = "Samsung",
+	[CIR_SONY12]  = "Sony",
+	[CIR_RC5]     = "RC5",
+};
+
+/* address, ~address, command, ~command or 16bit address */
+static int
+nec_fields(uint32_t v, struct cir_code *code)
+{
+	uint8_t cmd = v >> 16;
+
+	if ((uint8_t)(cmd ^ (v >> 24)) != 0xFF)
+		return -1;
+	if ((uint8_t)(v ^ (v >> 8)) == 0xFF)
+		code->address = v & 0xFF;
+	else
+		code->address = v & 0xFFFF;
+	code->command = cmd;
+	return 0;
+}
+
+static int
+nec_repeat(uint32_t v, struct cir_code *code)
+{
+	(void)v;
+	code->flags |= CIR_REPEAT;
+	return 0;
+}
+
+/* address, address, command, ~command */
+static int
+samsung_fields(uint32_t v, struct cir_code *code)
+{
+	uint8_t cmd = v >> 16;
+
+	if ((uint8_t)v != (uint8_t)(v >> 8)
+			|| (uint8_t)(cmd ^ (v >> 24)) != 0xFF)
+		return -1;
+	code->address = v & 0xFF;
+	code->command = cmd;
+	return 0;
+}
+
+/* 7bit command, 5bit address */
+static int
+sony12_fields(uint32_t v, struct cir_code *code)
+{
+	code->command = v & 0x7F;
+	code->address = v >> 7;
+	return 0;
+}
+
+/* start, field (inverted command bit 6), toggle, 5bit address, 6bit command */
+static int
+rc5_fields(uint32_t v, struct cir_code *code)
+{
+	if (!(v & 0x2000))
+		return -1;
+	code->command = (v & 0x3F) | ((~v & 0x1000) >> 6);
+	code->address = (v >> 6) & 0x1F;
+	if (v & 0x800)
+		code->flags |= CIR_TOGGLE;
+	return 0;
+}
+
+static const struct cir_proto cir_table[] = {
+	{ CIR_NEC,     PULSE_DISTANCE, 32, STOP, 9000, 4500, 560, 560, 560, 1690, nec_fields, },
+	{ CIR_NEC,     PULSE_DISTANCE,  0, STOP, 9000, 2250, 560,   0,   0,    0, nec_repeat, },
+	{ CIR_SAMSUNG, PULSE_DISTANCE, 32, STOP, 4500, 4500, 560, 560, 560, 1690, samsung_fields, },
+	{ CIR_SONY12,  PULSE_WIDTH,    12,    0, 2400,  600, 600, 600, 1200, 600, sony12_fields, },
+	{ CIR_RC5,     BIPHASE,        14,    0,    0,    0, 889,   0,   0,    0, rc5_fields, },
+};
+
+void
+cir_rx_init(struct cir_rx *rx)
+{
+	rx->acc = 0;
+	rx->mark = false;
+	rx->n = 0;
+}
+
+static void
+cir_push(struct cir_rx *rx, uint32_t us)
+{
+	if (rx->n == CIR_PULSES)
+		return;
+	rx->us[rx->n++] = (us > 0xFFFF) ? 0xFFFF : us;
+}
+
+/*
+ * light tells what the line was for the us
+ * microseconds leading up to this edge.
+ */
+void
+cir_edge(struct cir_rx *rx, bool light, uint32_t us)
+{
+	if (light || (rx->mark && us < CIR_MERGE_US)) {
+		us += rx->acc;
+		rx->acc = (us > 0xFFFF) ? 0xFFFF : us;
+		rx->mark = true;
+		return;
+	}
+
+	/* darkness before the first mark is just idle */
+	if (!rx->mark)
+		return;
+	cir_push(rx, rx->acc);
+	cir_push(rx, us);
+	rx->acc = 0;
+	rx->mark = false;
+}
+
+/* call after CIR_GAP_US of darkness, returns the pulses seen */
+unsigned int
+cir_end(struct cir_rx *rx)
+{
+	if (rx->mark)
+		cir_push(rx, rx->acc);
+	rx->acc = 0;
+	rx->mark = false;
+	return rx->n;
+}
+
+static bool
+near(uint32_t us, uint32_t want)
+{
+	uint32_t slack = want / 4 + 100;
+
+	return us + slack >= want && us <= want + slack;
+}
+
+static int
+cir_bits(const struct cir_proto *p, const uint16_t *us, unsigned int n, uint32_t *v)
+{
+	unsigned int i = 0;
+	unsigned int b;
+
+	if (p->hdr_mark) {
+		if (n < 2 || !near(us[0], p->hdr_mark) || !near(us[1], p->hdr_space))
+			return -1;
+		i = 2;
+	}
+
+	*v = 0;
+	for (b = 0; b < p->bits; b++, i += 2) {
+		bool last = (i + 1 == n);
+
+		if (i >= n)
+			return -1;
+		/* the space after the last bit may be the gap */
+		if (last && b + 1 != p->bits)
+			return -1;
+		if (near(us[i], p->mark1) && (last || near(us[i + 1], p->space1)))
+			*v |= 1UL << b;
+		else if (!near(us[i], p->mark0) || !(last || near(us[i + 1], p->space0)))
+			return -1;
+	}
+
+	if (p->flags & STOP) {
+		if (i + 1 != n || !near(us[i], p->mark0))
+			return -1;
+	} else if (i < n)
+		return -1;
+	return 0;
+}
+
+static int
+cir_biphase(const struct cir_proto *p, const uint16_t *us, unsigned int n, uint32_t *v)
+{
+	uint8_t half[2 * 32];
+	unsigned int want = 2 * p->bits;
+	unsigned int h = 0;
+	unsigned int i;
+
+	/* the first half of the start bit is dark */
+	half[h++] = 0;
+	for (i = 0; i < n; i++) {
+		unsigned int units;
+
+		if (near(us[i], p->mark0))
+			units = 1;
+		else if (near(us[i], 2 * p->mark0))
+			units = 2;
+		else
+			return -1;
+		if (h + units > want)
+			return -1;
+		for (; units > 0; units--)
+			half[h++] = !(i & 1);
+	}
+	/* and the last half of a 0 is lost in the gap */
+	if (h + 1 == want)
+		half[h++] = 0;
+	if (h != want)
+		return -1;
+
+	*v = 0;
+	for (i = 0; i < want; i += 2) {
+		if (half[i] == half[i + 1])
+			return -1;
+		*v = (*v << 1) | half[i + 1];
+	}
+	return 0;
+}
+
+int
+cir_decode(const uint16_t *us, unsigned int n, struct cir_code *code)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(cir_table) / sizeof(cir_table[0]); i++) {
+		const struct cir_proto *p = &cir_table[i];
+		uint32_t v;
+		int ret;
+
+		if (p->coding == BIPHASE)
+			ret = cir_biphase(p, us, n, &v);
+		else
+			ret = cir_bits(p, us, n, &v);
+		if (ret)
+			continue;
+
+		code->protocol = p->protocol;
+		code->flags = 0;
+		code->address = 0;
+		code->command = 0;
+		if (p->fields(v, code) == 0)
+			return 0;
+	}
+	return -1;
+}
+
+const char *
+cir_name(unsigned int protocol)
+{
+	if (protocol >= CIR_PROTOCOLS)
+		return "?";
+	return cir_names[protocol];
+}
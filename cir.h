@@ -0,0 +1,78 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CIR_H
+#define _CIR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Consumer IR remote decoding.
+ *
+ * Edges go in through cir_edge() with how long the line
+ * was light or dark before them. Gaps shorter than
+ * CIR_MERGE_US are taken to be the carrier and merged
+ * into the mark around them. The badge only has its
+ * IrDA transceiver, which doesn't demodulate: it gives
+ * one short pulse per period of the 38kHz carrier, about
+ * 26us apart, and that is what cirrx.c feeds in here.
+ * A frame ends after CIR_GAP_US of darkness, and
+ * cir_decode() then matches it against a table of
+ * protocols.
+ *
+ * Like irframe.c this doesn't touch any hardware.
+ */
+#define CIR_PULSES   80   /* NEC is 67 */
+#define CIR_MERGE_US 150
+#define CIR_GAP_US   8000
+
+enum cir_protocol {
+	CIR_NEC,
+	CIR_SAMSUNG,
+	CIR_SONY12,
+	CIR_RC5,
+	CIR_PROTOCOLS,
+};
+
+/* cir_code flags */
+#define CIR_REPEAT 0x01 /* NEC repeat frame, no address or command */
+#define CIR_TOGGLE 0x02 /* RC5 toggle bit */
+
+struct cir_code {
+	uint8_t protocol;
+	uint8_t flags;
+	uint16_t address;
+	uint16_t command;
+};
+
+/* marks and spaces in us, starting with a mark */
+struct cir_rx {
+	uint16_t acc;
+	bool mark;
+	uint8_t n;
+	uint16_t us[CIR_PULSES];
+};
+
+void cir_rx_init(struct cir_rx *rx);
+void cir_edge(struct cir_rx *rx, bool light, uint32_t us);
+unsigned int cir_end(struct cir_rx *rx);
+int cir_decode(const uint16_t *us, unsigned int n, struct cir_code *code);
+const char *cir_name(unsigned int protocol);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "geckonator/clock.h"
+#include "geckonator/gpio.h"
+
+#include "timer.h"
+#include "events.h"
+#include "work.h"
+#include "latency.h"
+#include "speed.h"
+#include "cir.h"
+#include "cirrx.h"
+
+#define IR_RX GPIO_PE11
+
+/*
+ * TIMER1 runs at CORE_HZ / 16 = 1.5MHz and captures
+ * both edges on CC1, which location 1 puts on PE11.
+ * CC0 compares CIR_GAP_US after the last edge to end
+ * the frame, so nothing ever waits for the line.
+ *
+ * IR_RX is the IrDA transceiver, not a demodulating
+ * remote receiver. It idles low and goes high when it
+ * sees light, just like the usart sees it with RXINV,
+ * and pulses along with the remote's carrier.
+ */
+#define TICKS_PER_MS (CORE_HZ / 16U / 1000U)
+#define GAP_TICKS    (CIR_GAP_US * TICKS_PER_MS / 1000U)
+#define REPEAT_MS    200
+
+static struct cir_rx cirrx_buf[2];
+static struct cir_rx *cirrx_cur;
+static uint16_t cirrx_edge;
+static bool cirrx_light;
+static struct cirrx_stats cirrx_st;
+
+static struct cir_code cirrx_code;
+static uint32_t cirrx_seen;
+
+static void
+cirrx_work(struct work *w)
+{
+	struct cir_rx *rx = (cirrx_cur == &cirrx_buf[0]) ? &cirrx_buf[1] : &cirrx_buf[0];
+	struct cir_code code;
+	uint32_t now = timer_now();
+	bool repeat;
+
+	(void)w;
+	if (cir_decode(rx->us, rx->n, &code)) {
+		cirrx_st.unknown += 1;
+		return;
+	}
+	cirrx_st.decoded += 1;
+
+	/* NEC sends a short repeat frame while the
+	 * key is held, RC5 keeps the toggle bit and
+	 * the rest just send the same frame again */
+	repeat = ((now - cirrx_seen) & 0xFFFFFFU) < REPEAT_MS;
+	cirrx_seen = now;
+	if (code.flags & CIR_REPEAT) {
+		if (repeat)
+			event_post(EV_CIR_REPEAT, 1, EVENT_HIGH | EVENT_COALESCE);
+		return;
+	}
+	if (repeat && code.protocol == cirrx_code.protocol
+			&& code.address == cirrx_code.address
+			&& code.command == cirrx_code.command
+			&& code.flags == cirrx_code.flags) {
+		event_post(EV_CIR_REPEAT, 1, EVENT_HIGH | EVENT_COALESCE);
+		return;
+	}
+
+	cirrx_code = code;
+	event_post(EV_CIR_KEY, (code.address & 0xFF) << 8 | (code.command & 0xFF),
+			EVENT_HIGH);
+}
+
+static struct work cirrx_work_item = {
+	.cb = cirrx_work,
+};
+
+/*
+ * Hand the finished frame to the work queue and
+ * capture the next one into the other buffer. If
+ * the last frame isn't decoded yet this one is lost.
+ */
+static void
+cirrx_frame(void)
+{
+	struct cir_rx *rx = cirrx_cur;
+
+	cirrx_light = false;
+	if (cir_end(rx) == 0)
+		return;
+
+	cirrx_st.frames += 1;
+	if (cirrx_work_item.queued) {
+		cirrx_st.dropped += 1;
+		cir_rx_init(rx);
+		return;
+	}
+	cirrx_cur = (rx == &cirrx_buf[0]) ? &cirrx_buf[1] : &cirrx_buf[0];
+	cir_rx_init(cirrx_cur);
+	work_post(&cirrx_work_item);
+}
+
+void
+TIMER1_IRQHandler(void)
+{
+	uint32_t flags = TIMER1->IF;
+
+	TIMER1->IFC = flags;
+
+	if (flags & TIMER_IF_ICBOF1) {
+		/* lost an edge, so we can't trust the level */
+		cirrx_st.overflow += 1;
+		cirrx_light = !gpio_in(IR_RX);
+	}
+
+	while (TIMER1->STATUS & TIMER_STATUS_ICV1) {
+		uint16_t edge = TIMER1->CC[1].CCV;
+		uint16_t ticks = edge - cirrx_edge;
+
+		cirrx_edge = edge;
+		cir_edge(cirrx_cur, cirrx_light, ticks * 2U / 3U);
+		cirrx_light = !cirrx_light;
+
+		TIMER1->CC[0].CCV = edge + GAP_TICKS;
+		TIMER1->IFC = TIMER_IF_CC0;
+		TIMER1->IEN = TIMER_IEN_CC1 | TIMER_IEN_ICBOF1 | TIMER_IEN_CC0;
+		flags &= ~TIMER_IF_CC0;
+	}
+
+	if (flags & TIMER_IF_CC0) {
+		TIMER1->IEN = TIMER_IEN_CC1 | TIMER_IEN_ICBOF1;
+		cirrx_frame();
+	}
+}
+
+void
+cirrx_init(void)
+{
+	gpio_mode(IR_RX, GPIO_MODE_INPUT);
+
+	cir_rx_init(&cirrx_buf[0]);
+	cirrx_cur = &cirrx_buf[0];
+	cirrx_light = false;
+	memset(&cirrx_code, 0, sizeof(cirrx_code));
+	memset(&cirrx_st, 0, sizeof(cirrx_st));
+
+	clock_timer1_enable();
+	TIMER1->CTRL = TIMER_CTRL_PRESC_DIV16 | TIMER_CTRL_MODE_UP;
+	TIMER1->TOP = 0xFFFF;
+	TIMER1->CC[0].CTRL = TIMER_CC_CTRL_MODE_OUTPUTCOMPARE;
+	TIMER1->CC[1].CTRL = TIMER_CC_CTRL_MODE_INPUTCAPTURE
+		| TIMER_CC_CTRL_ICEDGE_BOTH
+		| TIMER_CC_CTRL_ICEVCTRL_EVERYEDGE
+		| TIMER_CC_CTRL_FILT_ENABLE;
+	/* location1: cc1 -> PE11 -> IR_RX */
+	TIMER1->ROUTE = TIMER_ROUTE_LOCATION_LOC1 | TIMER_ROUTE_CC1PEN;
+	TIMER1->IFC = ~0U;
+	TIMER1->IEN = TIMER_IEN_CC1 | TIMER_IEN_ICBOF1;
+	/* during a mark the transceiver pulses with
+	 * the carrier, two edges every 26us, but the
+	 * capture buffer only holds 2 */
+	NVIC_SetPriority(TIMER1_IRQn, 1);
+	NVIC_EnableIRQ(TIMER1_IRQn);
+	/* the edge timings are in timer ticks */
+	speed_hold();
+	TIMER1->CMD = TIMER_CMD_START;
+}
+
+void
+cirrx_uninit(void)
+{
+	NVIC_DisableIRQ(TIMER1_IRQn);
+	TIMER1->CMD = TIMER_CMD_STOP;
+	TIMER1->IEN = 0;
+	TIMER1->ROUTE = 0;
+	TIMER1->CC[0].CTRL = 0;
+	TIMER1->CC[1].CTRL = 0;
+	clock_timer1_disable();
+	gpio_mode(IR_RX, GPIO_MODE_DISABLED);
+	speed_release();
+}
+
+/* everything about the last new key */
+void
+cirrx_last(struct cir_code *code)
+{
+	*code = cirrx_code;
+}
+
+void
+cirrx_stats(struct cirrx_stats *st)
+{
+	irq_off();
+	*st = cirrx_st;
+	irq_on();
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CIRRX_H
+#define _CIRRX_H
+
+#include <stdint.h>
+
+#include "cir.h"
+
+/*
+ * Receive consumer IR remotes on the IR_RX pin.
+ * Decoded codes are posted as EV_CIR_KEY with the
+ * low 8 bits of the address and the command in arg,
+ * (address << 8) | command, and a held key posts
+ * coalesced EV_CIR_REPEAT events after that.
+ *
+ * This uses the pin directly, so don't mix it with
+ * ir_init().
+ */
+struct cirrx_stats {
+	uint32_t frames;
+	uint32_t decoded;
+	uint32_t unknown;
+	uint32_t dropped; /* decoder was still busy */
+	uint32_t overflow;
+};
+
+void cirrx_init(void);
+void cirrx_uninit(void);
+void cirrx_last(struct cir_code *code);
+void cirrx_stats(struct cirrx_stats *st);
+
+#endif
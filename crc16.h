@@ -0,0 +1,40 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CRC16_H
+#define _CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC-16/CCITT, polynomial 0x1021, MSB first, as used by
+ * irframe.c and for SD card data blocks. The caller picks
+ * the initial value: 0xFFFF for IR frames, 0 for the card.
+ */
+extern const uint16_t crc16_table[256];
+
+static inline uint16_t
+crc16_byte(uint16_t crc, uint8_t c)
+{
+	return (crc << 8) ^ crc16_table[(crc >> 8) ^ c];
+}
+
+uint16_t crc16(uint16_t crc, const uint8_t *buf, size_t len);
+
+#endif
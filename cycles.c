@@ -0,0 +1,155 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cycles.h"
+
+#if CYCLES
+#include <stdint.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "latency.h"
+
+#define FG444 0x0F8
+#define BG444 0x000
+
+enum events {
+	EV_EXIT = 1,
+	EV_RESET,
+	EV_TICK,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_CENTER] = { .press = EV_RESET, },
+};
+
+const char *const cycles_name[CYCLES_MAX] = {
+#define CYCLES_NAME(name) [CYCLES_##name] = #name,
+	CYCLES_SECTIONS(CYCLES_NAME)
+#undef CYCLES_NAME
+};
+
+static struct cycles_counter cycles_tab[CYCLES_MAX];
+
+void
+cycles_add(enum cycles_section s, uint32_t cycles)
+{
+	struct cycles_counter *c = &cycles_tab[s];
+
+	irq_off();
+	if (c->count == 0 || cycles < c->min)
+		c->min = cycles;
+	if (cycles > c->max)
+		c->max = cycles;
+	c->count += 1;
+	c->total += cycles;
+	irq_on();
+}
+
+void
+cycles_get(enum cycles_section s, struct cycles_counter *c)
+{
+	irq_off();
+	*c = cycles_tab[s];
+	irq_on();
+}
+
+void
+cycles_reset(void)
+{
+	unsigned int i;
+
+	irq_off();
+	for (i = 0; i < CYCLES_MAX; i++) {
+		cycles_tab[i].count = 0;
+		cycles_tab[i].min = 0;
+		cycles_tab[i].max = 0;
+		cycles_tab[i].total = 0;
+	}
+	irq_on();
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+/*
+ * Two lines for each section:
+ *
+ *   name        count
+ *     min    avg    max
+ */
+static void
+cycles_render(void)
+{
+	char buf[40];
+	unsigned int i;
+
+	for (i = 0; i < CYCLES_MAX && 2 * i + 1 < 240 / font.height; i++) {
+		struct cycles_counter c;
+
+		cycles_get(i, &c);
+		sprintf(buf, "%-11s %8lu", cycles_name[i], (unsigned long)c.count);
+		show(2 * i, buf);
+		if (c.count)
+			sprintf(buf, "%6lu %6lu %6lu", (unsigned long)c.min,
+					(unsigned long)(c.total / c.count),
+					(unsigned long)c.max);
+		else
+			buf[0] = '\0';
+		show(2 * i + 1, buf);
+	}
+}
+
+void
+cyclecounters(void)
+{
+	struct ticker tick;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	cycles_render();
+
+	ticker_start(&tick, 500, EV_TICK);
+	while (1) {
+		switch ((enum events)event_wait()) {
+		case EV_EXIT:
+			ticker_stop(&tick);
+			return;
+		case EV_RESET:
+			cycles_reset();
+			/* fallthrough */
+		case EV_TICK:
+			cycles_render();
+			break;
+		}
+	}
+}
+#endif
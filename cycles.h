@@ -0,0 +1,89 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CYCLES_H
+#define _CYCLES_H
+
+#include <stdint.h>
+
+#include "timer.h"
+#include "speed.h"
+
+/*
+ * Cycle counters for hot sections, timed with the free
+ * running SysTick. Wrap a section in
+ *
+ *   CYCLES_BEGIN(name);
+ *   ...
+ *   CYCLES_END(name);
+ *
+ * with name listed in CYCLES_SECTIONS below. Unless built
+ * with -DCYCLES=1 the macros compile to nothing, and so
+ * does the "Cycle counters" screen showing them.
+ *
+ * Interrupts taken inside a section are counted with it,
+ * and a section taking longer than the 24bit SysTick
+ * takes to wrap, about 0.7s, is counted wrong. Runs the
+ * core clock was switched in are left out.
+ */
+#ifndef CYCLES
+#define CYCLES 0
+#endif
+
+#define CYCLES_SECTIONS(X) \
+	X(dp_setbox) \
+	X(showbmp_row) \
+	X(sd_read) \
+	X(timer_add) \
+	X(rtc_irq)
+
+enum cycles_section {
+#define CYCLES_ENUM(name) CYCLES_##name,
+	CYCLES_SECTIONS(CYCLES_ENUM)
+#undef CYCLES_ENUM
+	CYCLES_MAX,
+};
+
+struct cycles_counter {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+};
+
+#if CYCLES
+#define CYCLES_BEGIN(name) \
+	uint32_t cycles_switches_##name = speed_switches(); \
+	uint32_t cycles_start_##name = timer_cycles()
+#define CYCLES_END(name) do { \
+	uint32_t cycles_##name = timer_cycles_since(cycles_start_##name); \
+	if (speed_switches() == cycles_switches_##name) \
+		cycles_add(CYCLES_##name, cycles_##name); \
+} while (0)
+
+extern const char *const cycles_name[CYCLES_MAX];
+
+void cycles_add(enum cycles_section s, uint32_t cycles);
+void cycles_get(enum cycles_section s, struct cycles_counter *c);
+void cycles_reset(void);
+#else
+#define CYCLES_BEGIN(name) do { } while (0)
+#define CYCLES_END(name) do { } while (0)
+#endif
+
+#endif
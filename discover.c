@@ -0,0 +1,135 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "beacon.h"
+
+/*
+ * Look for other badges now and then, and see what
+ * the listen window and interval cost and buy.
+ */
+
+#define FG444 0x9E4
+#define BG444 0x000
+
+enum events {
+	EV_EXIT = 1,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+discover_update(const struct beacon_stats *st, const struct beacon_peer *peer)
+{
+	char buf[24];
+
+	if (peer) {
+		sprintf(buf, "Heard %04X (%lu)", peer->id, (unsigned long)peer->heard);
+		show(3, buf);
+	}
+	sprintf(buf, "Awake %lu.%lu%%",
+			(unsigned long)(st->ms ? 100 * st->awake_ms / st->ms : 0),
+			(unsigned long)(st->ms ? 1000 * st->awake_ms / st->ms % 10 : 0));
+	show(5, buf);
+	sprintf(buf, "Wakeups %lu", (unsigned long)st->wakeups);
+	show(6, buf);
+	sprintf(buf, "Found %lu", (unsigned long)st->discovered);
+	show(7, buf);
+	if (st->discovered == 0)
+		return;
+	sprintf(buf, "Avg %lu ms", (unsigned long)(st->latency_total / st->discovered));
+	show(8, buf);
+	sprintf(buf, "Max %lu ms", (unsigned long)st->latency_max);
+	show(9, buf);
+}
+
+static void
+discover_run(uint16_t interval, uint16_t window)
+{
+	const struct beacon_config cfg = {
+		.interval = interval,
+		.window = window,
+	};
+	char buf[24];
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	sprintf(buf, "%u ms every %u ms", window, interval);
+	show(0, buf);
+	sprintf(buf, "Expect %lu ms", (unsigned long)beacon_expected(&cfg));
+	show(1, buf);
+	show(3, "Listening..");
+
+	if (beacon_run(&cfg, EV_EXIT, discover_update) == 0)
+		return;
+
+	show(3, "Window too long");
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+}
+
+static void
+discover_fast(void)
+{
+	discover_run(1000, 100);
+}
+
+static void
+discover_normal(void)
+{
+	discover_run(2000, 50);
+}
+
+static void
+discover_slow(void)
+{
+	discover_run(10000, 50);
+}
+
+void
+discover(void)
+{
+	static const struct menuitem discover_menu[] = {
+		{ .label = "Fast   1s/100ms", .cb = discover_fast, },
+		{ .label = "Normal 2s/50ms",  .cb = discover_normal, },
+		{ .label = "Slow   10s/50ms", .cb = discover_slow, },
+	};
+
+	menu(discover_menu, ARRAY_SIZE(discover_menu), FG444, BG444);
+}
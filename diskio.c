@@ -10,6 +10,7 @@
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
 
+#include "bus.h"
 #include "sdcard.h"
 
 #if 0
@@ -38,7 +39,9 @@ disk_status(BYTE pdrv)
 	if (status & STA_NOINIT)
 		return status;
 
+	bus_acquire(BUS_SD);
 	ret = sd_status(&stat);
+	bus_release(BUS_SD);
 	debug("sd_status() = %02x (%02x)\r\n", ret, stat);
 	if (ret == 0xFF)
 		status = STA_NOINIT | STA_NODISK;
@@ -62,7 +65,9 @@ disk_initialize(BYTE pdrv)
 	if (pdrv != 0)
 		return STA_NOINIT | STA_NODISK;
 
+	bus_acquire(BUS_SD);
 	ret = sd_wakeup();
+	bus_release(BUS_SD);
 	debug("sd_wakeup() = %x\r\n", ret);
 	if (ret == 0x00)
 		status = 0;
@@ -87,6 +92,7 @@ disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 	if (status & STA_NOINIT)
 		return RES_NOTRDY;
 
+	bus_acquire(BUS_SD);
 	for (; count > 0; count--) {
 		ret = sd_readblock(sector, buff);
 		if (ret != 0x00) {
@@ -97,6 +103,7 @@ disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 		sector += 1;
 		buff += 512;
 	}
+	bus_release(BUS_SD);
 	switch (ret) {
 	case 0x00: res = RES_OK; break;
 	default:   res = RES_ERROR; break;
@@ -122,6 +129,7 @@ disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
 	if (status & STA_NOINIT)
 		return RES_NOTRDY;
 
+	bus_acquire(BUS_SD);
 	for (; count > 0; count--) {
 		ret = sd_writeblock(sector, buff);
 		if (ret != 0x00) {
@@ -132,6 +140,7 @@ disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
 		sector += 1;
 		buff += 512;
 	}
+	bus_release(BUS_SD);
 	switch (ret) {
 	case 0x00: res = RES_OK; break;
 	default:   res = RES_ERROR; break;
@@ -162,7 +171,12 @@ disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 #if FF_USE_MKFS == 1
 	case GET_SECTOR_COUNT: { /* Get media size */
 		DWORD *count = buff;
-		switch (sd_getblocks(count)) {
+		uint8_t ret;
+
+		bus_acquire(BUS_SD);
+		ret = sd_getblocks(count);
+		bus_release(BUS_SD);
+		switch (ret) {
 		case 0x00: res = RES_OK;     break;
 		case 0xFF: res = RES_NOTRDY; break;
 		default:   res = RES_ERROR;  break;
@@ -27,6 +27,11 @@
 #include "ff.h"
 #include "font.h"
 #include "display.h"
+#include "cycles.h"
+#include "photon.h"
+#include "arena.h"
+#include "ramfunc.h"
+#include "speed.h"
 
 #define DP_BLK GPIO_PA1 /* backlight */
 #define DP_DC  GPIO_PA2 /* D/CX */
@@ -40,6 +45,8 @@
 #define DP_CLOCKDIV_WRITE   0 /* 24MHz / (2 * (1 +   0/256)) = 12MHz */
 #define DP_CLOCKDIV_READ  256 /* 24MHz / (2 * (1 + 256/256)) =  6MHz */
 
+#define DP_VERIFY_PIXELS 40
+
 #if 0
 #include <stdio.h>
 #define debug(...) printf(__VA_ARGS__)
@@ -47,6 +54,10 @@
 #define debug(...)
 #endif
 
+/* defaults until spitune.c has found faster ones */
+static uint32_t dp_clockdiv_write = DP_CLOCKDIV_WRITE;
+static uint32_t dp_clockdiv_read = DP_CLOCKDIV_READ;
+
 void dp_backlight_on(void)
 {
 	gpio_set(DP_BLK);
@@ -80,7 +91,7 @@ dp_reset(void)
 uint8_t
 dp_read1(uint8_t cmd)
 {
-	usart1_clock_div(DP_CLOCKDIV_READ);
+	usart1_clock_div(speed_div(dp_clockdiv_read));
 	usart1_txdatax(cmd
 			| USART_TXDATAX_RXENAT
 			| USART_TXDATAX_TXTRIAT);
@@ -91,14 +102,14 @@ dp_read1(uint8_t cmd)
 	usart1_rx_disable();
 	usart1_tx_tristate_disable();
 	gpio_toggle(DP_DC);
-	usart1_clock_div(DP_CLOCKDIV_WRITE);
+	usart1_clock_div(speed_div(dp_clockdiv_write));
 	return usart1_rxdata();
 }
 
 void
 dp_read(uint8_t cmd, uint8_t *buf, size_t len)
 {
-	usart1_clock_div(DP_CLOCKDIV_READ);
+	usart1_clock_div(speed_div(dp_clockdiv_read));
 	usart1_frame_bits(9);
 	usart1_txdatax((((uint16_t)cmd) << 1)
 			| USART_TXDATAX_RXENAT
@@ -119,7 +130,7 @@ dp_read(uint8_t cmd, uint8_t *buf, size_t len)
 		/* wait */;
 	usart1_rx_disable();
 	usart1_tx_tristate_disable();
-	usart1_clock_div(DP_CLOCKDIV_WRITE);
+	usart1_clock_div(speed_div(dp_clockdiv_write));
 	*buf++ = usart1_rxdata();
 }
 
@@ -255,7 +266,7 @@ dp_init(void)
 			| USART_CTRL_CLKPOL
 			| USART_CTRL_LOOPBK
 			| USART_CTRL_SYNC);
-	usart1_clock_div(DP_CLOCKDIV_WRITE);
+	usart1_clock_div(speed_div(dp_clockdiv_write));
 	usart1_frame_bits(8);
 	usart1_master_enable();
 	usart1_tx_enable();
@@ -283,6 +294,28 @@ dp_init(void)
 	dp_rotate(true);
 }
 
+/* called by speed.c when the core clock changes */
+void
+dp_clock_update(void)
+{
+	usart1_clock_div(speed_div(dp_clockdiv_write));
+}
+
+void
+dp_clock_get(uint32_t *write, uint32_t *read)
+{
+	*write = dp_clockdiv_write;
+	*read = dp_clockdiv_read;
+}
+
+void
+dp_clock_set(uint32_t write, uint32_t read)
+{
+	dp_clockdiv_write = write;
+	dp_clockdiv_read = read;
+	dp_clock_update();
+}
+
 void
 dp_uninit(void)
 {
@@ -300,7 +333,9 @@ static void
 dp__setbox(unsigned int xs, unsigned int xe, unsigned int ys, unsigned int ye)
 {
 	uint8_t buf[4];
+	CYCLES_BEGIN(dp_setbox);
 
+	photon_draw();
 	buf[0] = (xs >> 8) & 0xff;
 	buf[1] = xs & 0xff;
 	buf[2] = (xe >> 8) & 0xff;
@@ -312,26 +347,65 @@ dp__setbox(unsigned int xs, unsigned int xe, unsigned int ys, unsigned int ye)
 	buf[2] = (ye >> 8) & 0xff;
 	buf[3] = ye & 0xff;
 	dp_write(0x2b, buf, 4);
+	CYCLES_END(dp_setbox);
 }
 
-void
-dp_fill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned int rgb444)
+static uint8_t
+dp_verify_byte(unsigned int i, unsigned int seed)
+{
+	return ((i + seed) * 0x9D) & 0xFC;
+}
+
+static bool
+dp_verify_match(const uint8_t *buf, unsigned int seed)
 {
-	uint8_t buf[3] = {
-		(rgb444 >> 4) & 0xff,
-		((rgb444 << 4) & 0xff) | ((rgb444 >> 8) & 0xff),
-		rgb444 & 0xff,
-	};
 	unsigned int i;
 
-	dp__setbox(x, x+w-1, y, y+h-1);
+	for (i = 0; i < 3 * DP_VERIFY_PIXELS; i++) {
+		if ((buf[i] & 0xFC) != dp_verify_byte(i, seed))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Write a test pattern to the start of row y at the
+ * current write clock and read it back with RAMRD at
+ * the current read clock.
+ */
+bool
+dp_verify(unsigned int y, unsigned int seed)
+{
+	uint8_t buf[3 * DP_VERIFY_PIXELS + 1];
+	unsigned int i;
+
+	dp_mode666();
+	dp__setbox(0, DP_VERIFY_PIXELS - 1, y, y);
 
 	usart1_txdata(0x2c);
 	gpio_toggle(DP_DC);
 	while (!usart1_tx_complete())
 		/* wait */;
 	gpio_toggle(DP_DC);
-	for (i = (w * h + 1)/2; i; i--) {
+	for (i = 0; i < 3 * DP_VERIFY_PIXELS; i++) {
+		while (!usart1_tx_buffer_level())
+			/* wait */;
+		usart1_txdata(dp_verify_byte(i, seed));
+	}
+	while (!usart1_tx_complete())
+		/* wait */;
+
+	dp_read(0x2e, buf, sizeof(buf));
+	dp_mode444();
+
+	/* allow for a dummy byte before the pixels */
+	return dp_verify_match(buf, seed) || dp_verify_match(buf + 1, seed);
+}
+
+static __always_inline void
+dp__fill_pixels_body(const uint8_t buf[3], unsigned int i)
+{
+	for (; i; i--) {
 		while (!usart1_tx_buffer_level())
 			/* wait */;
 		usart1_txdata(buf[0]);
@@ -342,6 +416,26 @@ dp_fill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned
 			/* wait */;
 		usart1_txdata(buf[2]);
 	}
+}
+RAMFUNC_DEFINE(dp__fill_pixels, (const uint8_t buf[3], unsigned int i), (buf, i))
+
+void
+dp_fill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned int rgb444)
+{
+	uint8_t buf[3] = {
+		(rgb444 >> 4) & 0xff,
+		((rgb444 << 4) & 0xff) | ((rgb444 >> 8) & 0xff),
+		rgb444 & 0xff,
+	};
+
+	dp__setbox(x, x+w-1, y, y+h-1);
+
+	usart1_txdata(0x2c);
+	gpio_toggle(DP_DC);
+	while (!usart1_tx_complete())
+		/* wait */;
+	gpio_toggle(DP_DC);
+	RAMFUNC_CALL(dp__fill_pixels, buf, (w * h + 1)/2);
 	while (!usart1_tx_complete())
 		/* wait */;
 }
@@ -375,39 +469,21 @@ dp_fill666(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsig
 	dp_mode444();
 }
 
-void
-dp_putchar(unsigned int x, unsigned int y, unsigned int fg444, unsigned int bg444, int ch)
+static __always_inline void
+dp__putchar_pixels_body(const uint8_t *data, uint8_t mask, unsigned int i,
+		unsigned int fg444, unsigned int bg444)
 {
-	unsigned int idx = 0;
-	uint8_t mask;
-	unsigned int i;
-
-	if (ch >= 32 && ch <= 126)
-		idx = ch - 31;
-
-	idx *= font.width * font.height;
-	mask = 1U << (idx % 8);
-	idx /= 8;
-
-	dp__setbox(x, x+font.width-1, y, y+font.height-1);
-
-	usart1_txdata(0x2c);
-	gpio_toggle(DP_DC);
-	while (!usart1_tx_complete())
-		/* wait */;
-	gpio_toggle(DP_DC);
-
-	for (i = (font.width * font.height + 1)/2; i; i--) {
+	for (; i; i--) {
 		unsigned int p1, p2;
 		uint8_t v1, v2, v3;
 
-		if (font.data[idx] & mask)
+		if (*data & mask)
 			p1 = fg444;
 		else
 			p1 = bg444;
 		mask <<= 1;
 		if (mask == 0) {
-			idx += 1;
+			data += 1;
 			mask = 1;
 		}
 		v1 = p1 >> 4;
@@ -417,13 +493,13 @@ dp_putchar(unsigned int x, unsigned int y, unsigned int fg444, unsigned int bg44
 			/* wait */;
 		usart1_txdata(v1);
 
-		if (font.data[idx] & mask)
+		if (*data & mask)
 			p2 = fg444;
 		else
 			p2 = bg444;
 		mask <<= 1;
 		if (mask == 0) {
-			idx += 1;
+			data += 1;
 			mask = 1;
 		}
 		v2 |= p2 >> 8;
@@ -436,6 +512,35 @@ dp_putchar(unsigned int x, unsigned int y, unsigned int fg444, unsigned int bg44
 			/* wait */;
 		usart1_txdata(v3);
 	}
+}
+RAMFUNC_DEFINE(dp__putchar_pixels,
+		(const uint8_t *data, uint8_t mask, unsigned int i,
+		 unsigned int fg444, unsigned int bg444),
+		(data, mask, i, fg444, bg444))
+
+void
+dp_putchar(unsigned int x, unsigned int y, unsigned int fg444, unsigned int bg444, int ch)
+{
+	unsigned int idx = 0;
+	uint8_t mask;
+
+	if (ch >= 32 && ch <= 126)
+		idx = ch - 31;
+
+	idx *= font.width * font.height;
+	mask = 1U << (idx % 8);
+	idx /= 8;
+
+	dp__setbox(x, x+font.width-1, y, y+font.height-1);
+
+	usart1_txdata(0x2c);
+	gpio_toggle(DP_DC);
+	while (!usart1_tx_complete())
+		/* wait */;
+	gpio_toggle(DP_DC);
+
+	RAMFUNC_CALL(dp__putchar_pixels, &font.data[idx], mask,
+			(font.width * font.height + 1)/2, fg444, bg444);
 	while (!usart1_tx_complete())
 		/* wait */;
 }
@@ -490,14 +595,14 @@ struct dp_bitstream {
 	dp_bitstream_data_t mask;
 };
 
-static void
+static __always_inline void
 dp_bitstream_init(struct dp_bitstream *bs, const dp_bitstream_data_t *p)
 {
 	bs->p = p;
 	bs->mask = ((dp_bitstream_data_t)1) << (8*sizeof(dp_bitstream_data_t) - 1);
 }
 
-static dp_bitstream_data_t
+static __always_inline dp_bitstream_data_t
 dp_bitstream_pop(struct dp_bitstream *bs)
 {
 	dp_bitstream_data_t ret = *bs->p & bs->mask;
@@ -508,7 +613,7 @@ dp_bitstream_pop(struct dp_bitstream *bs)
 	return ret;
 }
 
-static unsigned int
+static __always_inline unsigned int
 dp_bitstream_get(struct dp_bitstream *bs)
 {
 	unsigned int ret;
@@ -526,7 +631,7 @@ dp_bitstream_get(struct dp_bitstream *bs)
 	return ret;
 }
 
-static int
+static __always_inline int
 dp_bitstream_gets(struct dp_bitstream *bs)
 {
 	int ret = 0;
@@ -540,26 +645,16 @@ dp_bitstream_gets(struct dp_bitstream *bs)
 	return ret + 1;
 }
 
-void
-dp_cimage(unsigned int x, unsigned int y, const struct dp_cimage *img)
+static __always_inline void
+dp__cimage_pixels_body(const dp_bitstream_data_t *data, unsigned int len)
 {
 	struct dp_bitstream bs;
-	unsigned int len = ((unsigned int)img->width) * ((unsigned int)img->height);
 	unsigned int run = 0;
 	uint8_t r = 0;
 	uint8_t g = 0;
 	uint8_t b = 0;
 
-	dp_bitstream_init(&bs, img->data);
-
-	dp_mode666();
-	dp__setbox(x, x + img->width - 1, y, y + img->height - 1);
-
-	usart1_txdata(0x2c);
-	gpio_toggle(DP_DC);
-	while (!usart1_tx_complete())
-		/* wait */;
-	gpio_toggle(DP_DC);
+	dp_bitstream_init(&bs, data);
 
 	for (; len; len--) {
 		if (run == 0)
@@ -583,15 +678,36 @@ dp_cimage(unsigned int x, unsigned int y, const struct dp_cimage *img)
 			/* wait */;
 		usart1_txdata(b);
 	}
+}
+RAMFUNC_DEFINE(dp__cimage_pixels,
+		(const dp_bitstream_data_t *data, unsigned int len), (data, len))
+
+void
+dp_cimage(unsigned int x, unsigned int y, const struct dp_cimage *img)
+{
+	unsigned int len = ((unsigned int)img->width) * ((unsigned int)img->height);
+
+	dp_mode666();
+	dp__setbox(x, x + img->width - 1, y, y + img->height - 1);
+
+	usart1_txdata(0x2c);
+	gpio_toggle(DP_DC);
+	while (!usart1_tx_complete())
+		/* wait */;
+	gpio_toggle(DP_DC);
+
+	RAMFUNC_CALL(dp__cimage_pixels, img->data, len);
 	while (!usart1_tx_complete())
 		/* wait */;
 	dp_mode444();
 }
 
-FRESULT
-dp_showbmp(FIL *f, unsigned int x, unsigned int y)
+/* one row of a 240 pixel wide 24bit bitmap */
+#define BMP_ROW (3 * 240)
+
+static FRESULT
+dp__showbmp(FIL *f, unsigned int x, unsigned int y, uint8_t *buf)
 {
-	uint8_t buf[720];
 	unsigned int bfSize;
 	unsigned int bfOffBits;
 	unsigned int biSize;
@@ -667,6 +783,10 @@ dp_showbmp(FIL *f, unsigned int x, unsigned int y)
 	         | (((unsigned int)buf[6]) << 16)
 	         | (((unsigned int)buf[7]) << 24);
 	debug("biWidth x biHeight = %u x %d\r\n", biWidth, biHeight);
+	if (3 * biWidth > BMP_ROW) {
+		debug("error reading bitmap: too wide\r\n");
+		return FR_INVALID_PARAMETER;
+	}
 
 	biPlanes = (((uint16_t)buf[8]) <<  0)
 	         | (((uint16_t)buf[9]) <<  8);
@@ -724,6 +844,7 @@ dp_showbmp(FIL *f, unsigned int x, unsigned int y)
 	for (; biHeight > 0; biHeight--) {
 		unsigned int bytes = 3 * biWidth;
 		uint8_t *p, *end;
+		CYCLES_BEGIN(showbmp_row);
 
 		res = f_lseek(f, pos);
 		if (res != FR_OK) {
@@ -756,6 +877,7 @@ dp_showbmp(FIL *f, unsigned int x, unsigned int y)
 			usart1_txdata(p[0]);
 		}
 		pos += linesize;
+		CYCLES_END(showbmp_row);
 	}
 out:
 	while (!usart1_tx_complete())
@@ -764,23 +886,44 @@ out:
 	return res;
 }
 
+FRESULT
+dp_showbmp(FIL *f, unsigned int x, unsigned int y)
+{
+	unsigned int mark = arena_mark();
+	uint8_t *buf = arena_alloc(BMP_ROW);
+	FRESULT res = FR_NOT_ENOUGH_CORE;
+
+	if (buf)
+		res = dp__showbmp(f, x, y, buf);
+	arena_release(mark);
+	return res;
+}
+
 FRESULT
 dp_showbmp_at(const char *path, unsigned int x, unsigned int y)
 {
-	FIL f;
+	unsigned int mark = arena_mark();
+	FIL *f = arena_alloc(sizeof(*f));
 	FRESULT res;
 
-	res = f_open(&f, path, FA_READ);
+	if (f == NULL) {
+		res = FR_NOT_ENOUGH_CORE;
+		goto out;
+	}
+	res = f_open(f, path, FA_READ);
 	if (res != FR_OK) {
 		debug("f_open(f, \"%s\", FA_READ) = %u\r\n", path, res);
 		goto err;
 	}
-	res = dp_showbmp(&f, x, y);
+	res = dp_showbmp(f, x, y);
 	if (res != FR_OK)
 		goto err;
 
-	return f_close(&f);
+	res = f_close(f);
+	goto out;
 err:
-	f_close(&f);
+	f_close(f);
+out:
+	arena_release(mark);
 	return res;
 }
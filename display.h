@@ -55,6 +55,10 @@ void dp_off(void);
 void dp_on(void);
 void dp_init(void);
 void dp_uninit(void);
+void dp_clock_update(void);
+void dp_clock_get(uint32_t *write, uint32_t *read);
+void dp_clock_set(uint32_t write, uint32_t read);
+bool dp_verify(unsigned int y, unsigned int seed);
 
 void dp_fill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned int rgb444);
 void dp_fill666(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned int rgb);
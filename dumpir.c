@@ -63,47 +63,51 @@ dumpir(void)
 
 	j = 0;
 	while (1) {
+		struct event ev;
 		int ch;
 		const char *p;
 
-		switch (event_get()) {
+		event_pend(&ev);
+		switch (ev.type) {
 		case 1:
 			ir_uninit();
 			return;
 		case 2:
 			for (p = "Hello World!\n"; *p != '\0'; p++)
 				ir_send((uint8_t)*p);
-			break;
-		}
-
-		ch = ir_recv();
-		if (ch < 0)
 			continue;
-
-		switch (ch) {
-		case '\n':
-			lines[j][i] = '\0';
-			j += 1;
-			if (j == 10)
-				j = 0;
-			i = 0;
-			lines[j][i] = '\0';
-			rerender(lines, j);
+		case EV_IR_RX:
 			break;
 		default:
-			lines[j][i] = ch;
-			if (i == 19) {
+			continue;
+		}
+
+		while ((ch = ir_recv()) >= 0) {
+			switch (ch) {
+			case '\n':
+				lines[j][i] = '\0';
 				j += 1;
 				if (j == 10)
 					j = 0;
 				i = 0;
 				lines[j][i] = '\0';
 				rerender(lines, j);
-			} else {
-				dp_putchar(i*font.width, 9*font.height, 0xAAA, 0x000, ch);
-				i += 1;
+				break;
+			default:
+				lines[j][i] = ch;
+				if (i == 19) {
+					j += 1;
+					if (j == 10)
+						j = 0;
+					i = 0;
+					lines[j][i] = '\0';
+					rerender(lines, j);
+				} else {
+					dp_putchar(i*font.width, 9*font.height, 0xAAA, 0x000, ch);
+					i += 1;
+				}
+				break;
 			}
-			break;
 		}
 	}
 }
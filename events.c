@@ -17,57 +17,223 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "geckonator/common.h"
 
-#define EVENTS_MAX 32
+#include "task.h"
+#include "power.h"
+#include "events.h"
+#include "latency.h"
+#include "photon.h"
 
-static uint8_t events[EVENTS_MAX];
-static volatile unsigned int events_head;
-static volatile unsigned int events_tail;
+#define EVENTS_MAX 16 /* per priority, must be a power of 2 */
+
+enum {
+	PRIO_NORMAL,
+	PRIO_HIGH,
+};
+
+struct event_queue {
+	struct event ev[EVENTS_MAX];
+	/* free running, only the low bits index ev[] */
+	volatile unsigned int head;
+	volatile unsigned int tail;
+};
+
+static struct event_queue queue[2];
+static struct event_stats stats;
+
+/* the rest of a coalesced event, see event_legacy() */
+static uint8_t legacy_type;
+static uint16_t legacy_left;
 
 void
-event_add(uint8_t ev)
+event_post(uint8_t type, uint16_t arg, unsigned int flags)
 {
+	unsigned int prio = (flags & EVENT_HIGH) ? PRIO_HIGH : PRIO_NORMAL;
+	struct event_queue *q = &queue[prio];
+	struct event *e;
+	unsigned int head;
 	unsigned int tail;
 
-	__disable_irq();
-	tail = events_tail;
-	events[tail] = ev;
-	tail = (tail + 1) % EVENTS_MAX;
-	if (tail != events_head)
-		events_tail = tail;
-	__enable_irq();
+	irq_off();
+	stats.posted += 1;
+	head = q->head;
+	tail = q->tail;
+	if (flags & EVENT_COALESCE) {
+		for (; head != tail; head++) {
+			e = &q->ev[head % EVENTS_MAX];
+			if (e->type != type || !(e->flags & EVENT_COALESCE))
+				continue;
+
+			if (arg > 0xFFFFU - e->arg)
+				e->arg = 0xFFFFU;
+			else
+				e->arg += arg;
+			stats.coalesced += 1;
+			goto out;
+		}
+		head = q->head;
+	}
+	if (tail - head == EVENTS_MAX) {
+		stats.dropped[prio] += 1;
+		goto out;
+	}
+	e = &q->ev[tail % EVENTS_MAX];
+	e->type = type;
+	e->flags = flags;
+	e->arg = arg;
+	q->tail = ++tail;
+	if (tail - head > stats.highwater[prio])
+		stats.highwater[prio] = tail - head;
+out:
+	irq_on();
 }
 
-static uint8_t
-event_pop(void)
+static bool
+events_pending(void)
 {
-	unsigned int head = events_head;
-	uint8_t ret = events[head];
+	return queue[PRIO_HIGH].head != queue[PRIO_HIGH].tail
+		|| queue[PRIO_NORMAL].head != queue[PRIO_NORMAL].tail;
+}
 
-	events_head = (head + 1) % EVENTS_MAX;
+bool
+event_poll(struct event *ev)
+{
+	struct event_queue *q;
+	bool ret = false;
+
+	photon_poll();
+	irq_off();
+	q = &queue[PRIO_HIGH];
+	if (q->head == q->tail) {
+		q = &queue[PRIO_NORMAL];
+		if (q->head == q->tail)
+			goto out;
+	}
+	*ev = q->ev[q->head % EVENTS_MAX];
+	q->head += 1;
+	ret = true;
+out:
+	irq_on();
+	if (ret)
+		photon_dequeued(ev->type);
 	return ret;
 }
 
+void
+event_pend(struct event *ev)
+{
+	while (!event_poll(ev)) {
+		/* background tasks run while we wait */
+		if (task_run())
+			continue;
+		/* WFI wakes up on pending interrupts even
+		 * when masked, so this can't miss an event
+		 * posted right after the check */
+		irq_off();
+		if (!events_pending() && !task_ready()) {
+			power_sleep();
+			irq_woken();
+		}
+		irq_on();
+	}
+}
+
+void
+events_stats(struct event_stats *st)
+{
+	irq_off();
+	*st = stats;
+	irq_on();
+}
+
+void
+events_stats_reset(void)
+{
+	irq_off();
+	memset(&stats, 0, sizeof(stats));
+	irq_on();
+}
+
+void
+event_add(uint8_t ev)
+{
+	event_post(ev, 0, 0);
+}
+
+/*
+ * The legacy calls only return the type, so a coalesced
+ * app event, like key repeats and ticks, is handed out
+ * once for every time it was posted. System events keep
+ * their arg for event_pend() users, it isn't a count.
+ */
+static uint8_t
+event_legacy(const struct event *ev)
+{
+	if ((ev->flags & EVENT_COALESCE) && ev->type < EV_SYSTEM && ev->arg > 1) {
+		legacy_type = ev->type;
+		legacy_left = ev->arg - 1;
+	}
+	return ev->type;
+}
+
 uint8_t
 event_get(void)
 {
-	if (events_head == events_tail)
+	struct event ev;
+
+	if (legacy_left) {
+		legacy_left -= 1;
+		return legacy_type;
+	}
+	if (!event_poll(&ev))
 		return 0;
-	return event_pop();
+	return event_legacy(&ev);
 }
 
 uint8_t
 event_wait(void)
 {
-	while (events_head == events_tail)
-		__WFI();
-	return event_pop();
+	struct event ev;
+
+	if (legacy_left) {
+		legacy_left -= 1;
+		return legacy_type;
+	}
+	event_pend(&ev);
+	return event_legacy(&ev);
+}
+
+int
+event_peek(void)
+{
+	struct event_queue *q;
+	int ret = -1;
+
+	if (legacy_left)
+		return legacy_type;
+	irq_off();
+	q = &queue[PRIO_HIGH];
+	if (q->head == q->tail)
+		q = &queue[PRIO_NORMAL];
+	if (q->head != q->tail)
+		ret = q->ev[q->head % EVENTS_MAX].type;
+	irq_on();
+	return ret;
 }
 
+/*
+ * Doesn't touch the interrupt mask, so callers
+ * like buttons_config() can keep interrupts
+ * disabled across clearing and reconfiguring.
+ */
 void
 events_clear(void)
 {
-	events_head = events_tail;
+	queue[PRIO_HIGH].head = queue[PRIO_HIGH].tail;
+	queue[PRIO_NORMAL].head = queue[PRIO_NORMAL].tail;
+	legacy_left = 0;
 }
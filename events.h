@@ -20,7 +20,48 @@
 #define _EVENTS_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
+/*
+ * Event types 1 to 127 belong to the running app
+ * and are usually handed out through its button_config.
+ * Types from EV_SYSTEM and up are reserved for drivers
+ * and should be listed here so they never collide.
+ */
+#define EV_SYSTEM 0x80
+
+enum {
+	EV_IR_RX = EV_SYSTEM, /* arg: new bytes waiting in ir_recv() */
+	EV_IR_TICK,           /* irlink.c timeouts */
+	EV_CIR_KEY,           /* arg: remote (address << 8) | command */
+	EV_CIR_REPEAT,        /* arg: times the key was repeated */
+	EV_BEACON,            /* arg: beacon.c wake up or sleep */
+};
+
+struct event {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t arg;
+};
+
+/* flags for event_post(), coalesced events add up their arg */
+#define EVENT_HIGH     0x01 /* queue ahead of normal events, eg. input */
+#define EVENT_COALESCE 0x02 /* merge into a pending event of the same type */
+
+struct event_stats {
+	uint32_t posted;
+	uint32_t coalesced;
+	uint32_t dropped[2];
+	uint8_t highwater[2];
+};
+
+void event_post(uint8_t type, uint16_t arg, unsigned int flags);
+bool event_poll(struct event *ev);
+void event_pend(struct event *ev);
+void events_stats(struct event_stats *st);
+void events_stats_reset(void);
+
+/* legacy interface, type only, coalesced app events come once per post */
 void event_add(uint8_t ev);
 uint8_t event_get(void);
 uint8_t event_wait(void);
@@ -26,14 +26,7 @@
 #include "display.h"
 #include "ff.h"
 #include "filepicker.h"
-
-struct dirbuf {
-	unsigned int offset;
-	unsigned int sel;
-	unsigned int end;
-	unsigned int max;
-	char entry[20][14];
-};
+#include "arena.h"
 
 enum events {
 	EV_UP = 1,
@@ -174,11 +167,10 @@ dirbuf_dec(struct dirbuf *db, const char *path)
 	return dirbuf_fill(db, path);
 }
 
-FRESULT
-filepicker(FATFS *fs, char *buf, size_t len,
+static FRESULT
+filepicker__run(struct dirbuf *db, FATFS *fs, char *buf, size_t len,
 		unsigned int fg444, unsigned int bg444)
 {
-	struct dirbuf db;
 	unsigned int end;
 	FRESULT res;
 
@@ -192,34 +184,34 @@ filepicker(FATFS *fs, char *buf, size_t len,
 	buf[end] = '\0';
 
 restart:
-	res = dirbuf_init(&db, buf);
+	res = dirbuf_init(db, buf);
 	if (res != FR_OK)
 		return res;
-	dirbuf_render(&db, fg444, bg444);
+	dirbuf_render(db, fg444, bg444);
 	buttons_config(buttons);
 
 	while (1) {
 		switch (event_wait()) {
 		case EV_UP:
-			if (db.sel == 0)
+			if (db->sel == 0)
 				break;
-			res = dirbuf_dec(&db, buf);
+			res = dirbuf_dec(db, buf);
 			if (res != FR_OK)
 				return res;
-			dirbuf_render(&db, fg444, bg444);
+			dirbuf_render(db, fg444, bg444);
 			break;
 		case EV_DOWN:
-			if (db.sel + 1 == db.max)
+			if (db->sel + 1 == db->max)
 				break;
-			res = dirbuf_inc(&db, buf);
+			res = dirbuf_inc(db, buf);
 			if (res != FR_OK)
 				return res;
-			dirbuf_render(&db, fg444, bg444);
+			dirbuf_render(db, fg444, bg444);
 			break;
 		case EV_ENTER:
 			{
 				unsigned int k = end;
-				const char *p = db.entry[db.sel - db.offset];
+				const char *p = db->entry[db->sel - db->offset];
 
 				buf[k++] = '/';
 				while (k < len && *p != '\0')
@@ -249,3 +241,17 @@ restart:
 		}
 	}
 }
+
+FRESULT
+filepicker(FATFS *fs, char *buf, size_t len,
+		unsigned int fg444, unsigned int bg444)
+{
+	unsigned int mark = arena_mark();
+	struct dirbuf *db = arena_alloc(sizeof(*db));
+	FRESULT res = FR_NOT_ENOUGH_CORE;
+
+	if (db)
+		res = filepicker__run(db, fs, buf, len, fg444, bg444);
+	arena_release(mark);
+	return res;
+}
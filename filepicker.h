@@ -23,6 +23,16 @@
 
 #include "ff.h"
 
+/* the slice of a directory shown on screen */
+struct dirbuf {
+	unsigned int offset;
+	unsigned int sel;
+	unsigned int end;
+	unsigned int max;
+	char entry[20][14];
+};
+
+void dirbuf_render(struct dirbuf *db, unsigned int fg444, unsigned int bg444);
 FRESULT filepicker(FATFS *fs, char *buf, size_t len,
 		unsigned int fg444, unsigned int bg444);
 
@@ -0,0 +1,126 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Run recorded remote control frames through cir.c.
+ *
+ *   ./cirdec [file]
+ *
+ * Every line is a frame of +N (light) and -N (dark)
+ * durations in microseconds, so both demodulated
+ * pulses and the raw carrier can be fed in. A comment
+ * like "# expect: NEC 0x04 0x08" checks the next frame,
+ * and the exit status tells if all of them matched.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "cir.h"
+
+static void
+describe(char *buf, size_t len, const uint16_t *us, unsigned int n)
+{
+	struct cir_code code;
+
+	if (cir_decode(us, n, &code)) {
+		snprintf(buf, len, "unknown");
+		return;
+	}
+	if (code.flags & CIR_REPEAT) {
+		snprintf(buf, len, "%s repeat", cir_name(code.protocol));
+		return;
+	}
+	snprintf(buf, len, "%s 0x%02X 0x%02X%s", cir_name(code.protocol),
+			code.address, code.command,
+			(code.flags & CIR_TOGGLE) ? " toggle" : "");
+}
+
+int
+main(int argc, char *argv[])
+{
+	FILE *f = stdin;
+	char line[4096];
+	char expect[64] = "";
+	unsigned int lineno = 0;
+	unsigned int frames = 0;
+	unsigned int failed = 0;
+
+	if (argc > 1) {
+		f = fopen(argv[1], "r");
+		if (f == NULL) {
+			perror(argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		struct cir_rx rx;
+		char got[64];
+		char *p = line;
+		unsigned int n;
+
+		lineno += 1;
+		p += strspn(p, " \t");
+		if (*p == '#') {
+			p += 1;
+			p += strspn(p, " \t");
+			if (strncmp(p, "expect:", 7) == 0) {
+				p += 7;
+				p += strspn(p, " \t");
+				snprintf(expect, sizeof(expect), "%.*s",
+						(int)strcspn(p, "\r\n"), p);
+			}
+			continue;
+		}
+		if (*p == '\n' || *p == '\0')
+			continue;
+
+		cir_rx_init(&rx);
+		while (*p != '\0') {
+			char *end;
+			long v = strtol(p, &end, 10);
+
+			if (end == p) {
+				if (*p == '\n' || *p == ' ' || *p == '\t') {
+					p += 1;
+					continue;
+				}
+				fprintf(stderr, "line %u: bad duration '%c'\n", lineno, *p);
+				return EXIT_FAILURE;
+			}
+			cir_edge(&rx, v > 0, v > 0 ? v : -v);
+			p = end;
+		}
+		n = cir_end(&rx);
+
+		frames += 1;
+		describe(got, sizeof(got), rx.us, n);
+		if (expect[0] != '\0' && strcmp(got, expect)) {
+			printf("line %u: %s, expected %s\n", lineno, got, expect);
+			failed += 1;
+		} else
+			printf("line %u: %s (%u pulses)\n", lineno, got, n);
+		expect[0] = '\0';
+	}
+
+	printf("%u frames, %u failed\n", frames, failed);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
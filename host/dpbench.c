@@ -0,0 +1,354 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * What drawing costs on the display bus. Every primitive
+ * in display.c and the two list renderers run once on the
+ * simulated badge, and the command bytes, data bytes and
+ * D/CX toggles they cause are turned into milliseconds at
+ * the 12MHz DP_CLOCKDIV_WRITE clock.
+ *
+ *   ./dpbench [-b baseline] [-o report.json] [-t percent] [-w]
+ *
+ * The results are checked against the baseline, by default
+ * the dpbench.baseline next to the program, and any case
+ * that got more than percent (default 2) slower or toggles
+ * D/CX more often is a regression. -w writes the results
+ * as the new baseline instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "fatdisk.h"
+
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "filepicker.h"
+
+#define SPI_HZ     12000000U
+#define CASES_MAX  16
+#define FG444      0xCB0
+#define BG444      0x000
+
+struct result {
+	char name[24];
+	struct lcd_stats st;
+	double ms;
+	/* from the baseline */
+	bool known;
+	uint32_t base_bytes;
+	uint32_t base_toggles;
+	double base_ms;
+};
+
+static struct result results[CASES_MAX];
+static unsigned int nresults;
+
+extern const struct dp_cimage logo;
+
+static double
+bytes_ms(uint32_t bytes)
+{
+	return bytes * 8 * 1000.0 / SPI_HZ;
+}
+
+static void
+measure(const char *name, void (*fn)(void))
+{
+	struct result *r = &results[nresults++];
+
+	lcd_stats_reset();
+	fn();
+	lcd_stats(&r->st);
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->ms = bytes_ms(r->st.cmd_bytes + r->st.data_bytes);
+}
+
+static void
+fill_screen(void)
+{
+	dp_fill(0, 0, 240, 240, BG444);
+}
+
+static void
+fill_line(void)
+{
+	dp_fill(0, 0, 240, font.height, FG444);
+}
+
+static void
+putchar_one(void)
+{
+	dp_putchar(0, 0, FG444, BG444, 'A');
+}
+
+static void
+puts_line(void)
+{
+	dp_puts(0, 0, FG444, BG444, "The quick brown fox!");
+}
+
+static void
+cimage_logo(void)
+{
+	dp_cimage(0, 10, &logo);
+}
+
+static void
+image565_64(void)
+{
+	static struct {
+		struct dp_image565 img;
+		uint8_t data[2 * 64 * 64];
+	} pic = { .img = { .width = 64, .height = 64 } };
+
+	dp_image565(88, 88, &pic.img);
+}
+
+static void
+showbmp_240(void)
+{
+	if (dp_showbmp_at("/PICS/BIG.BMP", 0, 0) != FR_OK) {
+		fprintf(stderr, "dp_showbmp_at() failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* the real one from main.c, so the labels can't go stale */
+static void
+menu_main(void)
+{
+	size_t len;
+	const struct menuitem *items = main_menu_items(&len);
+
+	menu_render(FG444, BG444, items, len, 3);
+}
+
+static void
+dirbuf_20(void)
+{
+	static struct dirbuf db = { .end = 20, .max = 20, .sel = 5, };
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(db.entry); i++)
+		snprintf(db.entry[i], sizeof(db.entry[i]), "F%05u.TXT", i);
+	dirbuf_render(&db, FG444, BG444);
+}
+
+static struct result *
+find(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < nresults; i++) {
+		if (strcmp(results[i].name, name) == 0)
+			return &results[i];
+	}
+	return NULL;
+}
+
+/* lines of "name cmd_bytes data_bytes dc_toggles" */
+static int
+read_baseline(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[128];
+
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char name[24];
+		unsigned long cmd, data, toggles;
+		struct result *r;
+
+		if (line[0] == '#' || sscanf(line, "%23s %lu %lu %lu",
+					name, &cmd, &data, &toggles) != 4)
+			continue;
+		r = find(name);
+		if (r == NULL)
+			continue;
+		r->known = true;
+		r->base_bytes = cmd + data;
+		r->base_toggles = toggles;
+		r->base_ms = bytes_ms(cmd + data);
+	}
+	fclose(f);
+	return 0;
+}
+
+static int
+write_baseline(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	unsigned int i;
+
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	fprintf(f, "# written by dpbench -w: name cmd_bytes data_bytes dc_toggles\n");
+	for (i = 0; i < nresults; i++) {
+		const struct result *r = &results[i];
+
+		fprintf(f, "%s %lu %lu %lu\n", r->name,
+				(unsigned long)r->st.cmd_bytes,
+				(unsigned long)r->st.data_bytes,
+				(unsigned long)r->st.dc_toggles);
+	}
+	return fclose(f);
+}
+
+static bool
+regressed(const struct result *r, double percent)
+{
+	if (!r->known)
+		return false;
+	return r->ms > r->base_ms * (1 + percent / 100)
+		|| r->st.dc_toggles > r->base_toggles;
+}
+
+static int
+write_report(const char *path, double percent)
+{
+	FILE *f = fopen(path, "w");
+	unsigned int i;
+
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	fprintf(f, "{\n  \"spi_hz\": %u,\n  \"tolerance_percent\": %g,\n  \"results\": [\n",
+			SPI_HZ, percent);
+	for (i = 0; i < nresults; i++) {
+		const struct result *r = &results[i];
+
+		fprintf(f, "    { \"name\": \"%s\", \"cmd_bytes\": %lu, \"data_bytes\": %lu, "
+				"\"dc_toggles\": %lu, \"ms\": %.3f",
+				r->name,
+				(unsigned long)r->st.cmd_bytes,
+				(unsigned long)r->st.data_bytes,
+				(unsigned long)r->st.dc_toggles, r->ms);
+		if (r->known)
+			fprintf(f, ", \"limit_ms\": %.3f, \"limit_dc_toggles\": %lu, \"pass\": %s",
+					r->base_ms * (1 + percent / 100),
+					(unsigned long)r->base_toggles,
+					regressed(r, percent) ? "false" : "true");
+		fprintf(f, " }%s\n", i + 1 < nresults ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	return fclose(f);
+}
+
+/* dpbench.baseline in the directory of the program */
+static char *
+default_baseline(const char *prog)
+{
+	const char *slash = strrchr(prog, '/');
+	int dir = slash ? slash - prog + 1 : 0;
+	size_t len = dir + sizeof("dpbench.baseline");
+	char *path = malloc(len);
+
+	snprintf(path, len, "%.*sdpbench.baseline", dir, prog);
+	return path;
+}
+
+static void __noreturn
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-b baseline] [-o report.json] [-t percent] [-w]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *baseline = NULL;
+	const char *report = NULL;
+	double percent = 2;
+	bool write = false;
+	unsigned int failed = 0;
+	unsigned int i;
+	FATFS fs;
+
+	for (i = 1; i < (unsigned int)argc; i++) {
+		const char *arg = argv[i];
+
+		if (strcmp(arg, "-w") == 0) {
+			write = true;
+			continue;
+		}
+		if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0' || i + 1 >= (unsigned int)argc)
+			usage(argv[0]);
+		i += 1;
+		switch (arg[1]) {
+		case 'b': baseline = argv[i]; break;
+		case 'o': report = argv[i]; break;
+		case 't': percent = strtod(argv[i], NULL); break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (baseline == NULL)
+		baseline = default_baseline(argv[0]);
+
+	fatdisk_make(0, false);
+	dp_init();
+	if (f_mount(&fs, "", 1) != FR_OK) {
+		fprintf(stderr, "cannot mount the made up card\n");
+		return EXIT_FAILURE;
+	}
+
+	measure("fill_screen", fill_screen);
+	measure("fill_line", fill_line);
+	measure("putchar", putchar_one);
+	measure("puts_20", puts_line);
+	measure("cimage_logo", cimage_logo);
+	measure("image565_64", image565_64);
+	measure("showbmp_240", showbmp_240);
+	measure("menu_render", menu_main);
+	measure("dirbuf_render", dirbuf_20);
+
+	if (write)
+		return write_baseline(baseline) ? EXIT_FAILURE : EXIT_SUCCESS;
+	if (read_baseline(baseline))
+		return EXIT_FAILURE;
+
+	printf("%-14s %9s %9s %7s %9s %9s\n", "", "cmd", "data", "dc", "ms", "baseline");
+	for (i = 0; i < nresults; i++) {
+		const struct result *r = &results[i];
+		bool bad = regressed(r, percent);
+
+		printf("%-14s %9lu %9lu %7lu %9.3f", r->name,
+				(unsigned long)r->st.cmd_bytes,
+				(unsigned long)r->st.data_bytes,
+				(unsigned long)r->st.dc_toggles, r->ms);
+		if (r->known)
+			printf(" %9.3f%s", r->base_ms, bad ? "  REGRESSION" : "");
+		printf("\n");
+		failed += bad;
+	}
+	if (report && write_report(report, percent))
+		return EXIT_FAILURE;
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
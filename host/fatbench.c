@@ -0,0 +1,210 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measure what FatFs asks of the SD card for the things
+ * the badge does with it: mounting, listing a directory
+ * like the file picker, looking up a file and drawing a
+ * bitmap like dp_showbmp().
+ *
+ *   ./fatbench [-n files] [-f] [-m spi_hz,cmd_us,read_us,write_us]
+ *   ./fatbench -i sdcard.img [-d dir] [-b bitmap] [-m ...]
+ *
+ * Without an image a volume is made up by fatdisk_make(),
+ * and -f fragments it.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+
+#include "fatdisk.h"
+
+static uint32_t
+get32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* the reads dp_showbmp() does, without the drawing */
+static FRESULT
+read_bitmap(const char *path)
+{
+	uint8_t buf[720];
+	FRESULT res;
+	UINT read;
+	FIL f;
+	int32_t width, height;
+	uint32_t linesize, bytes;
+	int32_t step;
+	uint32_t pos;
+
+	res = f_open(&f, path, FA_READ);
+	if (res != FR_OK)
+		return res;
+	res = f_read(&f, buf, 54, &read);
+	if (res != FR_OK || read < 54)
+		goto out;
+
+	width = get32(&buf[18]);
+	height = get32(&buf[22]);
+	if (width <= 0 || 3 * width > (int32_t)sizeof(buf)) {
+		res = FR_INVALID_PARAMETER;
+		goto out;
+	}
+	bytes = 3 * width;
+	linesize = (bytes + 3) & ~3U;
+	if (height >= 0) {
+		pos = get32(&buf[10]) + linesize * (height - 1);
+		step = -(int32_t)linesize;
+	} else {
+		height = -height;
+		pos = get32(&buf[10]);
+		step = linesize;
+	}
+
+	for (; height > 0; height--) {
+		res = f_lseek(&f, pos);
+		if (res != FR_OK)
+			break;
+		res = f_read(&f, buf, bytes, &read);
+		if (res != FR_OK)
+			break;
+		pos += step;
+	}
+out:
+	f_close(&f);
+	return res;
+}
+
+/* what the file picker does to fill its list */
+static FRESULT
+list_dir(const char *path, char *last, unsigned int *entries)
+{
+	FILINFO fi;
+	FRESULT res;
+	DIR dir;
+
+	*entries = 0;
+	res = f_opendir(&dir, path);
+	if (res != FR_OK)
+		return res;
+	while (1) {
+		res = f_readdir(&dir, &fi);
+		if (res != FR_OK || fi.fname[0] == '\0')
+			break;
+		if (fi.fattrib & AM_DIR)
+			continue;
+		strcpy(last, fi.fname);
+		*entries += 1;
+	}
+	f_closedir(&dir);
+	return res;
+}
+
+static void
+report(const char *name, FRESULT res)
+{
+	struct fatdisk_stats st;
+
+	if (res != FR_OK) {
+		fprintf(stderr, "%s: error %u\n", name, res);
+		exit(EXIT_FAILURE);
+	}
+	fatdisk_stats(&st);
+	fatdisk_print(name, &st);
+	fatdisk_stats_reset();
+}
+
+static void __attribute__((noreturn))
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n files] [-f] [-m spi_hz,cmd_us,read_us,write_us]\n"
+		"       %s -i sdcard.img [-d dir] [-b bitmap] [-m ...]\n",
+		prog, prog);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct fatdisk_model model = fatdisk_default;
+	const char *img = NULL;
+	const char *dir = NULL;
+	const char *bitmap = NULL;
+	unsigned int files = 200;
+	bool fragmented = false;
+	char last[13] = "";
+	char path[64];
+	unsigned int entries;
+	FATFS fs;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+
+		if (strcmp(arg, "-f") == 0) {
+			fragmented = true;
+			continue;
+		}
+		if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0' || i + 1 >= argc)
+			usage(argv[0]);
+		i += 1;
+		switch (arg[1]) {
+		case 'n': files = strtoul(argv[i], NULL, 0); break;
+		case 'i': img = argv[i]; break;
+		case 'd': dir = argv[i]; break;
+		case 'b': bitmap = argv[i]; break;
+		case 'm':
+			if (fatdisk_parse(&model, argv[i]))
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (img) {
+		if (fatdisk_open(img))
+			return EXIT_FAILURE;
+		if (dir == NULL)
+			dir = "/";
+	} else {
+		fatdisk_make(files, fragmented);
+		dir = "/PICS";
+		bitmap = "/PICS/BIG.BMP";
+		printf("%u files in %s, %s\n", files, dir,
+				fragmented ? "fragmented" : "contiguous");
+	}
+	fatdisk_config(&model, NULL);
+
+	report("mount", f_mount(&fs, "", 1));
+	report("list", list_dir(dir, last, &entries));
+	if (entries > 0) {
+		snprintf(path, sizeof(path), "%s/%s",
+				strcmp(dir, "/") ? dir : "", last);
+		report("lookup last", f_stat(path, NULL));
+	}
+	if (bitmap)
+		report("bitmap", read_bitmap(bitmap));
+	return EXIT_SUCCESS;
+}
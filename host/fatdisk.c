@@ -0,0 +1,466 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "fatdisk.h"
+
+const struct fatdisk_model fatdisk_default = {
+	.spi_hz   = 12000000, /* SD_CLOCKDIV_RUN */
+	.init_hz  = 397351,   /* SD_CLOCKDIV_INIT */
+	.cmd_us   = 10,
+	.read_us  = 250,
+	.write_us = 1000,
+};
+
+static struct fatdisk_model custom;
+static const struct fatdisk_model *model = &fatdisk_default;
+static void (*busy)(uint64_t ns);
+static struct fatdisk_stats stats;
+static DSTATUS status = STA_NOINIT;
+static uint8_t *image;
+static uint32_t image_sectors;
+
+int
+fatdisk_open(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf;
+	long size;
+
+	if (f == NULL || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 512) {
+		fprintf(stderr, "%s: not a disk image\n", path);
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	rewind(f);
+	buf = malloc(size);
+	if (buf == NULL || fread(buf, 1, size, f) != (size_t)size) {
+		fprintf(stderr, "%s: cannot read image\n", path);
+		fclose(f);
+		free(buf);
+		return -1;
+	}
+	fclose(f);
+	fatdisk_load(buf, size / 512);
+	return 0;
+}
+
+void
+fatdisk_load(uint8_t *buf, uint32_t sectors)
+{
+	image = buf;
+	image_sectors = sectors;
+	status = STA_NOINIT;
+}
+
+/* "spi_hz,cmd_us,read_us,write_us", empty fields keep their value */
+int
+fatdisk_parse(struct fatdisk_model *m, const char *str)
+{
+	uint32_t *field[] = { &m->spi_hz, &m->cmd_us, &m->read_us, &m->write_us };
+	unsigned int i;
+
+	for (i = 0; i < 4 && *str; i++) {
+		char *end;
+
+		if (*str != ',') {
+			*field[i] = strtoul(str, &end, 0);
+			if (end == str || (*end != ',' && *end != '\0'))
+				return -1;
+			str = end;
+		}
+		if (*str == ',')
+			str++;
+	}
+	return (*str == '\0' && m->spi_hz > 0) ? 0 : -1;
+}
+
+void
+fatdisk_config(const struct fatdisk_model *m, void (*cb)(uint64_t ns))
+{
+	if (m) {
+		custom = *m;
+		model = &custom;
+	}
+	busy = cb;
+}
+
+void
+fatdisk_stats(struct fatdisk_stats *st)
+{
+	*st = stats;
+}
+
+void
+fatdisk_stats_reset(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void
+fatdisk_print(const char *name, const struct fatdisk_stats *st)
+{
+	printf("%-12s %6lu reads %6lu sectors %6lu cmds %9lu spi bytes %9.3f ms\n",
+			name,
+			(unsigned long)st->reads, (unsigned long)st->sectors_read,
+			(unsigned long)st->commands, (unsigned long)st->spi_bytes,
+			st->ns / 1e6);
+}
+
+/*
+ * Bus traffic, see sdcard.c for what goes over the wire
+ */
+static void
+spi(uint32_t bytes, uint32_t hz)
+{
+	uint64_t ns = (uint64_t)bytes * 8 * 1000000000 / hz;
+
+	stats.spi_bytes += bytes;
+	stats.ns += ns;
+	if (busy)
+		busy(ns);
+}
+
+/* 0xFF bytes clocked out while polling a busy card */
+static uint32_t
+polls(uint32_t us, uint32_t hz)
+{
+	uint64_t bytes = ((uint64_t)us * hz + 7999999) / 8000000;
+
+	return bytes ? bytes : 1;
+}
+
+/* sd__cmd(): 0xFF, 6 command bytes, 0xFF, R1 and the response */
+static void
+command(unsigned int len, uint32_t hz)
+{
+	stats.commands += 1;
+	spi(8 + polls(model->cmd_us, hz) + len, hz);
+}
+
+DSTATUS
+disk_status(BYTE pdrv)
+{
+	if (pdrv != 0)
+		return STA_NOINIT | STA_NODISK;
+	if (status & STA_NOINIT)
+		return status;
+
+	/* CMD13 */
+	command(1, model->spi_hz);
+	return status;
+}
+
+DSTATUS
+disk_initialize(BYTE pdrv)
+{
+	if (pdrv != 0)
+		return STA_NOINIT | STA_NODISK;
+
+	/* 80 clocks, CMD0, CMD8, CMD55, ACMD41 and CMD58 */
+	spi(10, model->init_hz);
+	command(0, model->init_hz);
+	command(4, model->init_hz);
+	command(0, model->init_hz);
+	command(0, model->init_hz);
+	command(4, model->init_hz);
+	if (image)
+		status = 0;
+	return status;
+}
+
+DRESULT
+disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != 0)
+		return RES_PARERR;
+	if (status & STA_NOINIT)
+		return RES_NOTRDY;
+
+	stats.reads += 1;
+	for (; count > 0; count--) {
+		if (sector >= image_sectors)
+			return RES_ERROR;
+		/* CMD17, then the data token, the block and its crc */
+		command(0, model->spi_hz);
+		spi(polls(model->read_us, model->spi_hz) + 512 + 2, model->spi_hz);
+		memcpy(buff, &image[(size_t)sector * 512], 512);
+		stats.sectors_read += 1;
+		sector += 1;
+		buff += 512;
+	}
+	return RES_OK;
+}
+
+/* writes only change the copy in memory */
+DRESULT
+disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != 0)
+		return RES_PARERR;
+	if (status & STA_NOINIT)
+		return RES_NOTRDY;
+
+	stats.writes += 1;
+	for (; count > 0; count--) {
+		if (sector >= image_sectors)
+			return RES_ERROR;
+		/* CMD24, token, block, crc, data response and busy */
+		command(0, model->spi_hz);
+		spi(1 + 512 + 2 + 1 + polls(model->write_us, model->spi_hz),
+				model->spi_hz);
+		memcpy(&image[(size_t)sector * 512], buff, 512);
+		stats.sectors_written += 1;
+		sector += 1;
+		buff += 512;
+	}
+	return RES_OK;
+}
+
+DRESULT
+disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	if (pdrv != 0)
+		return RES_PARERR;
+
+	switch (cmd) {
+	case CTRL_SYNC:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = image_sectors;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = 512;
+		return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+/*
+ * Made up volumes
+ */
+#define SECTORS      65536U
+#define SPC          4U      /* 2KiB clusters */
+#define RESERVED     4U
+#define ROOT_ENTRIES 512U
+#define FAT_SECTORS  64U
+#define ROOT_START   (RESERVED + 2 * FAT_SECTORS)
+#define DATA_START   (ROOT_START + ROOT_ENTRIES * 32 / 512)
+#define CLUSTER      (SPC * 512)
+#define CLUSTERS     ((SECTORS - DATA_START) / SPC)
+
+#define BMP_SIZE     240U
+#define BMP_BYTES    (54U + 3 * BMP_SIZE * BMP_SIZE)
+
+struct object {
+	uint32_t clusters;
+	uint32_t first;
+	uint32_t last;
+	uint32_t given;
+};
+
+static uint8_t *made;
+
+static void
+put16(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void
+put32(uint8_t *p, uint32_t v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+static uint8_t *
+cluster_data(uint32_t c)
+{
+	return &made[(DATA_START + (c - 2) * SPC) * 512];
+}
+
+static void
+fat_set(uint32_t c, uint32_t v)
+{
+	unsigned int i;
+
+	for (i = 0; i < 2; i++)
+		put16(&made[(RESERVED + i * FAT_SECTORS) * 512 + 2 * c], v);
+}
+
+/* give the object its next cluster */
+static uint32_t
+give(struct object *o, uint32_t *next)
+{
+	uint32_t c = (*next)++;
+
+	if (o->given == 0)
+		o->first = c;
+	else
+		fat_set(o->last, c);
+	fat_set(c, 0xFFFF);
+	o->last = c;
+	o->given += 1;
+	return c;
+}
+
+/* data of object o, one cluster at a time in chain order */
+static uint8_t *
+object_data(const struct object *o, uint32_t n)
+{
+	uint32_t c = o->first;
+
+	while (n--)
+		c = made[(RESERVED * 512) + 2 * c] | made[(RESERVED * 512) + 2 * c + 1] << 8;
+	return cluster_data(c);
+}
+
+static void
+dirent(uint8_t *e, const char *name, uint8_t attr, uint32_t first, uint32_t size)
+{
+	memset(e, ' ', 11);
+	memcpy(e, name, strlen(name));
+	e[11] = attr;
+	put16(&e[24], 0x4A21); /* 2017-01-01 */
+	put16(&e[26], first);
+	put32(&e[28], size);
+}
+
+/*
+ * Make up a FAT16 volume with a directory /PICS of small
+ * files and a 240x240 bitmap BIG.BMP as its last entry.
+ * With fragmented set the clusters of the directory and the
+ * bitmap are spread out between those of the small files,
+ * like on a card that has been written to for a while.
+ */
+void
+fatdisk_make(unsigned int files, bool fragmented)
+{
+	unsigned int entries = files + 3;
+	struct object dir = { .clusters = (entries * 32 + CLUSTER - 1) / CLUSTER };
+	struct object bmp = { .clusters = (BMP_BYTES + CLUSTER - 1) / CLUSTER };
+	struct object *small = calloc(files ? files : 1, sizeof(*small));
+	unsigned int per_round = files;
+	unsigned int done = 0;
+	uint32_t next = 2;
+	uint8_t *bs;
+	uint8_t *e;
+	unsigned int i;
+
+	made = calloc(SECTORS, 512);
+	if (made == NULL || small == NULL || dir.clusters + bmp.clusters + files > CLUSTERS) {
+		fprintf(stderr, "too many files\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bs = made;
+	memcpy(bs, "\xEB\x3C\x90" "MSWIN4.1", 11);
+	put16(&bs[11], 512);
+	bs[13] = SPC;
+	put16(&bs[14], RESERVED);
+	bs[16] = 2;
+	put16(&bs[17], ROOT_ENTRIES);
+	put16(&bs[19], 0);
+	bs[21] = 0xF8;
+	put16(&bs[22], FAT_SECTORS);
+	put32(&bs[32], SECTORS);
+	bs[36] = 0x80;
+	bs[38] = 0x29;
+	memcpy(&bs[43], "BADGE      FAT16   ", 19);
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+	fat_set(0, 0xFFF8);
+	fat_set(1, 0xFFFF);
+
+	if (fragmented) {
+		unsigned int rounds = dir.clusters > bmp.clusters ? dir.clusters : bmp.clusters;
+
+		per_round = (files + rounds - 1) / rounds;
+	}
+	if (!fragmented) {
+		while (dir.given < dir.clusters)
+			give(&dir, &next);
+		while (done < files)
+			give(&small[done++], &next);
+	}
+	while (dir.given < dir.clusters || bmp.given < bmp.clusters || done < files) {
+		if (dir.given < dir.clusters)
+			give(&dir, &next);
+		if (bmp.given < bmp.clusters)
+			give(&bmp, &next);
+		for (i = 0; i < per_round && done < files; i++)
+			give(&small[done++], &next);
+	}
+
+	dirent(&made[ROOT_START * 512], "PICS", 0x10, dir.first, 0);
+
+	/* directory entries spill over into the next clusters */
+	for (i = 0; i < entries; i++) {
+		char name[24];
+
+		e = object_data(&dir, i * 32 / CLUSTER) + (i * 32) % CLUSTER;
+		if (i == 0)
+			dirent(e, ".", 0x10, dir.first, 0);
+		else if (i == 1)
+			dirent(e, "..", 0x10, 0, 0);
+		else if (i < files + 2) {
+			sprintf(name, "F%05u  TXT", i - 2);
+			dirent(e, name, 0x20, small[i - 2].first, 32);
+			memcpy(cluster_data(small[i - 2].first), "not a picture, just taking space", 32);
+		} else
+			dirent(e, "BIG     BMP", 0x20, bmp.first, BMP_BYTES);
+	}
+
+	/* bottom up 24 bit bitmap */
+	{
+		uint8_t *buf = malloc(BMP_BYTES);
+
+		memset(buf, 0, BMP_BYTES);
+		buf[0] = 'B';
+		buf[1] = 'M';
+		put32(&buf[2], BMP_BYTES);
+		put32(&buf[10], 54);
+		put32(&buf[14], 40);
+		put32(&buf[18], BMP_SIZE);
+		put32(&buf[22], BMP_SIZE);
+		put16(&buf[26], 1);
+		put16(&buf[28], 24);
+		for (i = 54; i < BMP_BYTES; i++)
+			buf[i] = i;
+		for (i = 0; i < bmp.clusters; i++) {
+			uint32_t len = BMP_BYTES - i * CLUSTER;
+
+			memcpy(object_data(&bmp, i), &buf[i * CLUSTER],
+					len > CLUSTER ? CLUSTER : len);
+		}
+		free(buf);
+	}
+	free(small);
+
+	fatdisk_load(made, SECTORS);
+}
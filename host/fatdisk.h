@@ -0,0 +1,60 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FATDISK_H
+#define _FATDISK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * FatFs diskio layer on top of a disk image in memory.
+ * Every call is charged the SPI traffic the real sdcard.c
+ * would cause, with the card answering after the delays
+ * in the model.
+ */
+struct fatdisk_model {
+	uint32_t spi_hz;   /* clock once the card is up */
+	uint32_t init_hz;  /* clock during wakeup */
+	uint32_t cmd_us;   /* until the card answers a command */
+	uint32_t read_us;  /* until the data of a block read starts */
+	uint32_t write_us; /* busy after writing a block */
+};
+
+struct fatdisk_stats {
+	uint32_t reads;           /* disk_read calls */
+	uint32_t sectors_read;
+	uint32_t writes;          /* disk_write calls */
+	uint32_t sectors_written;
+	uint32_t commands;
+	uint32_t spi_bytes;
+	uint64_t ns;              /* time spent on the bus */
+};
+
+extern const struct fatdisk_model fatdisk_default;
+
+int fatdisk_open(const char *path);
+void fatdisk_load(uint8_t *image, uint32_t sectors);
+void fatdisk_make(unsigned int files, bool fragmented);
+int fatdisk_parse(struct fatdisk_model *m, const char *str);
+void fatdisk_config(const struct fatdisk_model *m, void (*busy)(uint64_t ns));
+void fatdisk_stats(struct fatdisk_stats *st);
+void fatdisk_stats_reset(void);
+void fatdisk_print(const char *name, const struct fatdisk_stats *st);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A simulated badge for irmedium running the same
+ * protocol code as the firmware.
+ *
+ *   ./irbench recv [baud]
+ *   ./irbench send [bytes] [baud]
+ *   ./irbench mesh [messages] [baud]
+ *
+ * recv and send push a stream through irpkt.c and
+ * check it, mesh floods messages with irmesh.c and
+ * counts what arrives. Start irmedium first and as
+ * many of these as you like.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ir.h"
+#include "irpkt.h"
+#include "irmesh.h"
+#include "irsim.h"
+
+#define QUIET_MS      3000
+#define MESH_QUIET_MS 10000 /* the others may still be sending */
+
+static size_t received;
+static bool mismatch;
+static unsigned long mesh_got;
+
+static uint8_t
+stream_byte(size_t i)
+{
+	return (i * 7 + (i >> 8)) ^ 0x5A;
+}
+
+static uint32_t
+ms_since(uint32_t start)
+{
+	return (irsim_now() - start) & 0xFFFFFFU;
+}
+
+static enum ir_rate
+parse_rate(const char *str)
+{
+	uint32_t baud = str ? strtoul(str, NULL, 0) : 9600;
+	enum ir_rate rate;
+
+	for (rate = IR_1200; rate < IR_RATES; rate++) {
+		if (ir_baud(rate) == baud)
+			return rate;
+	}
+	fprintf(stderr, "unsupported baud rate %lu\n", (unsigned long)baud);
+	exit(EXIT_FAILURE);
+}
+
+static void
+pkt_output(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	(void)p;
+	while (len--)
+		ir_send(*buf++);
+}
+
+static void
+pkt_deliver(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	(void)p;
+	for (i = 0; i < len; i++) {
+		if (buf[i] != stream_byte(received))
+			mismatch = true;
+		received += 1;
+	}
+}
+
+static void
+pkt_start(struct irpkt *p, enum ir_rate rate)
+{
+	irpkt_init(p, getpid(), ir_baud(rate));
+	p->output = pkt_output;
+	p->deliver = pkt_deliver;
+}
+
+static void
+pkt_poll(struct irpkt *p)
+{
+	int ch;
+
+	irsim_wait(1);
+	while ((ch = ir_recv()) >= 0)
+		irpkt_input(p, ch, irsim_now());
+	irpkt_poll(p, irsim_now());
+}
+
+static int
+bench_send(size_t bytes, enum ir_rate rate)
+{
+	static struct irpkt p;
+	uint32_t start = irsim_now();
+	size_t sent = 0;
+	uint32_t ms;
+
+	pkt_start(&p, rate);
+	while (sent < bytes || !irpkt_idle(&p)) {
+		uint8_t data[IRPKT_MTU];
+		size_t len = bytes - sent;
+		size_t i;
+
+		if (len > IRPKT_MTU)
+			len = IRPKT_MTU;
+		for (i = 0; i < len; i++)
+			data[i] = stream_byte(sent + i);
+		if (len > 0 && irpkt_send(&p, data, len))
+			sent += len;
+		pkt_poll(&p);
+		if (ms_since(p.rx_last) > 10 * QUIET_MS && ms_since(start) > 10 * QUIET_MS) {
+			fprintf(stderr, "peer lost\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	ms = ms_since(start);
+	printf("sent %lu bytes at %lu baud in %lu ms: %lu B/s, "
+			"%lu frames, %lu resent\n",
+			(unsigned long)bytes, (unsigned long)ir_baud(rate),
+			(unsigned long)ms,
+			(unsigned long)(ms ? bytes * 1000 / ms : 0),
+			(unsigned long)p.stats.tx_frames,
+			(unsigned long)p.stats.tx_resends);
+	return EXIT_SUCCESS;
+}
+
+static int
+bench_recv(enum ir_rate rate)
+{
+	static struct irpkt p;
+	uint32_t start = 0;
+	uint32_t ms;
+
+	pkt_start(&p, rate);
+	while (received == 0 || ms_since(p.rx_last) < QUIET_MS) {
+		pkt_poll(&p);
+		if (received == 0)
+			start = irsim_now();
+	}
+
+	ms = (p.rx_last - start) & 0xFFFFFFU;
+	printf("received %lu bytes in %lu ms: %lu B/s, %lu dups, %lu bad frames%s\n",
+			(unsigned long)received, (unsigned long)ms,
+			(unsigned long)(ms ? received * 1000 / ms : 0),
+			(unsigned long)p.stats.rx_dups,
+			(unsigned long)p.rx.errors,
+			mismatch ? ", CORRUPTED" : "");
+	return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void
+mesh_output(struct irmesh *m, const uint8_t *buf, size_t len)
+{
+	(void)m;
+	while (len--)
+		ir_send(*buf++);
+}
+
+static void
+mesh_deliver(struct irmesh *m, uint16_t origin, uint8_t hops,
+		const uint8_t *buf, size_t len)
+{
+	(void)m;
+	(void)buf;
+	(void)len;
+	mesh_got += 1;
+	printf("%04X: from %04X, %u hops\n", m->id, origin, hops);
+	fflush(stdout);
+}
+
+static int
+bench_mesh(unsigned int messages, enum ir_rate rate)
+{
+	static struct irmesh m;
+	uint32_t next = irsim_now();
+	unsigned int sent = 0;
+
+	irmesh_init(&m, getpid(), ir_baud(rate), getpid());
+	m.output = mesh_output;
+	m.deliver = mesh_deliver;
+	srand(getpid());
+
+	while (sent < messages || !irmesh_idle(&m) || ms_since(m.rx_last) < MESH_QUIET_MS) {
+		int ch;
+
+		if (sent < messages && ms_since(next) < 0x800000U) {
+			uint8_t msg[16] = { 0 };
+
+			irmesh_send(&m, msg, sizeof(msg), irsim_now());
+			sent += 1;
+			next = irsim_now() + 500 + rand() % 2000;
+		}
+		irsim_wait(1);
+		while ((ch = ir_recv()) >= 0)
+			irmesh_input(&m, ch, irsim_now());
+		irmesh_poll(&m, irsim_now());
+	}
+
+	printf("%04X: sent %u, got %lu, forwarded %lu, suppressed %lu, dups %lu\n",
+			m.id, sent, mesh_got,
+			(unsigned long)m.stats.forwarded,
+			(unsigned long)m.stats.suppressed,
+			(unsigned long)m.stats.dups);
+	return EXIT_SUCCESS;
+}
+
+int
+main(int argc, char *argv[])
+{
+	enum ir_rate rate;
+	int ret;
+
+	if (argc < 2)
+		goto usage;
+
+	ir_init();
+	if (strcmp(argv[1], "recv") == 0) {
+		rate = parse_rate(argc > 2 ? argv[2] : NULL);
+		ir_rate(rate);
+		ret = bench_recv(rate);
+	} else if (strcmp(argv[1], "send") == 0) {
+		rate = parse_rate(argc > 3 ? argv[3] : NULL);
+		ir_rate(rate);
+		ret = bench_send(argc > 2 ? strtoul(argv[2], NULL, 0) : 20000, rate);
+	} else if (strcmp(argv[1], "mesh") == 0) {
+		rate = parse_rate(argc > 3 ? argv[3] : NULL);
+		ir_rate(rate);
+		ret = bench_mesh(argc > 2 ? strtoul(argv[2], NULL, 0) : 5, rate);
+	} else {
+		ir_uninit();
+		goto usage;
+	}
+	ir_uninit();
+	return ret;
+usage:
+	fprintf(stderr, "usage: %s recv [baud]\n"
+			"       %s send [bytes] [baud]\n"
+			"       %s mesh [messages] [baud]\n",
+			argv[0], argv[0], argv[0]);
+	return EXIT_FAILURE;
+}
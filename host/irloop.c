@@ -0,0 +1,133 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loop frames from irframe.c through a noisy byte
+ * channel and check what comes out the other end.
+ *
+ *   ./irloop [frames] [noise%] [corrupt%] [seed]
+ *
+ * Noise is the chance of each extra random byte
+ * between frames, corruption is the chance of a
+ * flipped bit inside a frame. Every frame that
+ * arrives must be one that was sent unharmed, and
+ * with no corruption every frame must arrive.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "irframe.h"
+
+struct sent {
+	uint8_t len;
+	uint8_t data[IRFRAME_MAX];
+	int corrupt;
+};
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int frames  = (argc > 1) ? atoi(argv[1]) : 10000;
+	unsigned int noise   = (argc > 2) ? atoi(argv[2]) : 10;
+	unsigned int corrupt = (argc > 3) ? atoi(argv[3]) : 5;
+	unsigned int seed    = (argc > 4) ? atoi(argv[4]) : 1;
+	struct irframe_rx rx;
+	struct sent *sent;
+	unsigned int next = 0;
+	unsigned int good = 0;
+	unsigned int lost = 0;
+	unsigned int bogus = 0;
+	unsigned int i;
+
+	if (noise > 99)
+		noise = 99;
+
+	sent = calloc(frames, sizeof(*sent));
+	if (!sent)
+		return 1;
+
+	srand(seed);
+	irframe_rx_init(&rx);
+
+	for (i = 0; i < frames; i++) {
+		uint8_t wire[IRFRAME_MAX + IRFRAME_OVERHEAD];
+		struct sent *s = &sent[i];
+		size_t len;
+		size_t j;
+		unsigned int k;
+
+		s->len = rand() % (IRFRAME_MAX + 1);
+		for (j = 0; j < s->len; j++)
+			s->data[j] = rand();
+		len = irframe_encode(wire, s->data, s->len);
+
+		if ((unsigned int)(rand() % 100) < corrupt) {
+			wire[1 + rand() % (len - 1)] ^= 1U << (rand() % 8);
+			s->corrupt = 1;
+		}
+
+		while ((unsigned int)(rand() % 100) < noise) {
+			int n = irframe_feed(&rx, rand());
+
+			if (n >= 0)
+				bogus += 1;
+		}
+
+		for (j = 0; j < len; j++) {
+			int n = irframe_feed(&rx, wire[j]);
+
+			if (n < 0)
+				continue;
+
+			/* match it up with what was sent */
+			for (k = next; k <= i; k++) {
+				struct sent *t = &sent[k];
+
+				if (!t->corrupt && t->len == n &&
+						memcmp(t->data, rx.buf, n) == 0)
+					break;
+			}
+			if (k > i) {
+				bogus += 1;
+				continue;
+			}
+			for (; next < k; next++) {
+				if (!sent[next].corrupt)
+					lost += 1;
+			}
+			next = k + 1;
+			good += 1;
+		}
+	}
+	for (; next < frames; next++) {
+		if (!sent[next].corrupt)
+			lost += 1;
+	}
+
+	printf("frames %u, good %u, lost %u, bogus %u, decoder errors %lu\n",
+			frames, good, lost, bogus, (unsigned long)rx.errors);
+	free(sent);
+
+	if (bogus > 0)
+		return 1;
+	if (corrupt == 0 && lost > 0)
+		return 1;
+	return 0;
+}
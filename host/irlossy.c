@@ -0,0 +1,267 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Push a stream through irpkt.c between two simulated
+ * badges on a lossy half duplex link and check that it
+ * arrives complete and in order.
+ *
+ *   ./irlossy [bytes] [baud] [lost/1000] [corrupt/1000] [seed]
+ *
+ * Every byte on the link may be lost or get a bit flipped.
+ * Both ends hear their own transmissions, and bytes sent
+ * while the other end is talking are lost.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "irpkt.h"
+
+#define PENDING_MAX 1024
+#define TIMEOUT_US  (600ULL * 1000000ULL)
+
+struct end {
+	struct irpkt p;
+	unsigned int n;
+	uint64_t tx_free; /* end of current transmission */
+};
+
+struct pending {
+	uint64_t at;
+	unsigned int from;
+	unsigned int to;
+	uint8_t c;
+	bool lost;
+};
+
+static struct end ends[2];
+static struct pending pending[PENDING_MAX];
+static unsigned int npending;
+static uint64_t now_us;
+static uint64_t byte_us;
+static unsigned int lost_pm;
+static unsigned int corrupt_pm;
+
+static unsigned long collisions;
+static unsigned long lost;
+static unsigned long corrupted;
+
+static uint8_t *stream;
+static size_t stream_len;
+static size_t received;
+static bool mismatch;
+
+static uint32_t
+now_ms(void)
+{
+	return (now_us / 1000) & IRPKT_TIME_MASK;
+}
+
+static uint8_t
+stream_byte(size_t i)
+{
+	return (i * 7 + (i >> 8)) ^ 0x5A;
+}
+
+static void
+output(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	struct end *e = p->priv;
+	struct end *o = &ends[!e->n];
+	size_t i;
+
+	if (e->tx_free < now_us)
+		e->tx_free = now_us;
+
+	for (i = 0; i < len; i++) {
+		uint64_t start = e->tx_free;
+		uint64_t end = start + byte_us;
+		struct pending *echo;
+		struct pending *b;
+		unsigned int j;
+
+		if (npending + 2 > PENDING_MAX) {
+			fprintf(stderr, "too many bytes in flight\n");
+			exit(EXIT_FAILURE);
+		}
+
+		/* whatever the other end is sending to us now is lost */
+		for (j = 0; j < npending; j++) {
+			b = &pending[j];
+			if (b->from != e->n && b->to == e->n && !b->lost
+					&& b->at > start && b->at - byte_us < end) {
+				b->lost = true;
+				collisions += 1;
+			}
+		}
+
+		echo = &pending[npending++];
+		echo->at = end;
+		echo->from = e->n;
+		echo->to = e->n;
+		echo->c = buf[i];
+		echo->lost = false;
+
+		b = &pending[npending++];
+		b->at = end;
+		b->from = e->n;
+		b->to = o->n;
+		b->c = buf[i];
+		b->lost = false;
+		if (o->tx_free > start) {
+			b->lost = true;
+			collisions += 1;
+		} else if ((unsigned int)rand() % 1000 < lost_pm) {
+			b->lost = true;
+			lost += 1;
+		} else if ((unsigned int)rand() % 1000 < corrupt_pm) {
+			b->c ^= 1U << (rand() % 8);
+			corrupted += 1;
+		}
+
+		e->tx_free = end;
+	}
+}
+
+static void
+deliver(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	(void)p;
+	for (i = 0; i < len; i++) {
+		if (received >= stream_len || buf[i] != stream[received])
+			mismatch = true;
+		received += 1;
+	}
+}
+
+static void
+link_step(void)
+{
+	unsigned int i;
+	unsigned int j = 0;
+
+	for (i = 0; i < npending; i++) {
+		struct pending *b = &pending[i];
+
+		if (b->at > now_us) {
+			pending[j++] = *b;
+			continue;
+		}
+		if (!b->lost)
+			irpkt_input(&ends[b->to].p, b->c, now_ms());
+	}
+	npending = j;
+}
+
+static void
+print_stats(const char *name, const struct irpkt *p)
+{
+	const struct irpkt_stats *st = &p->stats;
+
+	printf("%s: frames %lu, resent %lu, acked %lu B, "
+			"received %lu frames, %lu dups, %lu echoes, %lu bad, "
+			"acks %lu/%lu\n", name,
+			(unsigned long)st->tx_frames, (unsigned long)st->tx_resends,
+			(unsigned long)st->tx_acked,
+			(unsigned long)st->rx_frames, (unsigned long)st->rx_dups,
+			(unsigned long)st->rx_echoes, (unsigned long)p->rx.errors,
+			(unsigned long)st->acks_sent, (unsigned long)st->acks_rcvd);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t bytes = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+	uint32_t baud = (argc > 2) ? strtoul(argv[2], NULL, 0) : 115200;
+	unsigned int seed = (argc > 5) ? strtoul(argv[5], NULL, 0) : 1;
+	struct irpkt *a = &ends[0].p;
+	struct irpkt *b = &ends[1].p;
+	uint64_t step;
+	size_t sent = 0;
+	unsigned int i;
+	double secs;
+
+	lost_pm = (argc > 3) ? strtoul(argv[3], NULL, 0) : 2;
+	corrupt_pm = (argc > 4) ? strtoul(argv[4], NULL, 0) : 2;
+	if (baud == 0 || lost_pm > 500 || corrupt_pm > 500) {
+		fprintf(stderr, "usage: %s [bytes] [baud] [lost/1000] [corrupt/1000] [seed]\n",
+				argv[0]);
+		return EXIT_FAILURE;
+	}
+	srand(seed);
+
+	stream_len = bytes;
+	stream = malloc(bytes ? bytes : 1);
+	if (stream == NULL)
+		return EXIT_FAILURE;
+	for (i = 0; i < bytes; i++)
+		stream[i] = stream_byte(i);
+
+	byte_us = 10000000ULL / baud;
+	step = byte_us / 2 ? byte_us / 2 : 1;
+
+	for (i = 0; i < 2; i++) {
+		ends[i].n = i;
+		irpkt_init(&ends[i].p, 0x10 + i, baud);
+		ends[i].p.output = output;
+		ends[i].p.deliver = deliver;
+		ends[i].p.priv = &ends[i];
+	}
+
+	while (received < bytes || !irpkt_idle(a)) {
+		if (now_us > TIMEOUT_US) {
+			fprintf(stderr, "timeout after %lu of %lu bytes\n",
+					(unsigned long)received, (unsigned long)bytes);
+			return EXIT_FAILURE;
+		}
+		link_step();
+
+		while (sent < bytes) {
+			size_t len = bytes - sent;
+
+			if (len > IRPKT_MTU)
+				len = IRPKT_MTU;
+			if (!irpkt_send(a, &stream[sent], len))
+				break;
+			sent += len;
+		}
+		irpkt_poll(a, now_ms());
+		irpkt_poll(b, now_ms());
+		now_us += step;
+	}
+
+	secs = now_us / 1e6;
+	printf("%lu bytes at %lu baud in %.2f s: goodput %.0f B/s, link %.0f B/s\n",
+			(unsigned long)bytes, (unsigned long)baud, secs,
+			bytes / secs, baud / 10.0);
+	printf("link: %lu lost, %lu corrupted, %lu collisions\n",
+			lost, corrupted, collisions);
+	print_stats("sender", a);
+	print_stats("receiver", b);
+
+	if (mismatch || received != bytes) {
+		fprintf(stderr, "stream corrupted\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
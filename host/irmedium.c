@@ -0,0 +1,352 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The air between simulated badges.
+ *
+ *   ./irmedium [-s socket] [-b bit errors/million] [-e] [-c] [-x]
+ *
+ * Badges built with irsim.c connect to the socket and
+ * everything one of them sends reaches the others one
+ * byte time later at the baud rate it was sent with.
+ * Badges listening at another rate get nothing. Bytes
+ * that overlap at a receiver are lost, and so is
+ * everything sent to a badge while it is sending.
+ *
+ *   -b  flip this many bits per million, a flipped
+ *       start or stop bit loses the byte
+ *   -e  badges hear their own transmissions, like
+ *       the real transceivers do
+ *   -c  no collisions, everybody hears everything
+ *   -x  exit when the last badge disconnects
+ *
+ * Per badge statistics are printed when a badge
+ * disconnects.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ir.h"
+#include "irsim.h"
+
+#define BADGES_MAX 32
+#define INFLIGHT   256
+
+struct rxbyte {
+	uint64_t at;
+	unsigned int from;
+	uint8_t c;
+	bool lost;
+};
+
+struct badge {
+	int fd;
+	unsigned int n;
+	uint32_t baud;
+	uint64_t tx_free;
+	unsigned int ninflight;
+	struct rxbyte inflight[INFLIGHT];
+	unsigned long sent;
+	unsigned long received;
+	unsigned long collided;
+	unsigned long errors;
+	unsigned long mismatched;
+};
+
+static const uint32_t bauds[IR_RATES] = {
+	[IR_1200]   =   1200,
+	[IR_9600]   =   9600,
+	[IR_19200]  =  19200,
+	[IR_38400]  =  38400,
+	[IR_57600]  =  57600,
+	[IR_115200] = 115200,
+};
+
+static struct badge badges[BADGES_MAX];
+static unsigned int ber;
+static bool echo;
+static bool collisions = true;
+static volatile sig_atomic_t quit;
+
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000U;
+}
+
+static bool
+flip(void)
+{
+	return ber && (unsigned int)rand() % 1000000U < ber;
+}
+
+/* start bit, 8 data bits, stop bit */
+static bool
+bit_errors(uint8_t *c)
+{
+	unsigned int i;
+
+	if (flip())
+		return true;
+	for (i = 0; i < 8; i++) {
+		if (flip())
+			*c ^= 1U << i;
+	}
+	return flip();
+}
+
+static void
+transmit(struct badge *e, uint8_t c)
+{
+	uint64_t now = now_us();
+	uint64_t byte = 10000000U / e->baud;
+	uint64_t start = (e->tx_free > now) ? e->tx_free : now;
+	uint64_t end = start + byte;
+	unsigned int i;
+
+	e->sent += 1;
+	e->tx_free = end;
+
+	/* half duplex, whatever is coming our way is lost */
+	for (i = 0; collisions && i < e->ninflight; i++) {
+		struct rxbyte *b = &e->inflight[i];
+
+		if (b->from != e->n && !b->lost && b->at > start) {
+			b->lost = true;
+			e->collided += 1;
+		}
+	}
+
+	for (i = 0; i < BADGES_MAX; i++) {
+		struct badge *o = &badges[i];
+		struct rxbyte *b;
+		unsigned int j;
+
+		if (o->fd < 0 || (o == e && !echo))
+			continue;
+		if (o->ninflight == INFLIGHT) {
+			o->collided += 1;
+			continue;
+		}
+		if (o->baud != e->baud) {
+			o->mismatched += 1;
+			continue;
+		}
+
+		b = &o->inflight[o->ninflight++];
+		b->at = end;
+		b->from = e->n;
+		b->c = c;
+		b->lost = false;
+		if (bit_errors(&b->c)) {
+			b->lost = true;
+			o->errors += 1;
+		}
+		if (o == e || !collisions)
+			continue;
+
+		if (o->tx_free > start) {
+			if (!b->lost)
+				o->collided += 1;
+			b->lost = true;
+		}
+		for (j = 0; j + 1 < o->ninflight; j++) {
+			struct rxbyte *d = &o->inflight[j];
+
+			if (d->from != e->n && d->at > start && d->at - byte < end) {
+				if (!d->lost)
+					o->collided += 1;
+				if (!b->lost)
+					o->collided += 1;
+				d->lost = true;
+				b->lost = true;
+			}
+		}
+	}
+}
+
+/* returns ms until the next byte is due, or -1 */
+static int
+deliver(void)
+{
+	uint64_t now = now_us();
+	uint64_t next = UINT64_MAX;
+	unsigned int i;
+
+	for (i = 0; i < BADGES_MAX; i++) {
+		struct badge *e = &badges[i];
+		unsigned int j;
+		unsigned int k = 0;
+
+		for (j = 0; j < e->ninflight; j++) {
+			struct rxbyte *b = &e->inflight[j];
+
+			if (b->at > now) {
+				if (b->at < next)
+					next = b->at;
+				e->inflight[k++] = *b;
+				continue;
+			}
+			if (b->lost || e->fd < 0)
+				continue;
+			if (send(e->fd, &b->c, 1, MSG_DONTWAIT) == 1)
+				e->received += 1;
+		}
+		e->ninflight = k;
+	}
+	if (next == UINT64_MAX)
+		return -1;
+	return (next - now + 999) / 1000;
+}
+
+static void
+print_stats(const struct badge *e)
+{
+	printf("badge %u: sent %lu, received %lu, collided %lu, "
+			"bit errors %lu, wrong rate %lu\n", e->n,
+			e->sent, e->received, e->collided,
+			e->errors, e->mismatched);
+	fflush(stdout);
+}
+
+static void
+on_signal(int sig)
+{
+	(void)sig;
+	quit = 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *path = IRSIM_PATH;
+	struct sockaddr_un sa = { .sun_family = AF_UNIX, };
+	bool exit_last = false;
+	unsigned int connected = 0;
+	int lfd;
+	int opt;
+	unsigned int i;
+
+	while ((opt = getopt(argc, argv, "s:b:ecx")) != -1) {
+		switch (opt) {
+		case 's': path = optarg; break;
+		case 'b': ber = strtoul(optarg, NULL, 0); break;
+		case 'e': echo = true; break;
+		case 'c': collisions = false; break;
+		case 'x': exit_last = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-s socket] [-b bit errors/million] [-e] [-c] [-x]\n",
+					argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	srand(time(NULL));
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+	unlink(path);
+	lfd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) || listen(lfd, 8)) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < BADGES_MAX; i++)
+		badges[i].fd = -1;
+
+	while (!quit) {
+		struct pollfd pfd[BADGES_MAX + 1];
+		unsigned int idx[BADGES_MAX + 1];
+		unsigned int n = 0;
+		int timeout = deliver();
+
+		pfd[n].fd = lfd;
+		pfd[n].events = POLLIN;
+		n++;
+		for (i = 0; i < BADGES_MAX; i++) {
+			if (badges[i].fd < 0)
+				continue;
+			pfd[n].fd = badges[i].fd;
+			pfd[n].events = POLLIN;
+			idx[n++] = i;
+		}
+		if (poll(pfd, n, timeout) < 0)
+			continue;
+
+		if (pfd[0].revents & POLLIN) {
+			int fd = accept(lfd, NULL, NULL);
+
+			for (i = 0; fd >= 0 && i < BADGES_MAX; i++) {
+				struct badge *e = &badges[i];
+
+				if (e->fd >= 0)
+					continue;
+				memset(e, 0, sizeof(*e));
+				e->fd = fd;
+				e->n = i;
+				e->baud = bauds[IR_1200];
+				connected += 1;
+				break;
+			}
+			if (fd >= 0 && i == BADGES_MAX)
+				close(fd);
+		}
+
+		for (i = 1; i < n; i++) {
+			struct badge *e = &badges[idx[i]];
+			uint8_t msg[2];
+
+			if (!(pfd[i].revents & (POLLIN | POLLHUP)))
+				continue;
+			if (recv(e->fd, msg, sizeof(msg), 0) != sizeof(msg)) {
+				close(e->fd);
+				e->fd = -1;
+				print_stats(e);
+				connected -= 1;
+				if (exit_last && connected == 0)
+					quit = 1;
+				continue;
+			}
+			if (msg[0] == IRSIM_DATA)
+				transmit(e, msg[1]);
+			else if (msg[0] == IRSIM_RATE && msg[1] < IR_RATES)
+				e->baud = bauds[msg[1]];
+		}
+	}
+
+	for (i = 0; i < BADGES_MAX; i++) {
+		if (badges[i].fd >= 0)
+			print_stats(&badges[i]);
+	}
+	unlink(path);
+	return EXIT_SUCCESS;
+}
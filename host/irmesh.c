@@ -0,0 +1,384 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Run irmesh.c on a field of simulated badges and see
+ * how fast messages spread and how much air they take.
+ *
+ *   ./irmesh [badges] [messages] [baud] [lost/1000] [range%] [seed]
+ *
+ * Badges are scattered over a square and hear everyone
+ * closer than range% of its side. Every byte may be
+ * lost, a badge only hears one sender at a time and
+ * nothing at all while it is sending itself. Bytes
+ * that collide are lost, so there are hidden terminals.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "irmesh.h"
+
+#define BADGES_MAX  64
+#define INFLIGHT    512
+#define TIMEOUT_US  (3600ULL * 1000000ULL)
+
+struct rxbyte {
+	uint64_t at;
+	unsigned int from;
+	uint8_t c;
+	bool lost;
+};
+
+struct badge {
+	struct irmesh m;
+	unsigned int n;
+	double x;
+	double y;
+	uint64_t tx_free; /* end of current transmission */
+	unsigned int ninflight;
+	struct rxbyte inflight[INFLIGHT];
+};
+
+struct message {
+	uint64_t start;
+	unsigned int origin;
+	unsigned int reached;
+	unsigned int reachable;
+	uint64_t last;
+	uint64_t got[BADGES_MAX];
+};
+
+static struct badge badges[BADGES_MAX];
+static bool near[BADGES_MAX][BADGES_MAX];
+static unsigned int nbadges;
+static struct message *messages;
+static unsigned int nmessages;
+
+static uint64_t now_us;
+static uint64_t byte_us;
+static unsigned int lost_pm;
+
+static unsigned long lost;
+static unsigned long collisions;
+
+static uint32_t
+now_ms(void)
+{
+	return (now_us / 1000) & IRMESH_TIME_MASK;
+}
+
+static void
+output(struct irmesh *m, const uint8_t *buf, size_t len)
+{
+	struct badge *e = m->priv;
+	unsigned int i;
+	size_t k;
+
+	if (e->tx_free < now_us)
+		e->tx_free = now_us;
+
+	for (k = 0; k < len; k++) {
+		uint64_t start = e->tx_free;
+		uint64_t end = start + byte_us;
+
+		/* whatever is on its way to us is lost */
+		for (i = 0; i < e->ninflight; i++) {
+			struct rxbyte *b = &e->inflight[i];
+
+			if (b->from != e->n && !b->lost && b->at > start) {
+				b->lost = true;
+				collisions += 1;
+			}
+		}
+
+		for (i = 0; i < nbadges; i++) {
+			struct badge *o = &badges[i];
+			struct rxbyte *b;
+			unsigned int j;
+
+			if (!near[e->n][i])
+				continue;
+			if (o->ninflight == INFLIGHT) {
+				fprintf(stderr, "too many bytes in flight\n");
+				exit(EXIT_FAILURE);
+			}
+			b = &o->inflight[o->ninflight++];
+			b->at = end;
+			b->from = e->n;
+			b->c = buf[k];
+			b->lost = false;
+			if (o == e)
+				continue;
+
+			for (j = 0; j + 1 < o->ninflight; j++) {
+				struct rxbyte *c = &o->inflight[j];
+
+				if (c->from != e->n && c->at > start && c->at - byte_us < end) {
+					if (!c->lost)
+						collisions += 1;
+					c->lost = true;
+					b->lost = true;
+				}
+			}
+			if (b->lost)
+				continue;
+			if (o->tx_free > start) {
+				b->lost = true;
+				collisions += 1;
+			} else if ((unsigned int)rand() % 1000 < lost_pm) {
+				b->lost = true;
+				lost += 1;
+			}
+		}
+		e->tx_free = end;
+	}
+}
+
+static void
+deliver(struct irmesh *m, uint16_t origin, uint8_t hops,
+		const uint8_t *buf, size_t len)
+{
+	struct badge *e = m->priv;
+	struct message *msg;
+	unsigned int idx;
+
+	(void)origin;
+	(void)hops;
+	if (len < 2)
+		return;
+	idx = buf[0] | buf[1] << 8;
+	if (idx >= nmessages)
+		return;
+	msg = &messages[idx];
+	if (msg->got[e->n])
+		return;
+	msg->got[e->n] = now_us - msg->start + 1;
+	msg->reached += 1;
+	msg->last = now_us - msg->start;
+}
+
+static void
+link_step(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nbadges; i++) {
+		struct badge *e = &badges[i];
+		unsigned int j;
+		unsigned int k = 0;
+
+		for (j = 0; j < e->ninflight; j++) {
+			struct rxbyte *b = &e->inflight[j];
+
+			if (b->at > now_us) {
+				e->inflight[k++] = *b;
+				continue;
+			}
+			if (!b->lost)
+				irmesh_input(&e->m, b->c, now_ms());
+		}
+		e->ninflight = k;
+	}
+}
+
+static bool
+link_idle(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nbadges; i++) {
+		if (badges[i].ninflight > 0 || !irmesh_idle(&badges[i].m))
+			return false;
+	}
+	return true;
+}
+
+/* how many badges can hear from n at all */
+static unsigned int
+reachable(unsigned int n)
+{
+	bool seen[BADGES_MAX] = { false };
+	unsigned int queue[BADGES_MAX];
+	unsigned int head = 0;
+	unsigned int tail = 0;
+
+	seen[n] = true;
+	queue[tail++] = n;
+	while (head < tail) {
+		unsigned int a = queue[head++];
+		unsigned int b;
+
+		for (b = 0; b < nbadges; b++) {
+			if (near[a][b] && !seen[b]) {
+				seen[b] = true;
+				queue[tail++] = b;
+			}
+		}
+	}
+	return tail;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int range;
+	unsigned int seed;
+	uint32_t baud;
+	uint64_t interval;
+	uint64_t next_msg = 0;
+	unsigned long total_reached = 0;
+	unsigned long total_reachable = 0;
+	unsigned long complete = 0;
+	double latency_sum = 0;
+	double last_sum = 0;
+	uint64_t last_max = 0;
+	struct irmesh_stats sum;
+	unsigned int sent = 0;
+	unsigned int i;
+	unsigned int j;
+	double airtime;
+
+	nbadges = (argc > 1) ? strtoul(argv[1], NULL, 0) : 30;
+	nmessages = (argc > 2) ? strtoul(argv[2], NULL, 0) : 50;
+	baud = (argc > 3) ? strtoul(argv[3], NULL, 0) : 9600;
+	lost_pm = (argc > 4) ? strtoul(argv[4], NULL, 0) : 2;
+	range = (argc > 5) ? strtoul(argv[5], NULL, 0) : 30;
+	seed = (argc > 6) ? strtoul(argv[6], NULL, 0) : 1;
+	if (nbadges < 2 || nbadges > BADGES_MAX || nmessages == 0
+			|| nmessages > 0xFFFF || baud == 0 || lost_pm > 500) {
+		fprintf(stderr, "usage: %s [badges] [messages] [baud] [lost/1000] [range%%] [seed]\n",
+				argv[0]);
+		return EXIT_FAILURE;
+	}
+	srand(seed);
+
+	messages = calloc(nmessages, sizeof(*messages));
+	if (messages == NULL)
+		return EXIT_FAILURE;
+
+	byte_us = 10000000ULL / baud;
+	/* a new message every 20 frame times */
+	interval = 20 * (IRFRAME_MAX + IRFRAME_OVERHEAD) * byte_us;
+
+	for (i = 0; i < nbadges; i++) {
+		struct badge *e = &badges[i];
+
+		e->n = i;
+		e->x = rand() % 1000;
+		e->y = rand() % 1000;
+		irmesh_init(&e->m, i + 1, baud, rand());
+		e->m.output = output;
+		e->m.deliver = deliver;
+		e->m.priv = e;
+	}
+	for (i = 0; i < nbadges; i++) {
+		for (j = 0; j < nbadges; j++) {
+			double dx = badges[i].x - badges[j].x;
+			double dy = badges[i].y - badges[j].y;
+
+			near[i][j] = dx * dx + dy * dy <= range * range * 100.0;
+		}
+	}
+
+	while (sent < nmessages || !link_idle()) {
+		if (now_us > TIMEOUT_US) {
+			fprintf(stderr, "timeout\n");
+			return EXIT_FAILURE;
+		}
+		link_step();
+
+		if (sent < nmessages && now_us >= next_msg) {
+			struct message *msg = &messages[sent];
+			uint8_t payload[16];
+
+			msg->origin = rand() % nbadges;
+			msg->start = now_us;
+			msg->reachable = reachable(msg->origin) - 1;
+			memset(payload, 0, sizeof(payload));
+			payload[0] = sent;
+			payload[1] = sent >> 8;
+			if (irmesh_send(&badges[msg->origin].m, payload,
+						sizeof(payload), now_ms()))
+				msg->got[msg->origin] = 1;
+			sent += 1;
+			next_msg = now_us + interval / 2 + rand() % interval;
+		}
+
+		for (i = 0; i < nbadges; i++) {
+			struct badge *e = &badges[i];
+
+			/* don't queue up more than one frame in the transmitter */
+			if (e->tx_free <= now_us)
+				irmesh_poll(&e->m, now_ms());
+		}
+		now_us += byte_us / 2 ? byte_us / 2 : 1;
+	}
+
+	memset(&sum, 0, sizeof(sum));
+	for (i = 0; i < nbadges; i++) {
+		const struct irmesh_stats *st = &badges[i].m.stats;
+
+		sum.sent += st->sent;
+		sum.delivered += st->delivered;
+		sum.dups += st->dups;
+		sum.forwarded += st->forwarded;
+		sum.suppressed += st->suppressed;
+		sum.dropped += st->dropped;
+		sum.tx_bytes += st->tx_bytes;
+	}
+
+	for (i = 0; i < nmessages; i++) {
+		struct message *msg = &messages[i];
+
+		total_reached += msg->reached;
+		total_reachable += msg->reachable;
+		for (j = 0; j < nbadges; j++) {
+			if (j != msg->origin && msg->got[j])
+				latency_sum += msg->got[j] - 1;
+		}
+		if (msg->reached >= msg->reachable) {
+			complete += 1;
+			last_sum += msg->last;
+			if (msg->last > last_max)
+				last_max = msg->last;
+		}
+	}
+
+	airtime = sum.tx_bytes * (double)byte_us / 1000.0;
+	printf("%u badges, %u messages at %lu baud, %u%% range, %u lost/1000\n",
+			nbadges, nmessages, (unsigned long)baud, range, lost_pm);
+	printf("coverage: %lu of %lu reachable (%.1f%%), %lu messages reached everyone\n",
+			total_reached, total_reachable,
+			total_reachable ? 100.0 * total_reached / total_reachable : 100.0,
+			complete);
+	printf("latency: %.0f ms average per badge, %.0f ms average to reach everyone, %.0f ms max\n",
+			total_reached ? latency_sum / total_reached / 1000.0 : 0.0,
+			complete ? last_sum / complete / 1000.0 : 0.0,
+			last_max / 1000.0);
+	printf("airtime: %.0f ms per message, %.2f sends per badge reached\n",
+			airtime / nmessages,
+			total_reached ? (double)(sum.sent + sum.forwarded) / total_reached : 0.0);
+	printf("badges: %lu forwarded, %lu suppressed, %lu dups, %lu dropped\n",
+			(unsigned long)sum.forwarded, (unsigned long)sum.suppressed,
+			(unsigned long)sum.dups, (unsigned long)sum.dropped);
+	printf("link: %lu lost, %lu collisions\n", lost, collisions);
+	return EXIT_SUCCESS;
+}
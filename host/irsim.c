@@ -0,0 +1,196 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ir.h on top of irmedium, so code written against
+ * ir.c runs unchanged in a host process. Set IRSIM
+ * to use another socket than IRSIM_PATH.
+ *
+ * Like the real usart ir_send() only holds 2 bytes
+ * and then waits for the line, so programs run at
+ * the pace of the chosen baud rate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ir.h"
+#include "irsim.h"
+
+#define IR_FIFO 2
+
+static const uint32_t ir_bauds[IR_RATES] = {
+	[IR_1200]   =   1200,
+	[IR_9600]   =   9600,
+	[IR_19200]  =  19200,
+	[IR_38400]  =  38400,
+	[IR_57600]  =  57600,
+	[IR_115200] = 115200,
+};
+
+static int ir_fd = -1;
+static enum ir_rate ir_cur = IR_1200;
+static uint64_t ir_tx_free;
+static struct ir_stats ir_st;
+
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000U;
+}
+
+static void
+sleep_until(uint64_t us)
+{
+	uint64_t now = now_us();
+	struct timespec ts;
+
+	if (us <= now)
+		return;
+	us -= now;
+	ts.tv_sec = us / 1000000U;
+	ts.tv_nsec = (us % 1000000U) * 1000U;
+	nanosleep(&ts, NULL);
+}
+
+static uint64_t
+byte_us(void)
+{
+	return 10000000U / ir_bauds[ir_cur];
+}
+
+static void
+ir_msg(uint8_t op, uint8_t val)
+{
+	uint8_t msg[2] = { op, val };
+
+	if (send(ir_fd, msg, sizeof(msg), 0) != sizeof(msg)) {
+		perror("irsim");
+		exit(EXIT_FAILURE);
+	}
+}
+
+uint32_t
+irsim_now(void)
+{
+	return (now_us() / 1000U) & 0xFFFFFFU;
+}
+
+void
+irsim_wait(uint32_t ms)
+{
+	struct pollfd pfd = { .fd = ir_fd, .events = POLLIN, };
+
+	poll(&pfd, 1, ms);
+}
+
+void
+ir_init(void)
+{
+	const char *path = getenv("IRSIM");
+	struct sockaddr_un sa = { .sun_family = AF_UNIX, };
+
+	if (path == NULL)
+		path = IRSIM_PATH;
+	snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+
+	ir_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (ir_fd < 0 || connect(ir_fd, (struct sockaddr *)&sa, sizeof(sa))) {
+		fprintf(stderr, "irsim: can't connect to %s, is irmedium running?\n", path);
+		exit(EXIT_FAILURE);
+	}
+	ir_cur = IR_1200;
+	ir_tx_free = 0;
+	ir_msg(IRSIM_RATE, ir_cur);
+}
+
+void
+ir_uninit(void)
+{
+	ir_tx_wait();
+	close(ir_fd);
+	ir_fd = -1;
+}
+
+uint32_t
+ir_baud(enum ir_rate rate)
+{
+	return ir_bauds[rate];
+}
+
+void
+ir_rate(enum ir_rate rate)
+{
+	ir_tx_wait();
+	ir_cur = rate;
+	ir_msg(IRSIM_RATE, rate);
+	ir_rx_clear();
+}
+
+void
+ir_send(uint8_t c)
+{
+	uint64_t now = now_us();
+
+	if (ir_tx_free < now)
+		ir_tx_free = now;
+	/* wait for room in the fifo */
+	sleep_until(ir_tx_free - (IR_FIFO - 1) * byte_us());
+	ir_msg(IRSIM_DATA, c);
+	ir_tx_free += byte_us();
+}
+
+void
+ir_tx_wait(void)
+{
+	sleep_until(ir_tx_free);
+}
+
+int
+ir_recv(void)
+{
+	uint8_t c;
+
+	if (recv(ir_fd, &c, 1, MSG_DONTWAIT) != 1)
+		return -1;
+	ir_st.rx_bytes += 1;
+	return c;
+}
+
+void
+ir_rx_clear(void)
+{
+	while (ir_recv() >= 0)
+		/* drop it */;
+}
+
+void
+ir_stats(struct ir_stats *st)
+{
+	*st = ir_st;
+}
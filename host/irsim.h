@@ -0,0 +1,43 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IRSIM_H
+#define _IRSIM_H
+
+#include <stdint.h>
+
+/*
+ * Host side ir.c talking to irmedium over a unix socket
+ * instead of to the usart. Every badge process opens
+ * its own connection in ir_init(), and irmedium decides
+ * who hears what and when.
+ *
+ * Messages are 2 bytes from the badge, IRSIM_DATA or
+ * IRSIM_RATE followed by the byte or the new ir_rate,
+ * and single received bytes the other way.
+ */
+#define IRSIM_PATH "/tmp/irsim.sock"
+#define IRSIM_DATA 'd'
+#define IRSIM_RATE 'r'
+
+/* like timer_now() on the badge */
+uint32_t irsim_now(void);
+/* sleep until something arrives or ms have passed */
+void irsim_wait(uint32_t ms);
+
+#endif
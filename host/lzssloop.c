@@ -0,0 +1,208 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Round trip blocks through lzss.c and check that
+ * every one decodes to what went in, and that the
+ * compressed size stays within LZSS_BOUND().
+ *
+ *   ./lzssloop [rounds] [seed]
+ *
+ * Besides random blocks of random length, made more
+ * or less compressible, it always tries the empty
+ * block, all zeros, incompressible noise and blocks
+ * of exactly LZSS_BLOCK bytes.
+ *
+ * Whole files go through the ifs.c stream irfile sends
+ * too, from the empty file up to several blocks, and
+ * have to open, write everything and close in order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lzss.h"
+#include "ifs.h"
+
+#define GUARD  16
+#define CANARY 0xA5
+
+static unsigned int failed;
+
+static void
+check(const char *what, const uint8_t *in, size_t len)
+{
+	uint8_t packed[LZSS_BOUND(LZSS_BLOCK) + GUARD];
+	uint8_t out[LZSS_BLOCK];
+	struct lzss_dec d;
+	size_t plen;
+	size_t i;
+
+	memset(packed, CANARY, sizeof(packed));
+	plen = lzss_compress(packed, in, len);
+	for (i = LZSS_BOUND(len); i < sizeof(packed); i++) {
+		if (packed[i] != CANARY)
+			break;
+	}
+	if (plen > LZSS_BOUND(len) || i < sizeof(packed)) {
+		printf("%s: %zu bytes packed to %zu, bound is %zu\n",
+				what, len, plen, (size_t)LZSS_BOUND(len));
+		failed += 1;
+		return;
+	}
+
+	lzss_dec_init(&d, out, sizeof(out));
+	for (i = 0; i < plen; i++) {
+		if (lzss_dec_feed(&d, packed[i]) < 0) {
+			printf("%s: decoder error at byte %zu of %zu\n",
+					what, i, plen);
+			failed += 1;
+			return;
+		}
+	}
+	if (d.pos != len || memcmp(out, in, len) != 0) {
+		printf("%s: %zu bytes came back as %u different ones\n",
+				what, len, d.pos);
+		failed += 1;
+	}
+}
+
+/* feed the stream a byte at a time, like irfile with an ack after every step */
+static void
+check_file(const char *what, const uint8_t *in, size_t len)
+{
+	static struct ifs_rx r;
+	uint8_t out[IFS_BLOCK];
+	enum ifs_step expect = IFS_OPEN;
+	size_t pos = 0;
+	size_t got = 0;
+	bool done = false;
+
+	ifs_rx_init(&r);
+	while (!done) {
+		size_t olen, i;
+
+		if (expect == IFS_OPEN)
+			olen = ifs_header(out, len, "FILE.BIN");
+		else {
+			size_t n = len - pos < LZSS_BLOCK ? len - pos : LZSS_BLOCK;
+
+			olen = ifs_block(out, in + pos, n);
+			pos += n;
+			expect = n ? IFS_WRITE : IFS_CLOSE;
+		}
+
+		for (i = 0; i < olen; i++) {
+			enum ifs_step step = ifs_rx_step(&r);
+
+			if (step != IFS_MORE) {
+				printf("%s: step %u with %zu bytes left\n",
+						what, step, olen - i);
+				failed += 1;
+				return;
+			}
+			ifs_rx_feed(&r, &out[i], 1);
+		}
+		if (ifs_rx_step(&r) != expect) {
+			printf("%s: step %u, expected %u\n",
+					what, ifs_rx_step(&r), expect);
+			failed += 1;
+			return;
+		}
+		switch (expect) {
+		case IFS_OPEN:
+			if (r.size != len) {
+				printf("%s: size %lu, expected %zu\n",
+						what, (unsigned long)r.size, len);
+				failed += 1;
+				return;
+			}
+			expect = IFS_WRITE;
+			break;
+		case IFS_WRITE:
+			if (got + r.raw > len || memcmp(r.block, in + got, r.raw) != 0) {
+				printf("%s: block at %zu came back wrong\n", what, got);
+				failed += 1;
+				return;
+			}
+			got += r.raw;
+			break;
+		default:
+			done = true;
+			break;
+		}
+		ifs_rx_done(&r);
+	}
+	if (got != len) {
+		printf("%s: closed after %zu of %zu bytes\n", what, got, len);
+		failed += 1;
+	}
+}
+
+/* bytes from an alphabet of the given size, smaller packs better */
+static void
+fill(uint8_t *buf, size_t len, unsigned int alphabet)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand() % alphabet;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+	unsigned int seed   = (argc > 2) ? atoi(argv[2]) : 1;
+	static uint8_t file[3 * LZSS_BLOCK + 100];
+	uint8_t buf[LZSS_BLOCK];
+	unsigned int i;
+
+	srand(seed);
+
+	check("empty", buf, 0);
+	memset(buf, 0, sizeof(buf));
+	check("zeros", buf, sizeof(buf));
+	check("one zero", buf, 1);
+	fill(buf, sizeof(buf), 256);
+	check("noise", buf, sizeof(buf));
+	fill(buf, sizeof(buf), 4);
+	check("full block", buf, sizeof(buf));
+	/* a long match reaching back to the start of the block */
+	memcpy(buf + sizeof(buf) - LZSS_MAXLEN, buf, LZSS_MAXLEN);
+	check("far match", buf, sizeof(buf));
+
+	for (i = 0; i < rounds; i++) {
+		size_t len = rand() % (LZSS_BLOCK + 1);
+
+		fill(buf, len, 1 + rand() % 256);
+		check("random", buf, len);
+	}
+
+	check_file("empty file", file, 0);
+	fill(file, sizeof(file), 16);
+	check_file("one byte file", file, 1);
+	check_file("one block file", file, LZSS_BLOCK);
+	check_file("file", file, sizeof(file));
+	fill(file, sizeof(file), 256);
+	check_file("noise file", file, sizeof(file));
+
+	printf("%u rounds, %u failed\n", rounds, failed);
+	return failed > 0;
+}
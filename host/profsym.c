@@ -0,0 +1,285 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Turn the PROFILE.TXT written by the Profiler app into a
+ * flat profile, using the symbol table of the firmware ELF
+ * the samples were taken with.
+ *
+ *   ./profsym [-l] out/code.elf PROFILE.TXT
+ *
+ * -l also lists every sampled PC as function+offset, which
+ * tells a polling loop from the work around it.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+struct sym {
+	uint32_t addr;
+	uint32_t size;
+	const char *name;
+	unsigned long samples;
+};
+
+struct sample {
+	uint32_t pc;
+	unsigned long count;
+	struct sym *sym;
+};
+
+static struct sym *syms;
+static unsigned int nsyms;
+static struct sample *samples;
+static unsigned int nsamples;
+static unsigned long total;
+
+static uint8_t *
+slurp(const char *path, size_t *len)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf;
+	long size;
+
+	if (f == NULL) {
+		perror(path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	buf = malloc(size + 1);
+	if (buf == NULL || fread(buf, 1, size, f) != (size_t)size) {
+		fprintf(stderr, "%s: read failed\n", path);
+		fclose(f);
+		free(buf);
+		return NULL;
+	}
+	fclose(f);
+	buf[size] = '\0';
+	*len = size;
+	return buf;
+}
+
+static int
+sym_cmp(const void *a, const void *b)
+{
+	const struct sym *x = a;
+	const struct sym *y = b;
+
+	return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+/* all functions in the symbol table, sorted by address */
+static int
+load_elf(const char *path)
+{
+	const Elf32_Ehdr *eh;
+	const Elf32_Shdr *sh;
+	uint8_t *elf;
+	size_t len;
+	unsigned int i;
+
+	elf = slurp(path, &len);
+	if (elf == NULL)
+		return -1;
+
+	eh = (const Elf32_Ehdr *)elf;
+	if (len < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0
+			|| eh->e_ident[EI_CLASS] != ELFCLASS32
+			|| eh->e_ident[EI_DATA] != ELFDATA2LSB
+			|| eh->e_shoff + (size_t)eh->e_shnum * sizeof(*sh) > len) {
+		fprintf(stderr, "%s: not a 32bit little endian ELF\n", path);
+		return -1;
+	}
+	sh = (const Elf32_Shdr *)(elf + eh->e_shoff);
+
+	for (i = 0; i < eh->e_shnum; i++) {
+		const Elf32_Sym *st;
+		const char *strtab;
+		unsigned int j, n;
+
+		if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
+			continue;
+		st = (const Elf32_Sym *)(elf + sh[i].sh_offset);
+		strtab = (const char *)elf + sh[sh[i].sh_link].sh_offset;
+		n = sh[i].sh_size / sizeof(*st);
+
+		syms = realloc(syms, (nsyms + n) * sizeof(*syms));
+		if (syms == NULL)
+			return -1;
+		for (j = 0; j < n; j++) {
+			if (ELF32_ST_TYPE(st[j].st_info) != STT_FUNC
+					|| st[j].st_shndx == SHN_UNDEF)
+				continue;
+			/* drop the thumb bit */
+			syms[nsyms].addr = st[j].st_value & ~1U;
+			syms[nsyms].size = st[j].st_size;
+			syms[nsyms].name = strtab + st[j].st_name;
+			syms[nsyms].samples = 0;
+			nsyms += 1;
+		}
+	}
+	if (nsyms == 0) {
+		fprintf(stderr, "%s: no function symbols\n", path);
+		return -1;
+	}
+	qsort(syms, nsyms, sizeof(*syms), sym_cmp);
+	return 0;
+}
+
+static struct sym *
+lookup(uint32_t pc)
+{
+	unsigned int lo = 0;
+	unsigned int hi = nsyms;
+	struct sym *s;
+
+	/* last symbol starting at or below pc */
+	while (hi - lo > 1) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (syms[mid].addr <= pc)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	s = &syms[lo];
+	if (s->addr > pc || (s->size && pc >= s->addr + s->size))
+		return NULL;
+	return s;
+}
+
+static int
+load_profile(const char *path)
+{
+	size_t len;
+	char *buf = (char *)slurp(path, &len);
+	char *line;
+
+	if (buf == NULL)
+		return -1;
+
+	for (line = strtok(buf, "\r\n"); line; line = strtok(NULL, "\r\n")) {
+		unsigned long pc, count;
+
+		if (line[0] == '#') {
+			printf("%s\n", line);
+			continue;
+		}
+		if (sscanf(line, "%lx %lu", &pc, &count) != 2) {
+			fprintf(stderr, "%s: bad line '%s'\n", path, line);
+			return -1;
+		}
+		samples = realloc(samples, (nsamples + 1) * sizeof(*samples));
+		if (samples == NULL)
+			return -1;
+		samples[nsamples].pc = pc;
+		samples[nsamples].count = count;
+		samples[nsamples].sym = lookup(pc);
+		if (samples[nsamples].sym)
+			samples[nsamples].sym->samples += count;
+		total += count;
+		nsamples += 1;
+	}
+	free(buf);
+	return 0;
+}
+
+static int
+sym_hotter(const void *a, const void *b)
+{
+	const struct sym *x = a;
+	const struct sym *y = b;
+
+	return (x->samples < y->samples) - (x->samples > y->samples);
+}
+
+static int
+sample_hotter(const void *a, const void *b)
+{
+	const struct sample *x = a;
+	const struct sample *y = b;
+
+	return (x->count < y->count) - (x->count > y->count);
+}
+
+static void __attribute__((noreturn))
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-l] firmware.elf PROFILE.TXT\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool list = false;
+	unsigned long unknown;
+	unsigned int i;
+	int arg = 1;
+
+	if (arg < argc && strcmp(argv[arg], "-l") == 0) {
+		list = true;
+		arg += 1;
+	}
+	if (argc - arg != 2)
+		usage(argv[0]);
+
+	if (load_elf(argv[arg]) || load_profile(argv[arg + 1]))
+		return EXIT_FAILURE;
+	if (total == 0) {
+		printf("no samples\n");
+		return EXIT_SUCCESS;
+	}
+
+	/* resolve names before the functions get sorted away */
+	if (list) {
+		qsort(samples, nsamples, sizeof(*samples), sample_hotter);
+		printf("\n     %%  samples  pc\n");
+		for (i = 0; i < nsamples; i++) {
+			const struct sample *s = &samples[i];
+
+			if (s->sym)
+				printf("%6.1f %8lu  %08lx %s+0x%lx\n",
+						100.0 * s->count / total, s->count,
+						(unsigned long)s->pc, s->sym->name,
+						(unsigned long)(s->pc - s->sym->addr));
+			else
+				printf("%6.1f %8lu  %08lx ?\n",
+						100.0 * s->count / total, s->count,
+						(unsigned long)s->pc);
+		}
+	}
+
+	unknown = total;
+	qsort(syms, nsyms, sizeof(*syms), sym_hotter);
+	printf("\n     %%  samples  function\n");
+	for (i = 0; i < nsyms && syms[i].samples; i++) {
+		printf("%6.1f %8lu  %s\n",
+				100.0 * syms[i].samples / total,
+				syms[i].samples, syms[i].name);
+		unknown -= syms[i].samples;
+	}
+	if (unknown)
+		printf("%6.1f %8lu  (no symbol)\n", 100.0 * unknown / total, unknown);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check the functions ramfunc.h puts in RAM against their
+ * budgets, using the symbol table of the firmware ELF.
+ *
+ *   ./ramcheck out/code.elf
+ *
+ * ramfunc.c leaves an absolute __ramfunc_budget_<name>
+ * symbol for every function in RAMFUNCS. A listed function
+ * bigger than its budget or not in RAM, or a function in
+ * RAM without a budget, makes this fail.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#define RAM_START 0x20000000U
+#define RAM_SIZE  0x2000U
+#define BUDGET    "__ramfunc_budget_"
+
+struct sym {
+	uint32_t addr;
+	uint32_t size;
+	const char *name;
+	bool func;
+	bool abs;
+};
+
+static struct sym *syms;
+static unsigned int nsyms;
+
+static uint8_t *
+slurp(const char *path, size_t *len)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf;
+	long size;
+
+	if (f == NULL) {
+		perror(path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	buf = malloc(size + 1);
+	if (buf == NULL || fread(buf, 1, size, f) != (size_t)size) {
+		fprintf(stderr, "%s: read failed\n", path);
+		fclose(f);
+		free(buf);
+		return NULL;
+	}
+	fclose(f);
+	buf[size] = '\0';
+	*len = size;
+	return buf;
+}
+
+/* functions and absolute symbols */
+static int
+load_elf(const char *path)
+{
+	const Elf32_Ehdr *eh;
+	const Elf32_Shdr *sh;
+	uint8_t *elf;
+	size_t len;
+	unsigned int i;
+
+	elf = slurp(path, &len);
+	if (elf == NULL)
+		return -1;
+
+	eh = (const Elf32_Ehdr *)elf;
+	if (len < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0
+			|| eh->e_ident[EI_CLASS] != ELFCLASS32
+			|| eh->e_ident[EI_DATA] != ELFDATA2LSB
+			|| eh->e_shoff + (size_t)eh->e_shnum * sizeof(*sh) > len) {
+		fprintf(stderr, "%s: not a 32bit little endian ELF\n", path);
+		return -1;
+	}
+	sh = (const Elf32_Shdr *)(elf + eh->e_shoff);
+
+	for (i = 0; i < eh->e_shnum; i++) {
+		const Elf32_Sym *st;
+		const char *strtab;
+		unsigned int j, n;
+
+		if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
+			continue;
+		st = (const Elf32_Sym *)(elf + sh[i].sh_offset);
+		strtab = (const char *)elf + sh[sh[i].sh_link].sh_offset;
+		n = sh[i].sh_size / sizeof(*st);
+
+		syms = realloc(syms, (nsyms + n) * sizeof(*syms));
+		if (syms == NULL)
+			return -1;
+		for (j = 0; j < n; j++) {
+			bool func = ELF32_ST_TYPE(st[j].st_info) == STT_FUNC
+				&& st[j].st_shndx != SHN_UNDEF;
+			bool abs = st[j].st_shndx == SHN_ABS;
+
+			if (!func && !abs)
+				continue;
+			/* drop the thumb bit */
+			syms[nsyms].addr = func ? st[j].st_value & ~1U : st[j].st_value;
+			syms[nsyms].size = st[j].st_size;
+			syms[nsyms].name = strtab + st[j].st_name;
+			syms[nsyms].func = func;
+			syms[nsyms].abs = abs;
+			nsyms += 1;
+		}
+	}
+	return 0;
+}
+
+static const struct sym *
+lookup_func(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < nsyms; i++) {
+		if (syms[i].func && strcmp(syms[i].name, name) == 0)
+			return &syms[i];
+	}
+	return NULL;
+}
+
+static bool
+has_budget(const char *name)
+{
+	size_t len = strlen(BUDGET);
+	unsigned int i;
+
+	for (i = 0; i < nsyms; i++) {
+		if (syms[i].abs && strncmp(syms[i].name, BUDGET, len) == 0
+				&& strcmp(syms[i].name + len, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool
+in_ram(uint32_t addr)
+{
+	return addr >= RAM_START && addr < RAM_START + RAM_SIZE;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long total = 0;
+	unsigned long budgets = 0;
+	unsigned int i;
+	int ret = EXIT_SUCCESS;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s firmware.elf\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (load_elf(argv[1]))
+		return EXIT_FAILURE;
+
+	printf("    addr  size budget  function\n");
+	for (i = 0; i < nsyms; i++) {
+		const char *name = syms[i].name;
+		unsigned long budget = syms[i].addr;
+		const struct sym *f;
+
+		if (!syms[i].abs || strncmp(name, BUDGET, strlen(BUDGET)) != 0)
+			continue;
+		name += strlen(BUDGET);
+		budgets += budget;
+
+		f = lookup_func(name);
+		if (f == NULL) {
+			printf("       -     -  %5lu  %s: not found\n", budget, name);
+			ret = EXIT_FAILURE;
+			continue;
+		}
+		printf("%08lx %5lu  %5lu  %s", (unsigned long)f->addr,
+				(unsigned long)f->size, budget, name);
+		total += f->size;
+		if (!in_ram(f->addr)) {
+			printf(": not in RAM\n");
+			ret = EXIT_FAILURE;
+		} else if (f->size > budget) {
+			printf(": over budget\n");
+			ret = EXIT_FAILURE;
+		} else
+			printf("\n");
+	}
+
+	for (i = 0; i < nsyms; i++) {
+		if (!syms[i].func || !in_ram(syms[i].addr)
+				|| has_budget(syms[i].name))
+			continue;
+		printf("%08lx %5lu      -  %s: no budget\n",
+				(unsigned long)syms[i].addr,
+				(unsigned long)syms[i].size, syms[i].name);
+		total += syms[i].size;
+		ret = EXIT_FAILURE;
+	}
+
+	printf("%lu bytes of RAM, budget %lu\n", total, budgets);
+	return ret;
+}
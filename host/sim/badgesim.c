@@ -0,0 +1,254 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Run the firmware headless on the host.
+ *
+ *   ./badgesim [-s script] [-i sdcard.img | -c files]
+ *              [-m card model] [-o final.ppm] [-t ms]
+ *
+ * The script is read line by line:
+ *
+ *   wait MS            let MS milliseconds pass
+ *   press BUTTON [MS]  press and hold for MS (100) ms
+ *   down BUTTON        press and keep holding
+ *   up BUTTON          release
+ *   shot FILE          save the screen as a PPM image
+ *   check NAME [HASH]  compare a hash of the screen with HASH,
+ *                      or just print it when HASH is left out
+ *   disk NAME          print SD card traffic since the last disk line
+ *   lcd NAME           print display traffic since the last lcd line
+ *   quit
+ *
+ * where BUTTON is one of sup, smid, sdown, up, down,
+ * left, right, center or power. The simulation ends when
+ * the script does, when the firmware powers off or after
+ * -t ms of simulated time. The card model is given as
+ * for fatdisk_parse(), and the time the card takes is
+ * simulated time too. Instead of a card image -c makes
+ * up a card with a directory of that many small files and
+ * a bitmap, see fatdisk_make(). The exit code is non-zero
+ * when a check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+#include "geckonator/gpio.h"
+
+#include "fatdisk.h"
+#include "sim.h"
+
+#define NS_PER_MS 1000000U
+
+void badge_main(void);
+
+static const char *final_shot;
+
+struct button_pin {
+	const char *name;
+	gpio_pin_t pin;
+};
+
+static const struct button_pin button_pins[] = {
+	{ "sup",    GPIO_PC10 },
+	{ "smid",   GPIO_PC9 },
+	{ "sdown",  GPIO_PC8 },
+	{ "up",     GPIO_PF2 },
+	{ "down",   GPIO_PF3 },
+	{ "left",   GPIO_PF4 },
+	{ "right",  GPIO_PF5 },
+	{ "center", GPIO_PB11 },
+	{ "power",  GPIO_PC4 },
+};
+
+static FILE *script;
+static const char *script_name;
+static unsigned int script_line;
+static int release = -1;
+static bool script_busy;
+
+static void __noreturn
+script_error(const char *msg, const char *arg)
+{
+	fprintf(stderr, "%s:%u: %s '%s'\n", script_name, script_line, msg, arg);
+	exit(EXIT_FAILURE);
+}
+
+static gpio_pin_t
+script_button(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(button_pins); i++) {
+		if (strcmp(button_pins[i].name, name) == 0)
+			return button_pins[i].pin;
+	}
+	script_error("unknown button", name);
+}
+
+/* run script lines until one of them makes time pass */
+static void
+script_run(void)
+{
+	char line[256];
+	bool waiting = false;
+
+	if (script_busy)
+		return;
+	script_busy = true;
+
+	if (release >= 0) {
+		sim_gpio_input(release, true);
+		release = -1;
+	}
+
+	while (script && fgets(line, sizeof(line), script)) {
+		char cmd[16] = "";
+		char arg[224] = "";
+		unsigned long ms = 0;
+		int n;
+
+		script_line += 1;
+		n = sscanf(line, "%15s %223s %lu", cmd, arg, &ms);
+		if (n < 1 || cmd[0] == '#')
+			continue;
+
+		if (strcmp(cmd, "wait") == 0) {
+			sim_alarm(sim_ns() + strtoul(arg, NULL, 0) * NS_PER_MS, script_run);
+			waiting = true;
+			break;
+		} else if (strcmp(cmd, "press") == 0) {
+			gpio_pin_t pin = script_button(arg);
+
+			sim_gpio_input(pin, false);
+			release = pin;
+			sim_alarm(sim_ns() + (n > 2 ? ms : 100) * NS_PER_MS, script_run);
+			waiting = true;
+			break;
+		} else if (strcmp(cmd, "down") == 0) {
+			sim_gpio_input(script_button(arg), false);
+		} else if (strcmp(cmd, "up") == 0) {
+			sim_gpio_input(script_button(arg), true);
+		} else if (strcmp(cmd, "shot") == 0) {
+			if (lcd_screenshot(arg))
+				script_error("cannot write", arg);
+		} else if (strcmp(cmd, "check") == 0) {
+			char want[16] = "";
+			uint32_t hash = lcd_hash();
+
+			if (sscanf(line, "%*s %*s %15s", want) < 1)
+				printf("%-12s 0x%08x\n", arg, hash);
+			else if (strtoul(want, NULL, 16) != hash) {
+				fprintf(stderr, "%s:%u: %s is 0x%08x, expected %s\n",
+						script_name, script_line, arg, hash, want);
+				sim_fail();
+			}
+		} else if (strcmp(cmd, "disk") == 0) {
+			struct fatdisk_stats st;
+
+			fatdisk_stats(&st);
+			fatdisk_print(arg, &st);
+			fatdisk_stats_reset();
+		} else if (strcmp(cmd, "lcd") == 0) {
+			struct lcd_stats st;
+
+			lcd_stats(&st);
+			printf("%-12s %9lu cmd bytes %9lu data bytes %6lu dc toggles %9.3f ms\n",
+					arg, (unsigned long)st.cmd_bytes,
+					(unsigned long)st.data_bytes,
+					(unsigned long)st.dc_toggles, st.ns / 1e6);
+			lcd_stats_reset();
+		} else if (strcmp(cmd, "quit") == 0) {
+			script_busy = false;
+			sim_finish("script done");
+		} else
+			script_error("unknown command", cmd);
+	}
+
+	script_busy = false;
+	if (!waiting && script && feof(script))
+		sim_finish("script done");
+}
+
+static void
+final_screenshot(void)
+{
+	if (final_shot)
+		lcd_screenshot(final_shot);
+}
+
+static void __noreturn
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s script] [-i sdcard.img | -c files]\n"
+			"       [-m spi_hz,cmd_us,read_us,write_us] [-o final.ppm] [-t ms]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct fatdisk_model model = fatdisk_default;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+
+		if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0' || i + 1 >= argc)
+			usage(argv[0]);
+		i += 1;
+		switch (arg[1]) {
+		case 's':
+			script_name = argv[i];
+			script = fopen(script_name, "r");
+			if (script == NULL) {
+				perror(script_name);
+				return EXIT_FAILURE;
+			}
+			sim_alarm(0, script_run);
+			break;
+		case 'i':
+			if (fatdisk_open(argv[i]))
+				return EXIT_FAILURE;
+			break;
+		case 'c':
+			fatdisk_make(strtoul(argv[i], NULL, 0), false);
+			break;
+		case 'm':
+			if (fatdisk_parse(&model, argv[i]))
+				usage(argv[0]);
+			break;
+		case 'o':
+			final_shot = argv[i];
+			break;
+		case 't':
+			sim_limit(strtoull(argv[i], NULL, 0) * NS_PER_MS);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	atexit(final_screenshot);
+	fatdisk_config(&model, sim_advance);
+	badge_main();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GECKONATOR_CLOCK_H
+#define _GECKONATOR_CLOCK_H
+
+#include "common.h"
+
+#define CLOCK_LFA_ULFRCO   (2U << 0)
+#define CLOCK_LFB_DISABLED (0U << 2)
+#define CLOCK_LFC_DISABLED (0U << 4)
+
+void clock_ushfrco_48mhz_div2(void);
+void clock_ushfrco_enable(void);
+uint32_t clock_ushfrco_ready(void);
+void clock_hfclk_select_ushfrco(void);
+uint32_t clock_ushfrco_selected(void);
+void clock_hfrco_disable(void);
+void clock_auxhfrco_disable(void);
+void clock_lfrco_enable(void);
+void clock_le_enable(void);
+void clock_lf_config(uint32_t config);
+uint32_t clock_lf_syncbusy(void);
+void clock_lfa_select_ulfrco(void);
+void clock_rtc_div1(void);
+void clock_rtc_enable(void);
+void clock_gpio_enable(void);
+void clock_usart0_enable(void);
+void clock_usart0_disable(void);
+void clock_usart1_enable(void);
+void clock_usart1_disable(void);
+void clock_timer0_enable(void);
+void clock_timer0_disable(void);
+void clock_timer1_enable(void);
+void clock_timer1_disable(void);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GECKONATOR_COMMON_H
+#define _GECKONATOR_COMMON_H
+
+/*
+ * Just enough of geckonator and CMSIS for the firmware
+ * to build and run on the host, see ../sim.c. Registers
+ * the firmware touches directly are plain structs.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+#define __noreturn   __attribute__((noreturn))
+#define __used       __attribute__((used))
+#define __packed     __attribute__((packed))
+#define __aligned(x) __attribute__((aligned(x)))
+
+typedef enum {
+	PendSV_IRQn    = -2,
+	SysTick_IRQn   = -1,
+	DMA_IRQn       = 0,
+	GPIO_EVEN_IRQn = 1,
+	TIMER0_IRQn    = 2,
+	USART0_RX_IRQn = 3,
+	USART0_TX_IRQn = 4,
+	USB_IRQn       = 5,
+	ACMP0_IRQn     = 6,
+	ADC0_IRQn      = 7,
+	IDAC0_IRQn     = 8,
+	I2C0_IRQn      = 9,
+	GPIO_ODD_IRQn  = 10,
+	TIMER1_IRQn    = 11,
+	USART1_RX_IRQn = 12,
+	USART1_TX_IRQn = 13,
+	LEUART0_IRQn   = 14,
+	PCNT0_IRQn     = 15,
+	RTC_IRQn       = 16,
+	CMU_IRQn       = 17,
+	VCMP_IRQn      = 18,
+	MSC_IRQn       = 19,
+	AES_IRQn       = 20,
+} IRQn_Type;
+
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __WFI(void);
+void __NOP(void);
+void __DSB(void);
+void __ISB(void);
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t prio);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+	volatile uint32_t CPUID;
+	volatile uint32_t ICSR;
+	volatile uint32_t VTOR;
+	volatile uint32_t AIRCR;
+	volatile uint32_t SCR;
+	volatile uint32_t CCR;
+} SCB_Type;
+
+extern SysTick_Type *const SysTick;
+extern SCB_Type *const SCB;
+
+#define SysTick_CTRL_ENABLE_Msk    (1U << 0)
+#define SysTick_CTRL_TICKINT_Msk   (1U << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk (1U << 2)
+#define SCB_ICSR_PENDSVCLR_Msk     (1U << 27)
+#define SCB_ICSR_PENDSVSET_Msk     (1U << 28)
+#define SCB_SCR_SLEEPDEEP_Msk      (1U << 2)
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CCV;
+	volatile uint32_t CCVP;
+	volatile uint32_t CCVB;
+} TIMER_CC_TypeDef;
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CMD;
+	volatile uint32_t STATUS;
+	volatile uint32_t IEN;
+	volatile uint32_t IF;
+	volatile uint32_t IFS;
+	volatile uint32_t IFC;
+	volatile uint32_t TOP;
+	volatile uint32_t TOPB;
+	volatile uint32_t CNT;
+	volatile uint32_t ROUTE;
+	TIMER_CC_TypeDef CC[3];
+} TIMER_TypeDef;
+
+extern TIMER_TypeDef *const TIMER0;
+extern TIMER_TypeDef *const TIMER1;
+
+#define TIMER_CTRL_MODE_UP                (0U << 0)
+#define TIMER_CTRL_CLKSEL_CC1             (1U << 16)
+#define TIMER_CTRL_PRESC_DIV16            (4U << 24)
+#define TIMER_CMD_START                   (1U << 0)
+#define TIMER_CMD_STOP                    (1U << 1)
+#define TIMER_STATUS_ICV1                 (1U << 17)
+#define TIMER_CC_CTRL_MODE_INPUTCAPTURE   (1U << 0)
+#define TIMER_CC_CTRL_MODE_OUTPUTCOMPARE  (2U << 0)
+#define TIMER_CC_CTRL_FILT_ENABLE         (1U << 21)
+#define TIMER_CC_CTRL_ICEDGE_RISING       (0U << 24)
+#define TIMER_CC_CTRL_ICEDGE_BOTH         (2U << 24)
+#define TIMER_CC_CTRL_ICEVCTRL_EVERYEDGE  (1U << 26)
+#define TIMER_ROUTE_CC1PEN                (1U << 1)
+#define TIMER_ROUTE_LOCATION_LOC1         (1U << 16)
+#define TIMER_IF_OF                       (1U << 0)
+#define TIMER_IF_CC0                      (1U << 4)
+#define TIMER_IF_CC1                      (1U << 5)
+#define TIMER_IF_ICBOF1                   (1U << 9)
+#define TIMER_IEN_OF                      TIMER_IF_OF
+#define TIMER_IEN_CC0                     TIMER_IF_CC0
+#define TIMER_IEN_CC1                     TIMER_IF_CC1
+#define TIMER_IEN_ICBOF1                  TIMER_IF_ICBOF1
+
+typedef struct {
+	volatile uint32_t CTRL;
+} CMU_TypeDef;
+
+extern CMU_TypeDef *const CMU;
+
+#define _CMU_CTRL_HFCLKDIV_SHIFT          14
+#define _CMU_CTRL_HFCLKDIV_MASK           (7U << 14)
+
+typedef struct {
+	uint32_t UNIQUEL;
+	uint32_t UNIQUEH;
+} DEVINFO_TypeDef;
+
+extern DEVINFO_TypeDef *const DEVINFO;
+
+#endif
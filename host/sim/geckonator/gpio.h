@@ -0,0 +1,80 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GECKONATOR_GPIO_H
+#define _GECKONATOR_GPIO_H
+
+#include "common.h"
+
+#define GPIO_PORT(x) \
+	GPIO_P##x##0,  GPIO_P##x##1,  GPIO_P##x##2,  GPIO_P##x##3, \
+	GPIO_P##x##4,  GPIO_P##x##5,  GPIO_P##x##6,  GPIO_P##x##7, \
+	GPIO_P##x##8,  GPIO_P##x##9,  GPIO_P##x##10, GPIO_P##x##11, \
+	GPIO_P##x##12, GPIO_P##x##13, GPIO_P##x##14, GPIO_P##x##15
+
+typedef enum {
+	GPIO_PORT(A),
+	GPIO_PORT(B),
+	GPIO_PORT(C),
+	GPIO_PORT(D),
+	GPIO_PORT(E),
+	GPIO_PORT(F),
+	GPIO_PINS,
+} gpio_pin_t;
+
+#undef GPIO_PORT
+
+enum {
+	GPIO_MODE_DISABLED,
+	GPIO_MODE_INPUT,
+	GPIO_MODE_INPUTPULL,
+	GPIO_MODE_INPUTPULLFILTER,
+	GPIO_MODE_PUSHPULL,
+	GPIO_MODE_WIREDAND,
+};
+
+#define GPIO_WAKEUP_PC4 (1U << 2)
+
+void gpio_set(gpio_pin_t pin);
+void gpio_clear(gpio_pin_t pin);
+void gpio_toggle(gpio_pin_t pin);
+uint32_t gpio_in(gpio_pin_t pin);
+void gpio_mode(gpio_pin_t pin, int mode);
+
+uint32_t gpio_flags(void);
+uint32_t gpio_flags_enabled(uint32_t flags);
+static inline uint32_t
+gpio_flag(uint32_t flags, gpio_pin_t pin)
+{
+	return flags & (1U << (pin & 15));
+}
+void gpio_flag_select(gpio_pin_t pin);
+void gpio_flag_rising_enable(gpio_pin_t pin);
+void gpio_flag_rising_disable(gpio_pin_t pin);
+void gpio_flag_falling_enable(gpio_pin_t pin);
+void gpio_flag_falling_disable(gpio_pin_t pin);
+void gpio_flag_clear(gpio_pin_t pin);
+void gpio_flag_enable(gpio_pin_t pin);
+void gpio_flag_disable(gpio_pin_t pin);
+
+void gpio_wakeup_clear(void);
+void gpio_retention_enable(void);
+void gpio_wakeup_rising(uint32_t pins);
+void gpio_wakeup_pins(uint32_t pins);
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GECKONATOR_RTC_H
+#define _GECKONATOR_RTC_H
+
+#include "common.h"
+
+#define RTC_ENABLE (1U << 0)
+
+uint32_t rtc_counter(void);
+void rtc_config(uint32_t ctrl);
+void rtc_comp0_set(uint32_t v);
+void rtc_flag_comp0_clear(void);
+void rtc_flag_comp0_enable(void);
+void rtc_flag_comp0_disable(void);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GECKONATOR_USART1_H
+#define _GECKONATOR_USART1_H
+
+#include "common.h"
+
+#ifndef USART_CTRL_SYNC
+#define USART_CTRL_SYNC           (1U << 0)
+#define USART_CTRL_LOOPBK         (1U << 1)
+#define USART_CTRL_CLKPOL         (1U << 8)
+#define USART_CTRL_CLKPHA         (1U << 9)
+#define USART_CTRL_MSBF           (1U << 10)
+#define USART_CTRL_RXINV          (1U << 16)
+#define USART_CTRL_TXINV          (1U << 17)
+#define USART_TXDATAX_TXTRIAT     (1U << 12)
+#define USART_TXDATAX_RXENAT      (1U << 13)
+#define USART_ROUTE_RXPEN         (1U << 0)
+#define USART_ROUTE_TXPEN         (1U << 1)
+#define USART_ROUTE_CSPEN         (1U << 2)
+#define USART_ROUTE_CLKPEN        (1U << 3)
+#define USART_ROUTE_LOCATION_LOC0 (0U << 8)
+#define USART_ROUTE_LOCATION_LOC4 (4U << 8)
+#define USART_ROUTE_LOCATION_LOC5 (5U << 8)
+#define USART_IRCTRL_IREN         (1U << 0)
+#define USART_IRCTRL_IRPW_ONE     (0U << 1)
+#define USART_IRCTRL_IRPW_TWO     (1U << 1)
+#define USART_IRCTRL_IRPW_THREE   (2U << 1)
+#define USART_IRCTRL_IRPW_FOUR    (3U << 1)
+#define USART_IRCTRL_IRFILT       (1U << 3)
+#define USART_IF_RXFULL           (1U << 3)
+#define USART_IF_RXOF             (1U << 4)
+#endif
+
+void usart1_config(uint32_t ctrl);
+void usart1_irda_config(uint32_t irctrl);
+void usart1_frame_8n1(void);
+void usart1_frame_bits(unsigned int bits);
+void usart1_clock_div(uint32_t div);
+void usart1_master_enable(void);
+void usart1_master_disable(void);
+void usart1_tx_enable(void);
+void usart1_rx_enable(void);
+void usart1_rx_disable(void);
+void usart1_rxtx_disable(void);
+void usart1_tx_tristate_disable(void);
+void usart1_pins(uint32_t route);
+
+uint32_t usart1_tx_buffer_level(void);
+uint32_t usart1_tx_complete(void);
+void usart1_txdata(uint32_t data);
+void usart1_txdatax(uint32_t data);
+uint32_t usart1_rx_valid(void);
+uint8_t usart1_rxdata(void);
+
+uint32_t usart1_flags(void);
+static inline uint32_t
+usart1_flag_rx_overflow(uint32_t flags)
+{
+	return flags & USART_IF_RXOF;
+}
+void usart1_flag_rx_overflow_clear(void);
+void usart1_flag_rx_overflow_enable(void);
+void usart1_flag_rx_overflow_disable(void);
+void usart1_flag_rx_valid_enable(void);
+void usart1_flag_rx_valid_disable(void);
+
+#endif
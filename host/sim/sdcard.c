@@ -0,0 +1,81 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The card itself is simulated by ../fatdisk.c standing in
+ * for diskio.c, so all that's left here is to take part in
+ * sharing USART0 with IR and let the odd app read raw blocks.
+ */
+
+#include "ff.h"
+#include "diskio.h"
+#include "bus.h"
+#include "sdcard.h"
+
+static void sd_attach(void) { }
+static void sd_detach(void) { }
+
+static const struct bus_client sd_client = {
+	.attach = sd_attach,
+	.detach = sd_detach,
+};
+
+void
+sd_init(void)
+{
+	bus_enable(BUS_SD, &sd_client);
+}
+
+void
+sd_uninit(void)
+{
+	bus_disable(BUS_SD);
+}
+
+/* the simulated card doesn't care about the spi clock */
+void
+sd_clock_update(void)
+{
+}
+
+static uint32_t sd_clockdiv_run;
+
+uint32_t
+sd_clock_get(void)
+{
+	return sd_clockdiv_run;
+}
+
+void
+sd_clock_run(uint32_t div)
+{
+	sd_clockdiv_run = div;
+}
+
+uint8_t
+sd_readblock(uint32_t lba, uint8_t buf[512])
+{
+	return disk_read(0, buf, lba, 1) == RES_OK ? 0x00 : 0xFF;
+}
+
+/* nor does it ever garble a block */
+uint8_t
+sd_readblock_check(uint32_t lba, uint8_t buf[512])
+{
+	return sd_readblock(lba, buf);
+}
@@ -0,0 +1,558 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The parts of the EFM32 the firmware uses, enough to run
+ * it on the host. Interrupts are dispatched by priority as
+ * soon as they are pending and unmasked, and time only moves
+ * when the firmware spends it: shifting bytes out, polling
+ * the rtc or sleeping until the next timer or alarm.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+#include "geckonator/gpio.h"
+#include "geckonator/rtc.h"
+#include "geckonator/clock.h"
+#include "geckonator/emu.h"
+
+#include "speed.h"
+#include "sim.h"
+
+#define RTC_MASK   0xFFFFFFU
+#define NS_PER_MS  1000000U
+#define IRQS       (RTC_IRQn + 1)
+#define NEVER      UINT64_MAX
+
+void PendSV_Handler(void);
+void RTC_IRQHandler(void);
+void GPIO_EVEN_IRQHandler(void);
+void GPIO_ODD_IRQHandler(void);
+void USART0_RX_IRQHandler(void);
+void TIMER1_IRQHandler(void);
+
+static SysTick_Type sim_systick;
+static SCB_Type sim_scb;
+static TIMER_TypeDef sim_timer0;
+static TIMER_TypeDef sim_timer1;
+static CMU_TypeDef sim_cmu;
+static DEVINFO_TypeDef sim_devinfo = {
+	.UNIQUEL = 0x5EB0A7D1,
+	.UNIQUEH = 0x00B1D6E5,
+};
+
+SysTick_Type *const SysTick = &sim_systick;
+SCB_Type *const SCB = &sim_scb;
+TIMER_TypeDef *const TIMER0 = &sim_timer0;
+TIMER_TypeDef *const TIMER1 = &sim_timer1;
+CMU_TypeDef *const CMU = &sim_cmu;
+DEVINFO_TypeDef *const DEVINFO = &sim_devinfo;
+
+static uint64_t now_ns;
+static uint64_t end_ns = NEVER;
+static uint64_t alarm_at = NEVER;
+static int exit_status = EXIT_SUCCESS;
+static void (*alarm_cb)(void);
+
+/*
+ * Interrupts
+ */
+static bool primask;
+static unsigned int running = 4; /* priority of what runs now, 4 is thread mode */
+static uint32_t nvic_enabled;
+static uint32_t nvic_pending;
+static uint8_t nvic_prio[IRQS];
+static uint8_t pendsv_prio;
+static unsigned long irqs_taken;
+
+static uint32_t rtc_comp0;
+static bool rtc_if;
+static bool rtc_ien;
+static bool rtc_on;
+
+static uint16_t gpio_dout[GPIO_PINS / 16];
+static uint8_t gpio_modes[GPIO_PINS];
+static uint8_t gpio_extisel[16];
+static uint16_t gpio_falling;
+static uint16_t gpio_rising;
+static uint16_t gpio_if;
+static uint16_t gpio_ien;
+
+static bool
+irq_active(int irq)
+{
+	if (irq == PendSV_IRQn)
+		return SCB->ICSR & SCB_ICSR_PENDSVSET_Msk;
+	if (!(nvic_enabled & (1U << irq)))
+		return false;
+	switch (irq) {
+	case RTC_IRQn:
+		return rtc_if && rtc_ien;
+	case GPIO_EVEN_IRQn:
+		return gpio_if & gpio_ien & 0x5555U;
+	case GPIO_ODD_IRQn:
+		return gpio_if & gpio_ien & 0xAAAAU;
+	}
+	return nvic_pending & (1U << irq);
+}
+
+static void
+irq_call(int irq)
+{
+	switch (irq) {
+	case PendSV_IRQn:
+		SCB->ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+		PendSV_Handler();
+		break;
+	case RTC_IRQn:
+		RTC_IRQHandler();
+		break;
+	case GPIO_EVEN_IRQn:
+		GPIO_EVEN_IRQHandler();
+		break;
+	case GPIO_ODD_IRQn:
+		GPIO_ODD_IRQHandler();
+		break;
+	case USART0_RX_IRQn:
+		nvic_pending &= ~(1U << irq);
+		USART0_RX_IRQHandler();
+		break;
+	case TIMER1_IRQn:
+		nvic_pending &= ~(1U << irq);
+		TIMER1_IRQHandler();
+		break;
+	default:
+		nvic_pending &= ~(1U << irq);
+		break;
+	}
+}
+
+/* run whatever may preempt the current priority */
+static void
+irq_dispatch(void)
+{
+	while (!primask) {
+		unsigned int prev = running;
+		unsigned int best = running;
+		int pick = 0;
+		int irq;
+
+		if (irq_active(PendSV_IRQn) && pendsv_prio < best) {
+			best = pendsv_prio;
+			pick = PendSV_IRQn;
+		}
+		for (irq = 0; irq < IRQS; irq++) {
+			if (irq_active(irq) && nvic_prio[irq] < best) {
+				best = nvic_prio[irq];
+				pick = irq;
+			}
+		}
+		if (best == running)
+			return;
+
+		running = best;
+		irqs_taken += 1;
+		irq_call(pick);
+		running = prev;
+	}
+}
+
+void
+__disable_irq(void)
+{
+	primask = true;
+}
+
+void
+__enable_irq(void)
+{
+	primask = false;
+	irq_dispatch();
+}
+
+uint32_t
+__get_PRIMASK(void)
+{
+	return primask;
+}
+
+void __NOP(void) { }
+void __DSB(void) { }
+void __ISB(void) { }
+
+void
+NVIC_SetPriority(IRQn_Type irq, uint32_t prio)
+{
+	if (irq == PendSV_IRQn)
+		pendsv_prio = prio;
+	else if (irq >= 0 && irq < IRQS)
+		nvic_prio[irq] = prio;
+}
+
+void
+NVIC_EnableIRQ(IRQn_Type irq)
+{
+	nvic_enabled |= 1U << irq;
+	irq_dispatch();
+}
+
+void
+NVIC_DisableIRQ(IRQn_Type irq)
+{
+	nvic_enabled &= ~(1U << irq);
+}
+
+void
+NVIC_SetPendingIRQ(IRQn_Type irq)
+{
+	nvic_pending |= 1U << irq;
+	irq_dispatch();
+}
+
+void
+NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+	nvic_pending &= ~(1U << irq);
+}
+
+/*
+ * Time
+ */
+static uint32_t
+rtc_ms(uint64_t ns)
+{
+	return (ns / NS_PER_MS) & RTC_MASK;
+}
+
+uint64_t
+sim_ns(void)
+{
+	return now_ns;
+}
+
+void __noreturn
+sim_finish(const char *why)
+{
+	fprintf(stderr, "badgesim: %s after %.3f s\n", why, now_ns / 1e9);
+	exit(exit_status);
+}
+
+/* make sim_finish() exit with a failure, the run goes on */
+void
+sim_fail(void)
+{
+	exit_status = EXIT_FAILURE;
+}
+
+void
+sim_limit(uint64_t ns)
+{
+	end_ns = ns;
+}
+
+/* call cb once sim_ns() reaches at */
+void
+sim_alarm(uint64_t at, void (*cb)(void))
+{
+	alarm_at = at;
+	alarm_cb = cb;
+}
+
+void
+sim_advance(uint64_t ns)
+{
+	uint64_t old = now_ns / NS_PER_MS;
+	uint64_t new;
+
+	now_ns += ns;
+	new = now_ns / NS_PER_MS;
+
+	SysTick->VAL = (RTC_MASK - now_ns * (CORE_HZ / 1000000U) / 1000) & RTC_MASK;
+
+	if (rtc_on && new > old
+			&& ((rtc_comp0 - old - 1) & RTC_MASK) < new - old)
+		rtc_if = true;
+
+	if (now_ns >= end_ns)
+		sim_finish("time limit reached");
+	if (now_ns >= alarm_at) {
+		alarm_at = NEVER;
+		alarm_cb();
+	}
+	irq_dispatch();
+}
+
+/* when the rtc will match comp0 next */
+static uint64_t
+rtc_next(void)
+{
+	uint64_t ms;
+
+	if (!rtc_on || !rtc_ien || rtc_if)
+		return NEVER;
+	ms = now_ns / NS_PER_MS;
+	ms += ((rtc_comp0 - ms - 1) & RTC_MASK) + 1;
+	return ms * NS_PER_MS;
+}
+
+static bool
+irq_waiting(void)
+{
+	int irq;
+
+	if (irq_active(PendSV_IRQn) && pendsv_prio < running)
+		return true;
+	for (irq = 0; irq < IRQS; irq++) {
+		if (irq_active(irq) && nvic_prio[irq] < running)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Sleep until an interrupt is pending or has been taken,
+ * skipping straight to the next rtc match or alarm.
+ */
+void
+__WFI(void)
+{
+	unsigned long taken = irqs_taken;
+
+	while (!irq_waiting() && irqs_taken == taken) {
+		uint64_t next = rtc_next();
+
+		if (alarm_at < next)
+			next = alarm_at;
+		if (end_ns < next)
+			next = end_ns;
+		if (next == NEVER)
+			sim_finish("nothing left to wait for");
+		if (next > now_ns)
+			sim_advance(next - now_ns);
+		else
+			sim_advance(0);
+	}
+	irq_dispatch();
+}
+
+/*
+ * RTC
+ */
+uint32_t
+rtc_counter(void)
+{
+	/* reading the counter takes a little time,
+	 * so busy loops polling it still get somewhere */
+	sim_advance(1000);
+	return rtc_ms(now_ns);
+}
+
+void
+rtc_config(uint32_t ctrl)
+{
+	rtc_on = ctrl & RTC_ENABLE;
+}
+
+void rtc_comp0_set(uint32_t v)     { rtc_comp0 = v & RTC_MASK; }
+void rtc_flag_comp0_clear(void)    { rtc_if = false; }
+void rtc_flag_comp0_enable(void)   { rtc_ien = true; }
+void rtc_flag_comp0_disable(void)  { rtc_ien = false; }
+
+/*
+ * GPIO
+ */
+static uint16_t gpio_driven[GPIO_PINS / 16];
+static uint16_t gpio_level[GPIO_PINS / 16];
+
+static inline uint32_t
+bit(gpio_pin_t pin)
+{
+	return 1U << (pin & 15);
+}
+
+uint32_t
+sim_gpio_out(gpio_pin_t pin)
+{
+	return gpio_dout[pin >> 4] & bit(pin);
+}
+
+uint32_t
+gpio_in(gpio_pin_t pin)
+{
+	unsigned int port = pin >> 4;
+
+	switch (gpio_modes[pin]) {
+	case GPIO_MODE_DISABLED:
+		return 0;
+	case GPIO_MODE_INPUT:
+		return gpio_level[port] & gpio_driven[port] & bit(pin);
+	case GPIO_MODE_INPUTPULL:
+	case GPIO_MODE_INPUTPULLFILTER:
+		if (gpio_driven[port] & bit(pin))
+			return gpio_level[port] & bit(pin);
+		return gpio_dout[port] & bit(pin);
+	case GPIO_MODE_WIREDAND:
+		if (gpio_driven[port] & bit(pin))
+			return gpio_level[port] & gpio_dout[port] & bit(pin);
+		return gpio_dout[port] & bit(pin);
+	}
+	return gpio_dout[port] & bit(pin);
+}
+
+static void
+gpio_edge(gpio_pin_t pin, uint32_t old)
+{
+	uint32_t new = gpio_in(pin);
+	unsigned int line = pin & 15;
+
+	if (old == new || gpio_extisel[line] != pin >> 4)
+		return;
+	if ((new && (gpio_rising & bit(pin))) || (!new && (gpio_falling & bit(pin))))
+		gpio_if |= bit(pin);
+}
+
+void
+sim_gpio_input(gpio_pin_t pin, bool level)
+{
+	uint32_t old = gpio_in(pin);
+	unsigned int port = pin >> 4;
+
+	gpio_driven[port] |= bit(pin);
+	if (level)
+		gpio_level[port] |= bit(pin);
+	else
+		gpio_level[port] &= ~bit(pin);
+	gpio_edge(pin, old);
+}
+
+static void
+gpio_write(gpio_pin_t pin, bool level)
+{
+	uint32_t old = gpio_in(pin);
+	bool was = gpio_dout[pin >> 4] & bit(pin);
+
+	if (level)
+		gpio_dout[pin >> 4] |= bit(pin);
+	else
+		gpio_dout[pin >> 4] &= ~bit(pin);
+	gpio_edge(pin, old);
+
+	/* display reset and D/CX */
+	if (pin == GPIO_PC2 && was && !level)
+		lcd_reset();
+	if (pin == GPIO_PA2 && was != level)
+		lcd_dc();
+}
+
+void gpio_set(gpio_pin_t pin)    { gpio_write(pin, true); }
+void gpio_clear(gpio_pin_t pin)  { gpio_write(pin, false); }
+void gpio_toggle(gpio_pin_t pin) { gpio_write(pin, !sim_gpio_out(pin)); }
+
+void
+gpio_mode(gpio_pin_t pin, int mode)
+{
+	uint32_t old = gpio_in(pin);
+
+	gpio_modes[pin] = mode;
+	gpio_edge(pin, old);
+}
+
+uint32_t gpio_flags(void)                    { return gpio_if; }
+uint32_t gpio_flags_enabled(uint32_t flags)  { return flags & gpio_ien; }
+void gpio_flag_select(gpio_pin_t pin)        { gpio_extisel[pin & 15] = pin >> 4; }
+void gpio_flag_rising_enable(gpio_pin_t pin) { gpio_rising |= bit(pin); }
+void gpio_flag_rising_disable(gpio_pin_t pin) { gpio_rising &= ~bit(pin); }
+void gpio_flag_falling_enable(gpio_pin_t pin) { gpio_falling |= bit(pin); }
+void gpio_flag_falling_disable(gpio_pin_t pin) { gpio_falling &= ~bit(pin); }
+void gpio_flag_clear(gpio_pin_t pin)         { gpio_if &= ~bit(pin); }
+void gpio_flag_enable(gpio_pin_t pin)        { gpio_ien |= bit(pin); irq_dispatch(); }
+void gpio_flag_disable(gpio_pin_t pin)       { gpio_ien &= ~bit(pin); }
+
+void gpio_wakeup_clear(void) { }
+void gpio_retention_enable(void) { }
+void gpio_wakeup_rising(uint32_t pins) { (void)pins; }
+void gpio_wakeup_pins(uint32_t pins) { (void)pins; }
+
+/*
+ * Clocks and energy modes
+ */
+void clock_ushfrco_48mhz_div2(void) { }
+void clock_ushfrco_enable(void) { }
+uint32_t clock_ushfrco_ready(void) { return 1; }
+void clock_hfclk_select_ushfrco(void) { }
+uint32_t clock_ushfrco_selected(void) { return 1; }
+void clock_hfrco_disable(void) { }
+void clock_auxhfrco_disable(void) { }
+void clock_lfrco_enable(void) { }
+void clock_le_enable(void) { }
+void clock_lf_config(uint32_t config) { (void)config; }
+uint32_t clock_lf_syncbusy(void) { return 0; }
+void clock_lfa_select_ulfrco(void) { }
+void clock_rtc_div1(void) { }
+void clock_rtc_enable(void) { }
+void clock_gpio_enable(void) { }
+void clock_usart0_enable(void) { }
+void clock_usart0_disable(void) { }
+void clock_usart1_enable(void) { }
+void clock_usart1_disable(void) { }
+void clock_timer0_enable(void) { }
+void clock_timer0_disable(void) { }
+void clock_timer1_enable(void) { }
+void clock_timer1_disable(void) { }
+
+void __noreturn
+emu_em4_enter(void)
+{
+	sim_finish("powered off");
+	for (;;)
+		/* wait */;
+}
+
+/*
+ * USART0 is shared by the sd card and IR. The card is
+ * simulated a level up in sdcard.c and the IR medium
+ * is left dark, so the usart only has to look idle.
+ */
+void usart0_config(uint32_t ctrl) { (void)ctrl; }
+void usart0_irda_config(uint32_t irctrl) { (void)irctrl; }
+void usart0_frame_8n1(void) { }
+void usart0_frame_bits(unsigned int bits) { (void)bits; }
+void usart0_clock_div(uint32_t div) { (void)div; }
+void usart0_master_enable(void) { }
+void usart0_master_disable(void) { }
+void usart0_tx_enable(void) { }
+void usart0_rx_enable(void) { }
+void usart0_rx_disable(void) { }
+void usart0_rxtx_disable(void) { }
+void usart0_tx_tristate_disable(void) { }
+void usart0_pins(uint32_t route) { (void)route; }
+uint32_t usart0_tx_buffer_level(void) { return 1; }
+uint32_t usart0_tx_complete(void) { return 1; }
+void usart0_txdata(uint32_t data) { (void)data; }
+void usart0_txdatax(uint32_t data) { (void)data; }
+uint32_t usart0_rx_valid(void) { return 0; }
+uint8_t usart0_rxdata(void) { return 0xFF; }
+uint32_t usart0_flags(void) { return 0; }
+void usart0_flag_rx_overflow_clear(void) { }
+void usart0_flag_rx_overflow_enable(void) { }
+void usart0_flag_rx_overflow_disable(void) { }
+void usart0_flag_rx_valid_enable(void) { }
+void usart0_flag_rx_valid_disable(void) { }
@@ -0,0 +1,58 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "geckonator/common.h"
+#include "geckonator/gpio.h"
+
+/*
+ * The simulated badge. Time only moves when the
+ * firmware waits for something: WFI skips ahead to the
+ * next rtc match or alarm, and the peripherals add
+ * the time their transfers would take.
+ */
+uint64_t sim_ns(void);
+void sim_advance(uint64_t ns);
+void sim_alarm(uint64_t at, void (*cb)(void));
+void sim_limit(uint64_t ns);
+void __noreturn sim_finish(const char *why);
+void sim_fail(void);
+uint32_t sim_gpio_out(gpio_pin_t pin);
+void sim_gpio_input(gpio_pin_t pin, bool level);
+
+/* st7789.c */
+struct lcd_stats {
+	uint32_t cmd_bytes;
+	uint32_t data_bytes;
+	uint32_t dc_toggles;
+	uint64_t ns;         /* at the clock the firmware set */
+};
+
+void lcd_reset(void);
+void lcd_dc(void);
+int lcd_screenshot(const char *path);
+uint32_t lcd_hash(void);
+void lcd_stats(struct lcd_stats *st);
+void lcd_stats_reset(void);
+
+#endif
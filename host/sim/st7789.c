@@ -0,0 +1,456 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ST7789 display on USART1 as wired up on the badge.
+ *
+ * Bytes are latched with the level of D/CX when the
+ * firmware waits for the usart, which is where the real
+ * controller sees the 8th bit of each byte. Shifting the
+ * bits out costs simulated time like on the real thing.
+ * RAMRD reads back what was written as 18 bit pixels.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+#include "geckonator/gpio.h"
+#include "geckonator/usart1.h"
+
+#include "speed.h"
+#include "sim.h"
+
+#define DP_BLK GPIO_PA1
+#define DP_DC  GPIO_PA2
+
+#define LCD_COLS 240
+#define LCD_ROWS 320
+#define LCD_SIZE 240
+
+#define MADCTL_MY 0x80
+#define MADCTL_MX 0x40
+#define MADCTL_MV 0x20
+
+static struct {
+	uint8_t mem[LCD_ROWS][LCD_COLS][3];
+	uint8_t cmd;
+	uint8_t param[4];
+	unsigned int nparam;
+	uint16_t xs, xe, ys, ye;
+	uint16_t x, y;
+	uint8_t colmod;
+	uint8_t madctl;
+	uint16_t vsa;
+	bool inverted;
+	bool on;
+	bool awake;
+	/* bits of a 444 pixel pair not yet complete */
+	uint32_t acc;
+	unsigned int accbits;
+	/* byte of the pixel RAMRD sends next */
+	unsigned int rdbyte;
+} lcd;
+
+static uint8_t fifo[2];
+static unsigned int fifo_len;
+static unsigned int frame_bits = 8;
+static uint8_t rx[4];
+static unsigned int rx_head;
+static unsigned int rx_tail;
+static uint32_t clockdiv;
+static struct lcd_stats stats;
+
+void
+lcd_reset(void)
+{
+	lcd.cmd = 0x00;
+	lcd.nparam = 0;
+	lcd.xs = lcd.ys = 0;
+	lcd.xe = LCD_COLS - 1;
+	lcd.ye = LCD_ROWS - 1;
+	lcd.colmod = 0x06;
+	lcd.madctl = 0;
+	lcd.vsa = 0;
+	lcd.inverted = false;
+	lcd.on = false;
+	lcd.awake = false;
+}
+
+/* the memory at the current position, or NULL if outside */
+static uint8_t *
+lcd_at(void)
+{
+	unsigned int col = lcd.x;
+	unsigned int row = lcd.y;
+
+	if (lcd.madctl & MADCTL_MV) {
+		col = lcd.y;
+		row = lcd.x;
+	}
+	if (lcd.madctl & MADCTL_MX)
+		col = LCD_COLS - 1 - col;
+	if (lcd.madctl & MADCTL_MY)
+		row = LCD_ROWS - 1 - row;
+
+	if (col < LCD_COLS && row < LCD_ROWS)
+		return lcd.mem[row][col];
+	return NULL;
+}
+
+static void
+lcd_next(void)
+{
+	if (lcd.x < lcd.xe) {
+		lcd.x += 1;
+		return;
+	}
+	lcd.x = lcd.xs;
+	lcd.y = (lcd.y < lcd.ye) ? lcd.y + 1 : lcd.ys;
+}
+
+static void
+lcd_pixel(uint8_t r, uint8_t g, uint8_t b)
+{
+	uint8_t *p = lcd_at();
+
+	if (p) {
+		p[0] = r;
+		p[1] = g;
+		p[2] = b;
+	}
+	lcd_next();
+}
+
+/* every byte clocked after RAMRD shifts out a colour */
+static void
+lcd_ramrd(void)
+{
+	const uint8_t *p = lcd_at();
+
+	rx[rx_head++ % ARRAY_SIZE(rx)] = p ? p[lcd.rdbyte] & 0xFC : 0x00;
+	if (++lcd.rdbyte < 3)
+		return;
+	lcd.rdbyte = 0;
+	lcd_next();
+}
+
+static void
+lcd_ramwr(uint8_t c)
+{
+	lcd.acc = (lcd.acc << 8) | c;
+	lcd.accbits += 8;
+
+	switch (lcd.colmod & 0x07) {
+	case 0x03: /* 12 bit */
+		while (lcd.accbits >= 12) {
+			uint32_t v = lcd.acc >> (lcd.accbits - 12);
+
+			lcd.accbits -= 12;
+			lcd_pixel(((v >> 8) & 0xF) * 0x11,
+					((v >> 4) & 0xF) * 0x11,
+					(v & 0xF) * 0x11);
+		}
+		break;
+	case 0x05: /* 16 bit */
+		if (lcd.accbits == 16) {
+			uint32_t v = lcd.acc & 0xFFFF;
+
+			lcd.accbits = 0;
+			lcd_pixel(((v >> 11) & 0x1F) * 255 / 31,
+					((v >> 5) & 0x3F) * 255 / 63,
+					(v & 0x1F) * 255 / 31);
+		}
+		break;
+	default: /* 18 bit */
+		if (lcd.accbits == 24) {
+			uint32_t v = lcd.acc & 0xFFFFFF;
+
+			lcd.accbits = 0;
+			lcd_pixel((v >> 16) & 0xFC, (v >> 8) & 0xFC, v & 0xFC);
+		}
+		break;
+	}
+	lcd.acc &= 0xFFFFFF;
+}
+
+static void
+lcd_command(uint8_t c)
+{
+	lcd.cmd = c;
+	lcd.nparam = 0;
+
+	switch (c) {
+	case 0x01: /* SWRESET */
+		lcd_reset();
+		break;
+	case 0x10: /* SLPIN */
+		lcd.awake = false;
+		break;
+	case 0x11: /* SLPOUT */
+		lcd.awake = true;
+		break;
+	case 0x20: /* INVOFF */
+		lcd.inverted = false;
+		break;
+	case 0x21: /* INVON */
+		lcd.inverted = true;
+		break;
+	case 0x28: /* DISPOFF */
+		lcd.on = false;
+		break;
+	case 0x29: /* DISPON */
+		lcd.on = true;
+		break;
+	case 0x2C: /* RAMWR */
+		lcd.x = lcd.xs;
+		lcd.y = lcd.ys;
+		lcd.acc = 0;
+		lcd.accbits = 0;
+		break;
+	case 0x2E: /* RAMRD */
+		lcd.x = lcd.xs;
+		lcd.y = lcd.ys;
+		lcd.rdbyte = 0;
+		rx_head = rx_tail = 0;
+		break;
+	}
+}
+
+static void
+lcd_data(uint8_t c)
+{
+	if (lcd.cmd == 0x2C) {
+		lcd_ramwr(c);
+		return;
+	}
+	if (lcd.cmd == 0x2E) {
+		lcd_ramrd();
+		return;
+	}
+	if (lcd.nparam < ARRAY_SIZE(lcd.param))
+		lcd.param[lcd.nparam] = c;
+	lcd.nparam += 1;
+
+	switch (lcd.cmd) {
+	case 0x2A: /* CASET */
+		if (lcd.nparam == 4) {
+			lcd.xs = lcd.param[0] << 8 | lcd.param[1];
+			lcd.xe = lcd.param[2] << 8 | lcd.param[3];
+		}
+		break;
+	case 0x2B: /* RASET */
+		if (lcd.nparam == 4) {
+			lcd.ys = lcd.param[0] << 8 | lcd.param[1];
+			lcd.ye = lcd.param[2] << 8 | lcd.param[3];
+		}
+		break;
+	case 0x36: /* MADCTL */
+		lcd.madctl = c;
+		break;
+	case 0x37: /* VSCRSADD */
+		if (lcd.nparam == 2)
+			lcd.vsa = (lcd.param[0] << 8 | lcd.param[1]) % LCD_ROWS;
+		break;
+	case 0x3A: /* COLMOD */
+		lcd.colmod = c;
+		break;
+	}
+}
+
+/* shift out what the firmware has written so far */
+static void
+lcd_flush(void)
+{
+	uint64_t ns = 8ULL * 2 * (256 + clockdiv) * 1000 / 256 / (CORE_HZ / 1000000U);
+	bool data = sim_gpio_out(DP_DC);
+	unsigned int i;
+
+	for (i = 0; i < fifo_len; i++) {
+		if (data) {
+			lcd_data(fifo[i]);
+			stats.data_bytes += 1;
+		} else {
+			lcd_command(fifo[i]);
+			stats.cmd_bytes += 1;
+		}
+	}
+	i = fifo_len;
+	fifo_len = 0;
+	stats.ns += i * ns;
+	sim_advance(i * ns);
+}
+
+void
+lcd_dc(void)
+{
+	stats.dc_toggles += 1;
+}
+
+void
+lcd_stats(struct lcd_stats *st)
+{
+	*st = stats;
+}
+
+void
+lcd_stats_reset(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+/*
+ * The panel is mounted upside down, so what a person
+ * holding the badge sees is the panel turned 180 degrees.
+ */
+/* pixel x, y as the panel shows it */
+static void
+lcd_shown(uint8_t px[3], unsigned int x, unsigned int y)
+{
+	unsigned int row = (lcd.vsa + LCD_SIZE - 1 - y) % LCD_ROWS;
+	const uint8_t *p = lcd.mem[row][LCD_SIZE - 1 - x];
+	unsigned int i;
+
+	for (i = 0; i < 3; i++)
+		px[i] = lcd.inverted ? p[i] : 255 - p[i];
+}
+
+static bool
+lcd_lit(void)
+{
+	return sim_gpio_out(DP_BLK) && lcd.on && lcd.awake;
+}
+
+int
+lcd_screenshot(const char *path)
+{
+	bool lit = lcd_lit();
+	FILE *f = fopen(path, "wb");
+	unsigned int x, y;
+
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	fprintf(f, "P6\n%u %u\n255\n", LCD_SIZE, LCD_SIZE);
+	for (y = 0; y < LCD_SIZE; y++) {
+		for (x = 0; x < LCD_SIZE; x++) {
+			uint8_t px[3] = { 0, 0, 0 };
+
+			if (lit)
+				lcd_shown(px, x, y);
+			fwrite(px, 1, 3, f);
+		}
+	}
+	return fclose(f);
+}
+
+/* FNV-1a over the pixels lcd_screenshot() would write */
+uint32_t
+lcd_hash(void)
+{
+	bool lit = lcd_lit();
+	uint32_t h = 2166136261U;
+	unsigned int x, y, i;
+
+	for (y = 0; y < LCD_SIZE; y++) {
+		for (x = 0; x < LCD_SIZE; x++) {
+			uint8_t px[3] = { 0, 0, 0 };
+
+			if (lit)
+				lcd_shown(px, x, y);
+			for (i = 0; i < 3; i++)
+				h = (h ^ px[i]) * 16777619U;
+		}
+	}
+	return h;
+}
+
+void usart1_config(uint32_t ctrl) { (void)ctrl; }
+void usart1_irda_config(uint32_t irctrl) { (void)irctrl; }
+void usart1_frame_8n1(void) { }
+void usart1_frame_bits(unsigned int bits) { lcd_flush(); frame_bits = bits; }
+void usart1_master_enable(void) { }
+void usart1_master_disable(void) { }
+void usart1_tx_enable(void) { }
+void usart1_rx_enable(void) { }
+void usart1_rx_disable(void) { }
+void usart1_tx_tristate_disable(void) { }
+void usart1_pins(uint32_t route) { (void)route; }
+
+void
+usart1_clock_div(uint32_t div)
+{
+	lcd_flush();
+	clockdiv = div;
+}
+
+void
+usart1_rxtx_disable(void)
+{
+	lcd_flush();
+}
+
+uint32_t
+usart1_tx_buffer_level(void)
+{
+	lcd_flush();
+	return 1;
+}
+
+uint32_t
+usart1_tx_complete(void)
+{
+	lcd_flush();
+	return 1;
+}
+
+void
+usart1_txdata(uint32_t data)
+{
+	if (fifo_len == ARRAY_SIZE(fifo))
+		lcd_flush();
+	/* the 9th bit of a read command is the dummy clock */
+	if (frame_bits == 9)
+		data >>= 1;
+	fifo[fifo_len++] = data;
+}
+
+void
+usart1_txdatax(uint32_t data)
+{
+	usart1_txdata(data);
+}
+
+uint32_t usart1_rx_valid(void) { lcd_flush(); return 1; }
+
+/* only RAMRD is simulated, everything else reads 0 */
+uint8_t
+usart1_rxdata(void)
+{
+	if (rx_tail == rx_head)
+		return 0x00;
+	return rx[rx_tail++ % ARRAY_SIZE(rx)];
+}
+
+uint32_t usart1_flags(void) { return 0; }
+void usart1_flag_rx_overflow_clear(void) { }
+void usart1_flag_rx_overflow_enable(void) { }
+void usart1_flag_rx_overflow_disable(void) { }
+void usart1_flag_rx_valid_enable(void) { }
+void usart1_flag_rx_valid_disable(void) { }
@@ -0,0 +1,426 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Worst case stack depth from the call graphs gcc writes
+ * with -fcallgraph-info=su, which is what STACKUSAGE=1
+ * turns on in the firmware build.
+ *
+ *   ./stackreport [-r function]... file.ci...
+ *
+ * Without -r every function nobody calls is a root, which
+ * includes the menu callbacks since menu() only calls them
+ * through a pointer. The deepest chain below each root is
+ * printed with the frame of every function on it.
+ *
+ * The total at the end is main, plus the deepest other
+ * root for whatever menu() runs, plus every interrupt
+ * handler nested on top with the 32 bytes the core pushes
+ * on exception entry.
+ *
+ * The depth is only as good as the call graph. Chains
+ * are marked with
+ *   i  an indirect call, counted as nothing
+ *   r  recursion, counted once
+ *   d  a dynamically sized frame
+ *   ?  a function without stack usage, like libc
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXCEPTION_FRAME 32
+
+enum {
+	F_INDIRECT  = 1 << 0,
+	F_RECURSION = 1 << 1,
+	F_DYNAMIC   = 1 << 2,
+	F_UNKNOWN   = 1 << 3,
+};
+
+enum state {
+	NEW,
+	VISITING,
+	DONE,
+};
+
+struct func {
+	char *title;
+	char *name;
+	char *where;
+	unsigned long frame;
+	unsigned int flags;  /* of the function itself */
+	bool called;
+	bool root;
+
+	/* worst chain from here */
+	enum state state;
+	unsigned long depth;
+	unsigned int chain_flags;
+	struct func *next;
+};
+
+struct edge {
+	char *from_title;
+	char *to_title;
+	unsigned int from;
+	unsigned int to;
+};
+
+static struct func *funcs;
+static unsigned int nfuncs;
+static struct edge *edges;
+static unsigned int nedges;
+
+static char *
+slurp(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	char *buf;
+	long size;
+
+	if (f == NULL) {
+		perror(path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	buf = malloc(size + 1);
+	if (buf == NULL || fread(buf, 1, size, f) != (size_t)size) {
+		fprintf(stderr, "%s: read failed\n", path);
+		fclose(f);
+		free(buf);
+		return NULL;
+	}
+	fclose(f);
+	buf[size] = '\0';
+	return buf;
+}
+
+/* the quoted string after key, with \n kept as a backslash and an n */
+static char *
+field(const char *line, const char *key)
+{
+	const char *p = strstr(line, key);
+	const char *end;
+	char *ret;
+
+	if (p == NULL)
+		return NULL;
+	p += strlen(key);
+	while (*p == ' ')
+		p++;
+	if (*p++ != '"')
+		return NULL;
+	for (end = p; *end && *end != '"'; end++) {
+		if (*end == '\\' && end[1])
+			end++;
+	}
+	ret = malloc(end - p + 1);
+	if (ret == NULL)
+		return NULL;
+	memcpy(ret, p, end - p);
+	ret[end - p] = '\0';
+	return ret;
+}
+
+static struct func *
+add_func(const char *title)
+{
+	struct func *f;
+	unsigned int i;
+
+	for (i = 0; i < nfuncs; i++) {
+		if (strcmp(funcs[i].title, title) == 0)
+			return &funcs[i];
+	}
+	funcs = realloc(funcs, (nfuncs + 1) * sizeof(*funcs));
+	if (funcs == NULL) {
+		perror("realloc");
+		exit(EXIT_FAILURE);
+	}
+	f = &funcs[nfuncs++];
+	memset(f, 0, sizeof(*f));
+	f->title = strdup(title);
+	f->name = f->title;
+	f->where = "";
+	f->flags = F_UNKNOWN;
+	return f;
+}
+
+/*
+ * The label is "name\nfile:line:col\nN bytes (static)" for
+ * functions compiled with stack usage, and shorter for
+ * everything they call outside their own file.
+ */
+static void
+parse_node(char *line)
+{
+	char *title = field(line, "title:");
+	char *label = field(line, "label:");
+	char *where, *usage;
+	struct func *f;
+
+	if (title == NULL || label == NULL) {
+		free(title);
+		free(label);
+		return;
+	}
+	f = add_func(title);
+	free(title);
+
+	where = strstr(label, "\\n");
+	if (where == NULL) {
+		free(label);
+		return;
+	}
+	*where = '\0';
+	where += 2;
+	usage = strstr(where, "\\n");
+	if (usage == NULL) {
+		if (f->flags & F_UNKNOWN) {
+			f->name = label;
+			f->where = where;
+		}
+		return;
+	}
+	*usage = '\0';
+	usage += 2;
+
+	f->name = label;
+	f->where = where;
+	f->frame = strtoul(usage, NULL, 10);
+	f->flags = strstr(usage, "dynamic") ? F_DYNAMIC : 0;
+}
+
+static void
+parse_edge(char *line)
+{
+	char *from = field(line, "sourcename:");
+	char *to = field(line, "targetname:");
+
+	if (from == NULL || to == NULL) {
+		free(from);
+		free(to);
+		return;
+	}
+	edges = realloc(edges, (nedges + 1) * sizeof(*edges));
+	if (edges == NULL) {
+		perror("realloc");
+		exit(EXIT_FAILURE);
+	}
+	/* resolved once every file is in, funcs moves as it grows */
+	edges[nedges].from_title = from;
+	edges[nedges].to_title = to;
+	nedges += 1;
+}
+
+static int
+load(const char *path)
+{
+	char *buf = slurp(path);
+	char *line;
+
+	if (buf == NULL)
+		return -1;
+	for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+		if (strncmp(line, "node:", 5) == 0)
+			parse_node(line);
+		else if (strncmp(line, "edge:", 5) == 0)
+			parse_edge(line);
+	}
+	free(buf);
+	return 0;
+}
+
+static void
+resolve_edges(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nedges; i++) {
+		struct edge *e = &edges[i];
+
+		e->from = add_func(e->from_title) - funcs;
+		e->to = add_func(e->to_title) - funcs;
+	}
+	for (i = 0; i < nedges; i++)
+		funcs[edges[i].to].called = true;
+}
+
+static void
+walk(struct func *f)
+{
+	unsigned int i;
+
+	if (f->state == DONE)
+		return;
+	f->state = VISITING;
+	f->depth = 0;
+	f->chain_flags = 0;
+	f->next = NULL;
+
+	if (strcmp(f->title, "__indirect_call") == 0)
+		f->flags = F_INDIRECT;
+
+	for (i = 0; i < nedges; i++) {
+		struct func *t = &funcs[edges[i].to];
+
+		if (&funcs[edges[i].from] != f)
+			continue;
+		if (t->state == VISITING) {
+			f->chain_flags |= F_RECURSION;
+			continue;
+		}
+		walk(t);
+		f->chain_flags |= t->chain_flags;
+		if (t->depth > f->depth || f->next == NULL) {
+			f->depth = t->depth;
+			f->next = t;
+		}
+	}
+	f->depth += f->frame;
+	f->chain_flags |= f->flags;
+	f->state = DONE;
+}
+
+static bool
+is_handler(const struct func *f)
+{
+	size_t len = strlen(f->name);
+
+	return len > 8 && strcmp(f->name + len - 8, "_Handler") == 0;
+}
+
+static void
+flags_str(char *buf, unsigned int flags)
+{
+	buf[0] = (flags & F_INDIRECT)  ? 'i' : ' ';
+	buf[1] = (flags & F_RECURSION) ? 'r' : ' ';
+	buf[2] = (flags & F_DYNAMIC)   ? 'd' : ' ';
+	buf[3] = (flags & F_UNKNOWN)   ? '?' : ' ';
+	buf[4] = '\0';
+}
+
+static void
+print_chain(const struct func *f)
+{
+	char flags[5];
+
+	flags_str(flags, f->chain_flags);
+	printf("%7lu %s %s\n", f->depth, flags, f->name);
+	for (; f; f = f->next) {
+		flags_str(flags, f->flags);
+		printf("        %5lu %s   %s %s\n", f->frame, flags, f->name, f->where);
+	}
+}
+
+static int
+deeper(const void *a, const void *b)
+{
+	const struct func *x = *(const struct func *const *)a;
+	const struct func *y = *(const struct func *const *)b;
+
+	return (x->depth < y->depth) - (x->depth > y->depth);
+}
+
+static void __attribute__((noreturn))
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-r function]... file.ci...\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char **roots = NULL;
+	unsigned int nroots = 0;
+	struct func **order;
+	unsigned long thread = 0;
+	unsigned long callbacks = 0;
+	unsigned long handlers = 0;
+	unsigned int i;
+	int arg = 1;
+
+	while (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+		roots = realloc(roots, (nroots + 1) * sizeof(*roots));
+		if (roots == NULL)
+			return EXIT_FAILURE;
+		roots[nroots++] = argv[arg + 1];
+		arg += 2;
+	}
+	if (arg >= argc)
+		usage(argv[0]);
+
+	for (; arg < argc; arg++) {
+		if (load(argv[arg]))
+			return EXIT_FAILURE;
+	}
+	resolve_edges();
+
+	for (i = 0; i < nfuncs; i++) {
+		struct func *f = &funcs[i];
+		unsigned int j;
+
+		if (nroots == 0) {
+			f->root = !f->called && !(f->flags & F_UNKNOWN);
+			continue;
+		}
+		for (j = 0; j < nroots; j++) {
+			if (strcmp(f->name, roots[j]) == 0
+					|| strcmp(f->title, roots[j]) == 0)
+				f->root = true;
+		}
+	}
+
+	order = malloc(nfuncs * sizeof(*order));
+	if (order == NULL)
+		return EXIT_FAILURE;
+	for (i = 0; i < nfuncs; i++) {
+		walk(&funcs[i]);
+		order[i] = &funcs[i];
+	}
+	qsort(order, nfuncs, sizeof(*order), deeper);
+
+	printf("  bytes flag function\n");
+	for (i = 0; i < nfuncs; i++) {
+		if (!order[i]->root || is_handler(order[i]))
+			continue;
+		print_chain(order[i]);
+		if (strcmp(order[i]->name, "main") == 0)
+			thread = order[i]->depth;
+		else if (order[i]->depth > callbacks)
+			callbacks = order[i]->depth;
+	}
+	printf("\ninterrupts\n");
+	for (i = 0; i < nfuncs; i++) {
+		if (!order[i]->root || !is_handler(order[i]))
+			continue;
+		print_chain(order[i]);
+		handlers += order[i]->depth + EXCEPTION_FRAME;
+	}
+
+	printf("\nmain %lu + callbacks %lu + interrupts %lu = %lu bytes\n",
+			thread, callbacks, handlers,
+			thread + callbacks + handlers);
+	return EXIT_SUCCESS;
+}
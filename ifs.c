@@ -0,0 +1,197 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "lzss.h"
+#include "ifs.h"
+
+#define STORED 0x8000U
+
+enum {
+	RX_HEADER,
+	RX_BLOCK,
+	RX_DATA,
+	RX_END,
+};
+
+static void
+put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static uint16_t
+get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static void
+put32(uint8_t *p, uint32_t v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+static uint32_t
+get32(const uint8_t *p)
+{
+	return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+size_t
+ifs_header(uint8_t *out, uint32_t size, const char *name)
+{
+	memset(out, 0, IFS_HEADER);
+	out[0] = 'I';
+	out[1] = 'F';
+	put32(&out[2], size);
+	strncpy((char *)&out[6], name, IFS_NAME - 1);
+	return IFS_HEADER;
+}
+
+size_t
+ifs_block(uint8_t *out, const uint8_t *raw, size_t len)
+{
+	size_t clen = (len > 0) ? lzss_compress(&out[4], raw, len) : 0;
+
+	put16(&out[0], len);
+	if (len > 0 && clen >= len) {
+		memcpy(&out[4], raw, len);
+		clen = len;
+		put16(&out[2], clen | STORED);
+	} else
+		put16(&out[2], clen);
+	return 4 + clen;
+}
+
+void
+ifs_rx_init(struct ifs_rx *r)
+{
+	r->state = RX_HEADER;
+	r->hlen = 0;
+	r->step = IFS_MORE;
+}
+
+static bool
+ifs_rx_header(struct ifs_rx *r)
+{
+	char name[IFS_NAME];
+
+	if (r->hdr[0] != 'I' || r->hdr[1] != 'F')
+		return false;
+	ifs_rx_name(r, name);
+	if (name[0] == '\0' || strchr(name, '/') != NULL)
+		return false;
+	r->size = get32(&r->hdr[2]);
+	return true;
+}
+
+void
+ifs_rx_feed(struct ifs_rx *r, const uint8_t *buf, size_t len)
+{
+	const uint8_t *end = buf + len;
+
+	for (; buf < end; buf++) {
+		uint16_t clen;
+
+		/* the sender waits for every step to be done */
+		if (r->step != IFS_MORE) {
+			r->step = IFS_BAD;
+			return;
+		}
+
+		switch (r->state) {
+		case RX_HEADER:
+			r->hdr[r->hlen++] = *buf;
+			if (r->hlen < IFS_HEADER)
+				break;
+			r->hlen = 0;
+			if (!ifs_rx_header(r)) {
+				r->step = IFS_BAD;
+				return;
+			}
+			r->step = IFS_OPEN;
+			r->state = RX_BLOCK;
+			break;
+		case RX_BLOCK:
+			r->hdr[r->hlen++] = *buf;
+			if (r->hlen < 4)
+				break;
+			r->hlen = 0;
+			r->raw = get16(&r->hdr[0]);
+			clen = get16(&r->hdr[2]);
+			r->stored = clen & STORED;
+			r->clen = clen & ~STORED;
+			r->got = 0;
+			if (r->raw > LZSS_BLOCK || r->clen > LZSS_BOUND(LZSS_BLOCK)
+					|| (r->stored && r->clen != r->raw)) {
+				r->step = IFS_BAD;
+				return;
+			}
+			if (r->raw == 0) {
+				r->step = IFS_CLOSE;
+				r->state = RX_END;
+				break;
+			}
+			lzss_dec_init(&r->dec, r->block, r->raw);
+			r->state = RX_DATA;
+			break;
+		case RX_DATA:
+			if (r->stored)
+				r->block[r->got] = *buf;
+			else if (lzss_dec_feed(&r->dec, *buf)) {
+				r->step = IFS_BAD;
+				return;
+			}
+			if (++r->got < r->clen)
+				break;
+			if (!r->stored && r->dec.pos != r->raw) {
+				r->step = IFS_BAD;
+				return;
+			}
+			r->step = IFS_WRITE;
+			r->state = RX_BLOCK;
+			break;
+		default:
+			r->step = IFS_BAD;
+			return;
+		}
+	}
+}
+
+/* the name in the header, while at IFS_OPEN */
+void
+ifs_rx_name(const struct ifs_rx *r, char name[IFS_NAME])
+{
+	memcpy(name, &r->hdr[6], IFS_NAME);
+	name[IFS_NAME - 1] = '\0';
+}
+
+/* the step has been dealt with, go on */
+void
+ifs_rx_done(struct ifs_rx *r)
+{
+	if (r->step != IFS_BAD)
+		r->step = IFS_MORE;
+}
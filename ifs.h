@@ -0,0 +1,88 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IFS_H
+#define _IFS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lzss.h"
+
+/*
+ * The stream irfile.c sends a file as. The file goes
+ * out in blocks of LZSS_BLOCK bytes, each compressed
+ * on its own:
+ *
+ *   'I' 'F' SIZE:4 NAME:13   header
+ *   RAW:2 CLEN:2 data[CLEN]  for every block
+ *   0 0 0 0                  end
+ *
+ * with the top bit of CLEN set for blocks stored as is.
+ *
+ * The receiver stops at every step, the header, each
+ * block and the end, until ifs_rx_done() says it has
+ * been dealt with. The sender waits for an ack after
+ * each, so bytes arriving before that are bad data.
+ * This file doesn't touch any hardware, so it builds
+ * on the host too.
+ */
+#define IFS_HEADER 19
+#define IFS_NAME   13
+#define IFS_BLOCK  (4 + LZSS_BOUND(LZSS_BLOCK))
+
+enum ifs_step {
+	IFS_MORE,  /* waiting for bytes */
+	IFS_OPEN,  /* header in, see ifs_rx_name() and size */
+	IFS_WRITE, /* raw bytes of the file in block */
+	IFS_CLOSE, /* end of the file */
+	IFS_BAD,
+};
+
+struct ifs_rx {
+	uint8_t state;
+	uint8_t hlen;
+	uint8_t step;
+	bool stored;
+	uint8_t hdr[IFS_HEADER];
+	uint32_t size;
+	uint16_t raw;
+	uint16_t clen;
+	uint16_t got;
+	struct lzss_dec dec;
+	uint8_t block[LZSS_BLOCK];
+};
+
+/* out must have room for IFS_HEADER and IFS_BLOCK bytes */
+size_t ifs_header(uint8_t *out, uint32_t size, const char *name);
+/* len 0 makes the end marker */
+size_t ifs_block(uint8_t *out, const uint8_t *raw, size_t len);
+
+void ifs_rx_init(struct ifs_rx *r);
+void ifs_rx_feed(struct ifs_rx *r, const uint8_t *buf, size_t len);
+void ifs_rx_name(const struct ifs_rx *r, char name[IFS_NAME]);
+void ifs_rx_done(struct ifs_rx *r);
+
+static inline enum ifs_step
+ifs_rx_step(const struct ifs_rx *r)
+{
+	return r->step;
+}
+
+#endif
@@ -19,6 +19,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "events.h"
+#include "bus.h"
+#include "speed.h"
+#include "latency.h"
 #include "ir.h"
 
 #include "geckonator/clock.h"
@@ -28,53 +32,234 @@
 #define IR_RX GPIO_PE11
 #define IR_TX GPIO_PE10
 
-#define IR_CLOCKDIV 319744 /* 24MHz / (16 * (1 + 319744/256)) = 1200Hz */
-
 /*
- * 24MHz / (2 * (1 + x/256)) = 9600Hz
- * 24MHz = 9600Hz * 2 * (1 + x/256)
- * 24MHz / (2 * 9600Hz) = 1 + x/256
- * (24MHz / 19200Hz - 1) * 256 = x
+ * 24MHz / (16 * (1 + x/256)) = baud
+ * 24MHz / (16 * baud) = 1 + x/256
+ * (24MHz / (16 * baud) - 1) * 256 = x
+ * 16 * 24MHz / baud - 256 = x
+ *
+ * eg. 1200 baud gives 319744
  */
+#define IR_CLOCKDIV(baud) (16U * CORE_HZ / (baud) - 256U)
+
+#define IR_RXBUF 64 /* must be a power of 2 */
+
+static const uint32_t ir_bauds[IR_RATES] = {
+	[IR_1200]   =   1200,
+	[IR_9600]   =   9600,
+	[IR_19200]  =  19200,
+	[IR_38400]  =  38400,
+	[IR_57600]  =  57600,
+	[IR_115200] = 115200,
+};
+
+static uint8_t ir_rxbuf[IR_RXBUF];
+static volatile unsigned int ir_rxhead;
+static volatile unsigned int ir_rxtail;
+static struct ir_stats ir_st;
+
+static enum ir_rate ir_cur = IR_1200;
+static bool ir_txbusy;
 
-#if 1
-#include <stdio.h>
-#define debug(...) printf(__VA_ARGS__)
-#else
-#define debug(...)
-#endif
+static unsigned int
+ir_rx_drain(void)
+{
+	unsigned int tail = ir_rxtail;
+	unsigned int n = 0;
+
+	if (usart0_flag_rx_overflow(usart0_flags())) {
+		usart0_flag_rx_overflow_clear();
+		ir_st.rx_overflow += 1;
+	}
+
+	while (usart0_rx_valid()) {
+		uint8_t c = usart0_rxdata();
+
+		if (tail - ir_rxhead == IR_RXBUF) {
+			ir_st.rx_dropped += 1;
+			continue;
+		}
+		ir_rxbuf[tail % IR_RXBUF] = c;
+		tail += 1;
+		n += 1;
+	}
+	ir_rxtail = tail;
+	ir_st.rx_bytes += n;
+	return n;
+}
 
+/*
+ * Empty the usart into the ring buffer as soon as
+ * bytes arrive, so nothing is lost while the app is
+ * busy redrawing the screen. The app is told with a
+ * single coalesced EV_IR_RX event.
+ */
 void
-ir_init(void)
+USART0_RX_IRQHandler(void)
 {
-	gpio_clear(IR_RX);
-	gpio_clear(IR_TX);
-	gpio_mode(IR_RX, GPIO_MODE_INPUT);
-	gpio_mode(IR_TX, GPIO_MODE_PUSHPULL);
+	unsigned int n = ir_rx_drain();
+
+	if (n > 0)
+		event_post(EV_IR_RX, n, EVENT_COALESCE);
+}
 
-	clock_usart0_enable();
+/*
+ * While the SD card has the usart, TIMER1 counts
+ * light pulses on IR_RX through CC1 at location 1,
+ * like cirrx.c captures them. Every byte starts with
+ * at least one, so a count above 0 means bytes were
+ * lost, and it is never less than how many.
+ */
+static void
+ir_watch_start(void)
+{
+	TIMER1->CTRL = TIMER_CTRL_CLKSEL_CC1 | TIMER_CTRL_MODE_UP;
+	TIMER1->TOP = 0xFFFF;
+	TIMER1->CNT = 0;
+	TIMER1->CC[1].CTRL = TIMER_CC_CTRL_MODE_INPUTCAPTURE
+		| TIMER_CC_CTRL_ICEDGE_RISING
+		| TIMER_CC_CTRL_FILT_ENABLE;
+	TIMER1->ROUTE = TIMER_ROUTE_LOCATION_LOC1 | TIMER_ROUTE_CC1PEN;
+	TIMER1->CMD = TIMER_CMD_START;
+}
+
+static uint32_t
+ir_watch_stop(void)
+{
+	TIMER1->CMD = TIMER_CMD_STOP;
+	TIMER1->ROUTE = 0;
+	TIMER1->CC[1].CTRL = 0;
+	return TIMER1->CNT;
+}
+
+static void
+ir_config(void)
+{
+	if (ir_cur == IR_1200) {
+		usart0_irda_config(0);
+		usart0_config(USART_CTRL_TXINV | USART_CTRL_RXINV);
+	} else {
+		/* the modulator idles low and sends a 3/16 bit
+		 * wide high pulse for every 0, which is what the
+		 * led driver wants, so only the receiver needs
+		 * inverting like in plain uart mode */
+		usart0_config(USART_CTRL_RXINV);
+		usart0_irda_config(USART_IRCTRL_IREN
+				| USART_IRCTRL_IRPW_THREE
+				| USART_IRCTRL_IRFILT);
+	}
+	usart0_frame_8n1();
+	usart0_clock_div(IR_CLOCKDIV(ir_bauds[ir_cur]));
+}
+
+static void
+ir_attach(void)
+{
+	uint32_t missed = ir_watch_stop();
+
+	if (missed > 0)
+		bus_missed(missed);
+	ir_config();
+	usart0_master_disable();
+	usart0_tx_enable();
+	usart0_rx_enable();
 	/* location0:
 	 * rx -> PBE11 -> IR_RX
 	 * tx -> PBE10 -> IR_TX
 	 */
-	usart0_config(USART_CTRL_TXINV | USART_CTRL_RXINV);
-	usart0_frame_8n1();
-	usart0_clock_div(IR_CLOCKDIV);
-	usart0_tx_enable();
-	usart0_rx_enable();
 	usart0_pins(USART_ROUTE_LOCATION_LOC0
 			| USART_ROUTE_TXPEN
 			| USART_ROUTE_RXPEN);
+
+	usart0_flag_rx_valid_enable();
+	usart0_flag_rx_overflow_enable();
+	NVIC_EnableIRQ(USART0_RX_IRQn);
+}
+
+/*
+ * Let the last byte out and hand whatever the
+ * usart already received over to the ring buffer.
+ * Bytes sent to us while detached are lost, but
+ * counted.
+ */
+static void
+ir_detach(void)
+{
+	unsigned int n;
+
+	ir_tx_wait();
+	NVIC_DisableIRQ(USART0_RX_IRQn);
+	usart0_flag_rx_valid_disable();
+	usart0_flag_rx_overflow_disable();
+	n = ir_rx_drain();
+	usart0_rxtx_disable();
+	usart0_pins(0);
+	ir_watch_start();
+
+	if (n > 0)
+		event_post(EV_IR_RX, n, EVENT_COALESCE);
+}
+
+static const struct bus_client ir_client = {
+	.attach = ir_attach,
+	.detach = ir_detach,
+	.listen = true,
+};
+
+void
+ir_init(void)
+{
+	gpio_clear(IR_RX);
+	gpio_clear(IR_TX);
+	gpio_mode(IR_RX, GPIO_MODE_INPUT);
+	gpio_mode(IR_TX, GPIO_MODE_PUSHPULL);
+
+	ir_cur = IR_1200;
+	ir_rxhead = ir_rxtail;
+	clock_timer1_enable();
+	TIMER1->CNT = 0;
+	/* the usart only holds 2 bytes,
+	 * so don't wait behind the rtc */
+	NVIC_SetPriority(USART0_RX_IRQn, 1);
+	bus_enable(BUS_IR, &ir_client);
+	/* the baud rate must not move under the peer */
+	speed_hold();
 }
 
 void
 ir_uninit(void)
 {
-	usart0_rxtx_enable();
-	usart0_pins(0);
+	speed_release();
+	bus_disable(BUS_IR);
+	ir_watch_stop();
+	clock_timer1_disable();
 	gpio_mode(IR_RX, GPIO_MODE_DISABLED);
 	gpio_mode(IR_TX, GPIO_MODE_DISABLED);
-	clock_usart0_enable();
+}
+
+uint32_t
+ir_baud(enum ir_rate rate)
+{
+	return ir_bauds[rate];
+}
+
+/*
+ * Both ends must switch at the same time,
+ * see irlink.c for how to negotiate it.
+ */
+void
+ir_rate(enum ir_rate rate)
+{
+	ir_cur = rate;
+	if (!bus_attached(BUS_IR))
+		return;
+
+	ir_tx_wait();
+	usart0_rxtx_disable();
+	ir_config();
+	usart0_tx_enable();
+	usart0_rx_enable();
+	ir_rx_clear();
 }
 
 void
@@ -83,12 +268,43 @@ ir_send(uint8_t c)
 	while (!usart0_tx_buffer_level())
 		/* wait */;
 	usart0_txdata(c);
+	ir_txbusy = true;
+}
+
+/* TXC is only ever set after sending something */
+void
+ir_tx_wait(void)
+{
+	if (!ir_txbusy)
+		return;
+	while (!usart0_tx_complete())
+		/* wait */;
+	ir_txbusy = false;
 }
 
 int
 ir_recv(void)
 {
-	if (!usart0_rx_valid())
+	unsigned int head = ir_rxhead;
+	int ret;
+
+	if (head == ir_rxtail)
 		return -1;
-	return usart0_rxdata();
+	ret = ir_rxbuf[head % IR_RXBUF];
+	ir_rxhead = head + 1;
+	return ret;
+}
+
+void
+ir_rx_clear(void)
+{
+	ir_rxhead = ir_rxtail;
+}
+
+void
+ir_stats(struct ir_stats *st)
+{
+	irq_off();
+	*st = ir_st;
+	irq_on();
 }
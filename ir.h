@@ -21,9 +21,30 @@
 
 #include <stdint.h>
 
+struct ir_stats {
+	uint32_t rx_bytes;
+	uint32_t rx_dropped;  /* ring buffer full */
+	uint32_t rx_overflow; /* usart overflowed before the irq ran */
+};
+
+enum ir_rate {
+	IR_1200,   /* plain uart, this is what ir_init() sets up */
+	IR_9600,   /* the rest use the IrDA SIR pulse modulator */
+	IR_19200,
+	IR_38400,
+	IR_57600,
+	IR_115200,
+	IR_RATES,
+};
+
 void ir_init(void);
 void ir_uninit(void);
+void ir_rate(enum ir_rate rate);
+uint32_t ir_baud(enum ir_rate rate);
 void ir_send(uint8_t c);
+void ir_tx_wait(void);
 int ir_recv(void);
+void ir_rx_clear(void);
+void ir_stats(struct ir_stats *st);
 
 #endif
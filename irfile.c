@@ -0,0 +1,499 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "speed.h"
+#include "bus.h"
+#include "sdcard.h"
+#include "ff.h"
+#include "filepicker.h"
+#include "arena.h"
+#include "ir.h"
+#include "irpkt.h"
+#include "irlink.h"
+#include "ifs.h"
+
+/*
+ * Send files between badges over IR, as the stream
+ * described in ifs.h. The SD card borrows USART0 from IR while it's read or
+ * written, so the sender waits for every block to be acked
+ * before reading the next and the receiver writes each
+ * block once it has answered.
+ */
+
+#define FG444 0x8CF
+#define BG444 0x000
+
+#define GIVEUP_MS  10000
+#define LINGER_MS  1000
+#define PATH_LEN   255
+
+enum events {
+	EV_EXIT = 1,
+};
+
+enum result {
+	XFER_OK,
+	XFER_EXIT,
+	XFER_NOPEER,
+	XFER_LOST,
+	XFER_SDERR,
+	XFER_BADDATA,
+	XFER_NOMEM,
+};
+
+static const char *const result_str[] = {
+	[XFER_OK]      = "Done",
+	[XFER_EXIT]    = "Cancelled",
+	[XFER_NOPEER]  = "No peer found",
+	[XFER_LOST]    = "Peer lost",
+	[XFER_SDERR]   = "SD card error",
+	[XFER_BADDATA] = "Bad data",
+	[XFER_NOMEM]   = "Out of memory",
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+static struct irpkt *pkt;
+static int rate;
+static uint32_t progress;
+static uint32_t progress_time;
+
+static uint8_t txbuf[IRPKT_MTU];
+static size_t txfill;
+
+static uint32_t
+ms_since(uint32_t start)
+{
+	return (timer_now() - start) & 0xFFFFFFU;
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+/* keeps the link going, gives up when the peer goes quiet */
+static enum result
+xfer_poll(void)
+{
+	struct event ev;
+	uint32_t n;
+
+	if (event_poll(&ev) && ev.type == EV_EXIT)
+		return XFER_EXIT;
+
+	irlink_poll(pkt);
+	n = pkt->stats.acks_rcvd + pkt->stats.rx_frames;
+	if (n != progress) {
+		progress = n;
+		progress_time = timer_now();
+	} else if (ms_since(progress_time) >= GIVEUP_MS)
+		return XFER_LOST;
+	return XFER_OK;
+}
+
+static enum result
+xfer_start(irpkt_out *deliver, void *priv)
+{
+	pkt = irlink_start(rate, deliver, priv);
+	if (pkt == NULL)
+		return XFER_NOMEM;
+	progress = 0;
+	progress_time = timer_now();
+	txfill = 0;
+	return XFER_OK;
+}
+
+static enum result
+put_flush(void)
+{
+	enum result res;
+
+	if (txfill == 0)
+		return XFER_OK;
+	while (!irpkt_send(pkt, txbuf, txfill)) {
+		res = xfer_poll();
+		if (res != XFER_OK)
+			return res;
+	}
+	txfill = 0;
+	return XFER_OK;
+}
+
+static enum result
+put(const uint8_t *data, size_t len)
+{
+	while (len > 0) {
+		size_t n = IRPKT_MTU - txfill;
+		enum result res;
+
+		if (n > len)
+			n = len;
+		memcpy(&txbuf[txfill], data, n);
+		txfill += n;
+		data += n;
+		len -= n;
+		if (txfill == IRPKT_MTU) {
+			res = put_flush();
+			if (res != XFER_OK)
+				return res;
+		}
+	}
+	return XFER_OK;
+}
+
+/* send what's left and wait for all of it to be acked */
+static enum result
+put_sync(void)
+{
+	enum result res = put_flush();
+
+	while (res == XFER_OK && !irpkt_idle(pkt))
+		res = xfer_poll();
+	return res;
+}
+
+static void
+show_rate(unsigned int line, uint32_t bytes, uint32_t start)
+{
+	uint32_t ms = ms_since(start);
+	char buf[24];
+
+	if (ms == 0)
+		return;
+	sprintf(buf, "  %lu B/s", (unsigned long)(bytes * 1000 / ms));
+	show(line, buf);
+}
+
+/* nothing comes back but acks */
+static void
+send_deliver(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	(void)p;
+	(void)buf;
+	(void)len;
+}
+
+static enum result
+send_file(FIL *f, const char *name)
+{
+	uint8_t *raw = arena_alloc(LZSS_BLOCK);
+	uint8_t *out = arena_alloc(IFS_BLOCK);
+	uint32_t size = f_size(f);
+	uint32_t sent = 0;
+	uint32_t packed = 0;
+	uint32_t start;
+	char buf[24];
+	enum result res;
+
+	if (raw == NULL || out == NULL)
+		return XFER_NOMEM;
+	res = xfer_start(send_deliver, NULL);
+	if (res != XFER_OK)
+		return res;
+
+	res = put(out, ifs_header(out, size, name));
+	if (res == XFER_OK)
+		res = put_sync();
+	if (res != XFER_OK)
+		return res;
+
+	start = timer_now();
+	while (1) {
+		UINT n;
+		size_t len;
+		FRESULT fr;
+
+		fr = f_read(f, raw, LZSS_BLOCK, &n);
+		if (fr != FR_OK)
+			return XFER_SDERR;
+
+		len = ifs_block(out, raw, n);
+		res = put(out, len);
+		if (res == XFER_OK)
+			res = put_sync();
+		if (res != XFER_OK)
+			return res;
+
+		sent += n;
+		packed += len;
+		sprintf(buf, "Sent %lu/%lu B", (unsigned long)sent, (unsigned long)size);
+		show(3, buf);
+		show_rate(4, sent, start);
+		if (n == 0)
+			break;
+	}
+
+	if (sent > 0) {
+		sprintf(buf, "Packed to %lu%%", (unsigned long)(packed * 100 / sent));
+		show(5, buf);
+	}
+	sprintf(buf, "Resent %lu/%lu", (unsigned long)pkt->stats.tx_resends,
+			(unsigned long)pkt->stats.tx_frames);
+	show(6, buf);
+	return XFER_OK;
+}
+
+static void
+recv_deliver(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	ifs_rx_feed(p->priv, buf, len);
+}
+
+static enum result
+recv_file(FIL *f)
+{
+	struct ifs_rx *r = arena_alloc(sizeof(*r));
+	char name[IFS_NAME];
+	uint32_t got = 0;
+	uint32_t start = 0;
+	bool opened = false;
+	char buf[24];
+	enum result res;
+
+	if (r == NULL)
+		return XFER_NOMEM;
+	ifs_rx_init(r);
+	res = xfer_start(recv_deliver, r);
+	if (res != XFER_OK)
+		return res;
+	show(3, "Receiving..");
+	while (1) {
+		enum ifs_step step;
+		FRESULT fr = FR_OK;
+		UINT n;
+
+		res = xfer_poll();
+		if (res != XFER_OK)
+			break;
+		step = ifs_rx_step(r);
+		if (step == IFS_BAD) {
+			res = XFER_BADDATA;
+			break;
+		}
+		/* let the answer go out before we go deaf */
+		if (step == IFS_MORE || pkt->ack_due)
+			continue;
+
+		switch (step) {
+		case IFS_OPEN:
+			ifs_rx_name(r, name);
+			fr = f_open(f, name, FA_WRITE | FA_CREATE_ALWAYS);
+			opened = (fr == FR_OK);
+			start = timer_now();
+			show(2, name);
+			break;
+		case IFS_WRITE:
+			fr = f_write(f, r->block, r->raw, &n);
+			if (fr == FR_OK && n != r->raw)
+				fr = FR_DENIED;
+			got += r->raw;
+			break;
+		default:
+			fr = f_close(f);
+			opened = false;
+			break;
+		}
+		if (fr != FR_OK) {
+			res = XFER_SDERR;
+			break;
+		}
+		ifs_rx_done(r);
+
+		sprintf(buf, "Got  %lu/%lu B", (unsigned long)got, (unsigned long)r->size);
+		show(3, buf);
+		show_rate(4, got, start);
+		if (step == IFS_CLOSE)
+			break;
+	}
+
+	if (opened)
+		f_close(f);
+	if (res != XFER_OK)
+		return res;
+
+	/* answer again if our last ack got lost */
+	start = timer_now();
+	while (ms_since(start) < LINGER_MS)
+		irlink_poll(pkt);
+
+	sprintf(buf, "Dups %lu", (unsigned long)pkt->stats.rx_dups);
+	show(5, buf);
+	sprintf(buf, "Errors %lu", (unsigned long)pkt->rx.errors);
+	show(6, buf);
+	return XFER_OK;
+}
+
+static void
+show_bus(void)
+{
+	struct bus_stats st;
+	char buf[24];
+
+	bus_stats(&st);
+	if (st.timed > 0) {
+		sprintf(buf, "Bus %lu x %lu us", (unsigned long)st.switches,
+				(unsigned long)(st.cycles_total / st.timed / (CORE_HZ / 1000000U)));
+		show(7, buf);
+	}
+	/* light that came in while the card had the usart */
+	if (st.missed > 0) {
+		sprintf(buf, "Missed %lu IR pulses", (unsigned long)st.missed);
+		show(9, buf);
+	}
+}
+
+static void
+finish(enum result res)
+{
+	if (res != XFER_EXIT) {
+		show(8, result_str[res]);
+		while (event_wait() != EV_EXIT)
+			/* wait */;
+	}
+}
+
+static enum result
+connect(int (*negotiate)(uint8_t exit))
+{
+	char buf[24];
+
+	show(0, "Looking for peer");
+	ir_init();
+	rate = negotiate(EV_EXIT);
+	if (rate == IRLINK_EXIT)
+		return XFER_EXIT;
+	if (rate == IRLINK_TIMEOUT)
+		return XFER_NOPEER;
+
+	sprintf(buf, "%lu baud", (unsigned long)ir_baud(rate));
+	show(0, buf);
+	return XFER_OK;
+}
+
+static void
+irfile_send(void)
+{
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	FIL *f = arena_alloc(sizeof(*f));
+	char *path = arena_alloc(PATH_LEN);
+	const char *name;
+	enum result res;
+	FRESULT fr;
+
+	if (fs == NULL || f == NULL || path == NULL)
+		return;
+
+	sd_init();
+	path[0] = '\0';
+	fr = filepicker(fs, path, PATH_LEN, FG444, BG444);
+	if (fr == FR_OK)
+		fr = f_open(f, path, FA_READ);
+	if (fr == FR_NO_FILE)
+		goto out;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	if (fr != FR_OK) {
+		sprintf(path, "Error: %u", fr);
+		show(0, path);
+		finish(XFER_SDERR);
+		goto out;
+	}
+
+	name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+	show(2, name);
+
+	bus_stats_reset();
+	res = connect(irlink_connect);
+	if (res == XFER_OK)
+		res = send_file(f, name);
+	ir_uninit();
+	f_close(f);
+
+	show_bus();
+	finish(res);
+out:
+	sd_uninit();
+}
+
+static void
+irfile_recv(void)
+{
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	FIL *f = arena_alloc(sizeof(*f));
+	char buf[24];
+	enum result res;
+	FRESULT fr = FR_NOT_ENOUGH_CORE;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+
+	sd_init();
+	if (fs && f)
+		fr = f_mount(fs, "", 1);
+	if (fr != FR_OK) {
+		sprintf(buf, "Error: %u", fr);
+		show(0, buf);
+		finish(XFER_SDERR);
+		goto out;
+	}
+
+	bus_stats_reset();
+	res = connect(irlink_accept);
+	if (res == XFER_OK)
+		res = recv_file(f);
+	ir_uninit();
+
+	show_bus();
+	finish(res);
+out:
+	sd_uninit();
+}
+
+void
+irfile(void)
+{
+	static const struct menuitem irfile_menu[] = {
+		{ .label = "Send file",    .cb = irfile_send, },
+		{ .label = "Receive file", .cb = irfile_recv, },
+	};
+
+	menu(irfile_menu, ARRAY_SIZE(irfile_menu), FG444, BG444);
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "crc16.h"
+#include "irframe.h"
+
+enum {
+	RX_SYNC,
+	RX_LEN,
+	RX_DATA,
+	RX_CRC1,
+	RX_CRC2,
+};
+
+size_t
+irframe_encode(uint8_t *out, const uint8_t *payload, size_t len)
+{
+	uint16_t crc;
+	size_t i;
+
+	out[0] = IRFRAME_SYNC;
+	out[1] = len;
+	crc = crc16_byte(0xFFFF, len);
+	for (i = 0; i < len; i++) {
+		out[2 + i] = payload[i];
+		crc = crc16_byte(crc, payload[i]);
+	}
+	out[2 + len] = crc >> 8;
+	out[3 + len] = crc;
+	return len + IRFRAME_OVERHEAD;
+}
+
+void
+irframe_rx_init(struct irframe_rx *rx)
+{
+	rx->state = RX_SYNC;
+	rx->frames = 0;
+	rx->errors = 0;
+}
+
+/*
+ * Feed received bytes one at a time. Returns the
+ * payload length, when a good frame has been
+ * received into rx->buf, and -1 otherwise.
+ */
+int
+irframe_feed(struct irframe_rx *rx, uint8_t c)
+{
+	switch (rx->state) {
+	case RX_SYNC:
+		if (c == IRFRAME_SYNC)
+			rx->state = RX_LEN;
+		break;
+	case RX_LEN:
+		if (c > IRFRAME_MAX) {
+			rx->errors += 1;
+			rx->state = (c == IRFRAME_SYNC) ? RX_LEN : RX_SYNC;
+			break;
+		}
+		rx->len = c;
+		rx->pos = 0;
+		rx->crc = crc16_byte(0xFFFF, c);
+		rx->state = (c > 0) ? RX_DATA : RX_CRC1;
+		break;
+	case RX_DATA:
+		rx->buf[rx->pos++] = c;
+		rx->crc = crc16_byte(rx->crc, c);
+		if (rx->pos == rx->len)
+			rx->state = RX_CRC1;
+		break;
+	case RX_CRC1:
+		if (c != (rx->crc >> 8)) {
+			rx->errors += 1;
+			rx->state = (c == IRFRAME_SYNC) ? RX_LEN : RX_SYNC;
+			break;
+		}
+		rx->state = RX_CRC2;
+		break;
+	case RX_CRC2:
+		if (c != (rx->crc & 0xFF)) {
+			rx->errors += 1;
+			rx->state = (c == IRFRAME_SYNC) ? RX_LEN : RX_SYNC;
+			break;
+		}
+		rx->state = RX_SYNC;
+		rx->frames += 1;
+		return rx->len;
+	}
+	return -1;
+}
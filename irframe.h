@@ -0,0 +1,53 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IRFRAME_H
+#define _IRFRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Frames on the wire:
+ *
+ *   SYNC LEN payload[LEN] CRC_HI CRC_LO
+ *
+ * The CRC is CRC-16/CCITT of LEN and the payload,
+ * see crc16.h.
+ * This file doesn't touch any hardware,
+ * so it builds on the host too.
+ */
+#define IRFRAME_SYNC     0x7E
+#define IRFRAME_MAX      64
+#define IRFRAME_OVERHEAD 4
+
+struct irframe_rx {
+	uint8_t state;
+	uint8_t len;
+	uint8_t pos;
+	uint16_t crc;
+	uint8_t buf[IRFRAME_MAX];
+	uint32_t frames;
+	uint32_t errors;
+};
+
+size_t irframe_encode(uint8_t *out, const uint8_t *payload, size_t len);
+void irframe_rx_init(struct irframe_rx *rx);
+int irframe_feed(struct irframe_rx *rx, uint8_t c);
+
+#endif
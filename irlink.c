@@ -0,0 +1,249 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "timer.h"
+#include "events.h"
+#include "arena.h"
+#include "ir.h"
+#include "irframe.h"
+#include "irlink.h"
+
+enum msg {
+	MSG_RATE_REQ = 1, /* bit mask of supported rates */
+	MSG_RATE_ACK,     /* rate to switch to */
+	MSG_PING,
+	MSG_PONG,
+};
+
+static struct irframe_rx irlink_rx;
+
+static uint32_t
+ms_since(uint32_t start)
+{
+	return (timer_now() - start) & 0xFFFFFFU;
+}
+
+static void
+send_msg(const uint8_t *msg, size_t len)
+{
+	uint8_t buf[IRFRAME_MAX + IRFRAME_OVERHEAD];
+	size_t i;
+
+	len = irframe_encode(buf, msg, len);
+	for (i = 0; i < len; i++)
+		ir_send(buf[i]);
+	/* the transceiver hears itself, drop the echo */
+	ir_tx_wait();
+	ir_rx_clear();
+}
+
+static int
+recv_msg(uint32_t ms, uint8_t exit)
+{
+	struct irframe_rx *rx = &irlink_rx;
+	uint32_t start = timer_now();
+	struct ticker tick;
+	int ret;
+
+	ticker_start(&tick, 50, EV_IR_TICK);
+	while (1) {
+		struct event ev;
+		int ch;
+
+		while ((ch = ir_recv()) >= 0) {
+			ret = irframe_feed(rx, ch);
+			if (ret > 0)
+				goto out;
+		}
+		if (ms_since(start) >= ms) {
+			ret = IRLINK_TIMEOUT;
+			break;
+		}
+
+		event_pend(&ev);
+		if (ev.type == exit) {
+			ret = IRLINK_EXIT;
+			break;
+		}
+	}
+out:
+	ticker_stop(&tick);
+	return ret;
+}
+
+static int
+ping(uint8_t exit)
+{
+	const uint8_t msg = MSG_PING;
+	unsigned int tries;
+
+	for (tries = 3; tries > 0; tries--) {
+		int len;
+
+		send_msg(&msg, 1);
+		len = recv_msg(200, exit);
+		if (len == IRLINK_EXIT)
+			return len;
+		if (len == 1 && irlink_rx.buf[0] == MSG_PONG)
+			return 0;
+	}
+	return IRLINK_TIMEOUT;
+}
+
+int
+irlink_connect(uint8_t exit)
+{
+	const uint8_t *buf = irlink_rx.buf;
+	uint8_t msg[2];
+	unsigned int tries;
+	enum ir_rate rate;
+	int ret;
+
+	irframe_rx_init(&irlink_rx);
+	for (tries = 10; tries > 0; tries--) {
+		int len;
+
+		msg[0] = MSG_RATE_REQ;
+		msg[1] = (1U << IR_RATES) - 1;
+		send_msg(msg, 2);
+		len = recv_msg(500, exit);
+		if (len == IRLINK_EXIT)
+			return len;
+		if (len == 2 && buf[0] == MSG_RATE_ACK && buf[1] < IR_RATES)
+			break;
+	}
+	if (tries == 0)
+		return IRLINK_TIMEOUT;
+
+	rate = buf[1];
+	if (rate != IR_1200) {
+		ir_rate(rate);
+		/* give the other end time to switch */
+		timer_msleep(20);
+		ret = ping(exit);
+		if (ret != IRLINK_TIMEOUT)
+			return (ret == 0) ? (int)rate : ret;
+
+		/* wait for the other end to give up too */
+		ir_rate(IR_1200);
+		timer_msleep(1200);
+	}
+	ret = ping(exit);
+	return (ret == 0) ? IR_1200 : ret;
+}
+
+int
+irlink_accept(uint8_t exit)
+{
+	const uint8_t *buf = irlink_rx.buf;
+	enum ir_rate rate = IR_1200;
+
+	irframe_rx_init(&irlink_rx);
+	while (1) {
+		uint8_t msg[2];
+		unsigned int mask;
+		int len;
+
+		len = recv_msg(1000, exit);
+		if (len == IRLINK_EXIT)
+			return len;
+		if (len == IRLINK_TIMEOUT) {
+			if (rate != IR_1200) {
+				rate = IR_1200;
+				ir_rate(rate);
+			}
+			continue;
+		}
+
+		switch (buf[0]) {
+		case MSG_RATE_REQ:
+			if (len != 2 || rate != IR_1200)
+				break;
+			mask = buf[1] & ((1U << IR_RATES) - 1);
+			for (rate = IR_RATES - 1; rate > IR_1200; rate--) {
+				if (mask & (1U << rate))
+					break;
+			}
+			msg[0] = MSG_RATE_ACK;
+			msg[1] = rate;
+			send_msg(msg, 2);
+			ir_rate(rate);
+			break;
+		case MSG_PING:
+			msg[0] = MSG_PONG;
+			send_msg(msg, 1);
+			return rate;
+		}
+	}
+}
+
+static uint8_t
+session_id(void)
+{
+	uint32_t r = timer_cycles() ^ timer_now();
+
+	return r ^ (r >> 8) ^ (r >> 16);
+}
+
+static void
+irlink_output(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	const uint8_t *end = buf + len;
+
+	(void)p;
+	for (; buf < end; buf++)
+		ir_send(*buf);
+}
+
+/* a peer that missed our pong is still pinging */
+static void
+irlink_other(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	const uint8_t msg = MSG_PONG;
+
+	(void)p;
+	if (len == 1 && buf[0] == MSG_PING)
+		send_msg(&msg, 1);
+}
+
+struct irpkt *
+irlink_start(int rate, irpkt_out *deliver, void *priv)
+{
+	struct irpkt *p = arena_alloc(sizeof(*p));
+
+	if (p == NULL)
+		return NULL;
+	irpkt_init(p, session_id(), ir_baud(rate));
+	p->output = irlink_output;
+	p->deliver = deliver;
+	p->other = irlink_other;
+	p->priv = priv;
+	return p;
+}
+
+void
+irlink_poll(struct irpkt *p)
+{
+	int ch;
+
+	while ((ch = ir_recv()) >= 0)
+		irpkt_input(p, ch, timer_now());
+	irpkt_poll(p, timer_now());
+}
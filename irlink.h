@@ -0,0 +1,55 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IRLINK_H
+#define _IRLINK_H
+
+#include <stdint.h>
+
+#include "irpkt.h"
+
+/*
+ * Badge to badge links over ir.c.
+ *
+ * Both badges start out at 1200 baud. The connecting
+ * side asks for the rates it supports, the accepting
+ * side answers with the fastest one they have in common
+ * and both switch. If a ping at the new rate isn't
+ * answered both fall back to 1200 baud.
+ *
+ * Call ir_init() first. Both return the rate agreed on,
+ * IRLINK_TIMEOUT when nobody answers or IRLINK_EXIT
+ * when an event of type exit arrives.
+ */
+enum {
+	IRLINK_TIMEOUT = -1,
+	IRLINK_EXIT = -2,
+};
+
+int irlink_connect(uint8_t exit);
+int irlink_accept(uint8_t exit);
+
+/*
+ * Run irpkt on top of an established link. The irpkt is
+ * taken from the arena, so it's gone when the menu entry
+ * returns. NULL if the arena is full.
+ */
+struct irpkt *irlink_start(int rate, irpkt_out *deliver, void *priv);
+void irlink_poll(struct irpkt *p);
+
+#endif
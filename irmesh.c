@@ -0,0 +1,266 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "irmesh.h"
+
+/*
+ * Frames are:
+ *
+ *   IRMESH_TYPE SRC:2 ORIGIN:2 SEQ HOPS payload
+ *
+ * src is whoever sent this copy, so we can tell
+ * our own echo from someone sending it on.
+ */
+
+enum {
+	SLOT_FREE,
+	SLOT_WAITING,
+};
+
+static void
+put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static uint16_t
+get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+elapsed(uint32_t now, uint32_t then)
+{
+	return (now - then) & IRMESH_TIME_MASK;
+}
+
+/* xorshift, plenty for picking backoffs */
+static uint32_t
+irmesh_random(struct irmesh *m)
+{
+	uint32_t x = m->rand;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	m->rand = x;
+	return x;
+}
+
+/*
+ * Set output and deliver after this. Give every
+ * badge a different id, and a different seed so
+ * they don't all pick the same backoffs.
+ */
+void
+irmesh_init(struct irmesh *m, uint16_t id, uint32_t baud, uint32_t seed)
+{
+	uint32_t frame = (IRFRAME_MAX + IRFRAME_OVERHEAD) * 10000U / baud + 1;
+
+	memset(m, 0, sizeof(*m));
+	m->id = id;
+	m->rand = seed ? seed : 0x2019;
+	/* a few byte times of silence means nobody is talking */
+	m->quiet = 30000U / baud + 2;
+	/* spread the neighbours over a few frame times */
+	m->backoff = 8 * frame;
+	irframe_rx_init(&m->rx);
+}
+
+/* returns true if the message was seen already */
+static bool
+irmesh_seen(struct irmesh *m, uint16_t origin, uint8_t seq)
+{
+	uint32_t key = (uint32_t)origin << 8 | seq;
+	unsigned int i;
+
+	/* only the filled in entries, any key can be a real one */
+	for (i = 0; i < m->seen_used; i++) {
+		if (m->seen[i] == key)
+			return true;
+	}
+	m->seen[m->seen_next++ % IRMESH_SEEN] = key;
+	if (m->seen_used < IRMESH_SEEN)
+		m->seen_used += 1;
+	return false;
+}
+
+static struct irmesh_slot *
+irmesh_find(struct irmesh *m, uint16_t origin, uint8_t seq)
+{
+	unsigned int i;
+
+	for (i = 0; i < IRMESH_QUEUE; i++) {
+		struct irmesh_slot *s = &m->q[i];
+
+		if (s->state == SLOT_WAITING
+				&& get16(&s->data[3]) == origin && s->data[5] == seq)
+			return s;
+	}
+	return NULL;
+}
+
+static bool
+irmesh_queue(struct irmesh *m, const uint8_t *msg, size_t len,
+		uint32_t wait, uint32_t now)
+{
+	unsigned int i;
+
+	for (i = 0; i < IRMESH_QUEUE; i++) {
+		struct irmesh_slot *s = &m->q[i];
+
+		if (s->state != SLOT_FREE)
+			continue;
+		memcpy(s->data, msg, len);
+		put16(&s->data[1], m->id);
+		s->len = len;
+		s->heard = 0;
+		s->due = (now + wait) & IRMESH_TIME_MASK;
+		s->state = SLOT_WAITING;
+		return true;
+	}
+	m->stats.dropped += 1;
+	return false;
+}
+
+/* start a new message, it goes out from irmesh_poll() */
+bool
+irmesh_send(struct irmesh *m, const uint8_t *data, size_t len, uint32_t now)
+{
+	uint8_t msg[IRFRAME_MAX];
+
+	if (len > IRMESH_MTU)
+		len = IRMESH_MTU;
+
+	msg[0] = IRMESH_TYPE;
+	put16(&msg[3], m->id);
+	msg[5] = m->seq;
+	msg[6] = 0;
+	memcpy(&msg[IRMESH_HEADER], data, len);
+	/* badges often start talking on the same cue */
+	if (!irmesh_queue(m, msg, IRMESH_HEADER + len,
+				irmesh_random(m) % m->backoff, now))
+		return false;
+
+	irmesh_seen(m, m->id, m->seq);
+	m->seq += 1;
+	m->stats.sent += 1;
+	return true;
+}
+
+static void
+irmesh_frame(struct irmesh *m, const uint8_t *buf, size_t len, uint32_t now)
+{
+	uint16_t origin = get16(&buf[3]);
+	uint8_t seq = buf[5];
+	uint8_t hops = buf[6];
+	struct irmesh_slot *s;
+
+	if (get16(&buf[1]) == m->id) {
+		m->stats.echoes += 1;
+		return;
+	}
+
+	if (irmesh_seen(m, origin, seq)) {
+		m->stats.dups += 1;
+		/* someone else sent it on while we waited */
+		s = irmesh_find(m, origin, seq);
+		if (s && ++s->heard >= IRMESH_ENOUGH) {
+			s->state = SLOT_FREE;
+			m->stats.suppressed += 1;
+		}
+		return;
+	}
+
+	m->stats.delivered += 1;
+	m->deliver(m, origin, hops + 1,
+			&buf[IRMESH_HEADER], len - IRMESH_HEADER);
+
+	if (hops + 1 < IRMESH_HOPS) {
+		uint8_t msg[IRFRAME_MAX];
+
+		memcpy(msg, buf, len);
+		msg[6] = hops + 1;
+		irmesh_queue(m, msg, len, irmesh_random(m) % m->backoff, now);
+	}
+}
+
+void
+irmesh_input(struct irmesh *m, uint8_t c, uint32_t now)
+{
+	const uint8_t *buf = m->rx.buf;
+	int len;
+
+	m->rx_last = now;
+	len = irframe_feed(&m->rx, c);
+	if (len < IRMESH_HEADER || buf[0] != IRMESH_TYPE)
+		return;
+	irmesh_frame(m, buf, len, now);
+}
+
+static void
+irmesh_transmit(struct irmesh *m, struct irmesh_slot *s)
+{
+	uint8_t buf[IRFRAME_MAX + IRFRAME_OVERHEAD];
+	size_t len = irframe_encode(buf, s->data, s->len);
+
+	m->output(m, buf, len);
+	m->stats.tx_bytes += len;
+	if (get16(&s->data[3]) != m->id)
+		m->stats.forwarded += 1;
+	s->state = SLOT_FREE;
+}
+
+/*
+ * Sends at most one frame, and only when nobody
+ * has been talking for a little while. Call it
+ * again once the frame is out.
+ */
+void
+irmesh_poll(struct irmesh *m, uint32_t now)
+{
+	struct irmesh_slot *next = NULL;
+	unsigned int i;
+
+	if (elapsed(now, m->rx_last) < m->quiet)
+		return;
+
+	for (i = 0; i < IRMESH_QUEUE; i++) {
+		struct irmesh_slot *s = &m->q[i];
+
+		if (s->state != SLOT_WAITING)
+			continue;
+		/* due times are less than half the clock range ahead */
+		if (elapsed(now, s->due) > IRMESH_TIME_MASK / 2)
+			continue;
+		if (next == NULL || elapsed(s->due, next->due) > IRMESH_TIME_MASK / 2)
+			next = s;
+	}
+	if (next == NULL)
+		return;
+
+	irmesh_transmit(m, next);
+	/* and someone else may be waiting for the air */
+	m->rx_last = now;
+}
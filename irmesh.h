@@ -0,0 +1,113 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IRMESH_H
+#define _IRMESH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "irframe.h"
+
+/*
+ * Store and forward broadcast on top of irframe.
+ *
+ * Every message carries the id of the badge it came
+ * from and a sequence number. The first time a badge
+ * hears a message it delivers it and sends it on after
+ * a random backoff, unless it hears IRMESH_ENOUGH other
+ * badges send it on first. The last IRMESH_SEEN messages
+ * are remembered so nothing is delivered or sent twice.
+ *
+ * Ids are 16 bits. Badges that share one take each
+ * other's messages for their own, so ids have to differ
+ * between badges in range of each other, see uid.h.
+ *
+ * Times are in ms and wrap at 24 bits like timer_now().
+ * This file doesn't touch any hardware either.
+ */
+#define IRMESH_TYPE    0x20
+#define IRMESH_HEADER  7
+#define IRMESH_MTU     (IRFRAME_MAX - IRMESH_HEADER)
+#define IRMESH_SEEN    64 /* must be a power of 2 */
+#define IRMESH_QUEUE   4
+#define IRMESH_HOPS    8
+#define IRMESH_ENOUGH  3
+#define IRMESH_TIME_MASK 0xFFFFFFU
+
+struct irmesh_stats {
+	uint32_t sent;       /* messages we started */
+	uint32_t delivered;  /* new messages from others */
+	uint32_t dups;
+	uint32_t forwarded;
+	uint32_t suppressed; /* others sent it on first */
+	uint32_t dropped;    /* queue full */
+	uint32_t echoes;
+	uint32_t tx_bytes;   /* everything we put on the air */
+};
+
+struct irmesh_slot {
+	uint32_t due;
+	uint8_t state;
+	uint8_t heard;
+	uint8_t len;
+	uint8_t data[IRFRAME_MAX];
+};
+
+struct irmesh;
+typedef void irmesh_out(struct irmesh *m, const uint8_t *buf, size_t len);
+typedef void irmesh_msg(struct irmesh *m, uint16_t origin, uint8_t hops,
+		const uint8_t *buf, size_t len);
+
+struct irmesh {
+	irmesh_out *output;   /* raw bytes to the transmitter */
+	irmesh_msg *deliver;  /* new messages from others */
+	void *priv;
+	uint16_t backoff;     /* ms, random wait is up to this */
+	uint16_t quiet;       /* ms of silence before we talk */
+	uint16_t id;
+	uint8_t seq;
+	uint8_t seen_next;
+	uint8_t seen_used;    /* entries of seen[] filled in */
+	uint32_t rand;
+	uint32_t rx_last;
+	uint32_t seen[IRMESH_SEEN]; /* origin << 8 | seq */
+	struct irframe_rx rx;
+	struct irmesh_slot q[IRMESH_QUEUE];
+	struct irmesh_stats stats;
+};
+
+void irmesh_init(struct irmesh *m, uint16_t id, uint32_t baud, uint32_t seed);
+bool irmesh_send(struct irmesh *m, const uint8_t *data, size_t len, uint32_t now);
+void irmesh_input(struct irmesh *m, uint8_t c, uint32_t now);
+void irmesh_poll(struct irmesh *m, uint32_t now);
+
+static inline bool
+irmesh_idle(const struct irmesh *m)
+{
+	unsigned int i;
+
+	for (i = 0; i < IRMESH_QUEUE; i++) {
+		if (m->q[i].state)
+			return false;
+	}
+	return true;
+}
+
+#endif
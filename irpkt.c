@@ -0,0 +1,264 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "irpkt.h"
+
+enum {
+	IRPKT_DATA = IRPKT_TYPE_MIN, /* src, seq, payload */
+	IRPKT_ACK,                   /* src, next expected seq, mask */
+};
+
+enum {
+	SLOT_FREE,
+	SLOT_QUEUED,
+	SLOT_SENT,
+	SLOT_ACKED,
+};
+
+static inline uint32_t
+elapsed(uint32_t now, uint32_t then)
+{
+	return (now - then) & IRPKT_TIME_MASK;
+}
+
+/*
+ * Set output, deliver and optionally other
+ * after this. The baud rate is only used to
+ * pick the timeouts.
+ */
+void
+irpkt_init(struct irpkt *p, uint8_t id, uint32_t baud)
+{
+	uint32_t frame = (IRFRAME_MAX + IRFRAME_OVERHEAD) * 10000U / baud + 1;
+
+	memset(p, 0, sizeof(*p));
+	p->id = id;
+	p->peer = id;
+	/* a few byte times of silence means the other end is done */
+	p->ack_delay = 30000U / baud + 2;
+	/* a full window, the answer and some slack */
+	p->rto = (IRPKT_WINDOW + 1) * frame + 2 * p->ack_delay + 10;
+	irframe_rx_init(&p->rx);
+}
+
+static void
+irpkt_output(struct irpkt *p, const uint8_t *msg, size_t len)
+{
+	uint8_t buf[IRFRAME_MAX + IRFRAME_OVERHEAD];
+
+	p->output(p, buf, irframe_encode(buf, msg, len));
+}
+
+static void
+irpkt_transmit(struct irpkt *p, uint8_t seq, uint32_t now)
+{
+	struct irpkt_slot *s = &p->tx[seq % IRPKT_WINDOW];
+	uint8_t msg[IRFRAME_MAX];
+
+	msg[0] = IRPKT_DATA;
+	msg[1] = p->id;
+	msg[2] = seq;
+	memcpy(&msg[IRPKT_HEADER], s->data, s->len);
+	irpkt_output(p, msg, IRPKT_HEADER + s->len);
+	s->state = SLOT_SENT;
+	s->sent = now;
+	if (s->tries++ > 0)
+		p->stats.tx_resends += 1;
+	p->stats.tx_frames += 1;
+}
+
+/*
+ * Queues a frame, it goes out with the rest
+ * of the window from irpkt_poll().
+ */
+bool
+irpkt_send(struct irpkt *p, const uint8_t *data, size_t len)
+{
+	struct irpkt_slot *s;
+
+	if ((uint8_t)(p->tx_next - p->tx_base) == IRPKT_WINDOW)
+		return false;
+	if (len > IRPKT_MTU)
+		len = IRPKT_MTU;
+
+	s = &p->tx[p->tx_next++ % IRPKT_WINDOW];
+	s->state = SLOT_QUEUED;
+	s->tries = 0;
+	s->len = len;
+	memcpy(s->data, data, len);
+	return true;
+}
+
+static void
+irpkt_ack(struct irpkt *p)
+{
+	uint8_t msg[4];
+
+	msg[0] = IRPKT_ACK;
+	msg[1] = p->id;
+	msg[2] = p->rx_next;
+	msg[3] = p->rx_mask >> 1;
+	irpkt_output(p, msg, 4);
+	p->ack_due = false;
+	p->stats.acks_sent += 1;
+}
+
+static void
+irpkt_data(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	uint8_t seq = buf[2];
+	uint8_t d;
+	struct irpkt_slot *s;
+
+	/* new sender, new sequence */
+	if (buf[1] != p->peer) {
+		p->peer = buf[1];
+		p->rx_next = 0;
+		p->rx_mask = 0;
+	}
+
+	p->stats.rx_frames += 1;
+	p->ack_due = true;
+
+	d = seq - p->rx_next;
+	if (d >= IRPKT_WINDOW || (p->rx_mask & (1U << d))) {
+		p->stats.rx_dups += 1;
+		return;
+	}
+
+	s = &p->rxq[seq % IRPKT_WINDOW];
+	s->len = len - IRPKT_HEADER;
+	memcpy(s->data, &buf[IRPKT_HEADER], s->len);
+	p->rx_mask |= 1U << d;
+
+	while (p->rx_mask & 1U) {
+		s = &p->rxq[p->rx_next % IRPKT_WINDOW];
+		p->deliver(p, s->data, s->len);
+		p->stats.rx_bytes += s->len;
+		p->rx_next += 1;
+		p->rx_mask >>= 1;
+	}
+}
+
+static void
+irpkt_acked(struct irpkt *p, const uint8_t *buf, uint32_t now)
+{
+	uint8_t ack = buf[2];
+	uint8_t mask = buf[3];
+	uint8_t inflight = p->tx_next - p->tx_base;
+	uint8_t last = ack;
+	uint8_t seq;
+	unsigned int i;
+
+	p->stats.acks_rcvd += 1;
+
+	/* stale or from a previous session */
+	if ((uint8_t)(ack - p->tx_base) > inflight)
+		return;
+
+	for (seq = p->tx_base; seq != ack; seq++)
+		p->tx[seq % IRPKT_WINDOW].state = SLOT_ACKED;
+	for (i = 0; i < IRPKT_WINDOW - 1; i++) {
+		seq = ack + 1 + i;
+		if (!(mask & (1U << i)) || (uint8_t)(seq - p->tx_base) >= inflight)
+			continue;
+		p->tx[seq % IRPKT_WINDOW].state = SLOT_ACKED;
+		last = seq;
+	}
+
+	while (p->tx_base != p->tx_next) {
+		struct irpkt_slot *s = &p->tx[p->tx_base % IRPKT_WINDOW];
+
+		if (s->state != SLOT_ACKED)
+			break;
+		s->state = SLOT_FREE;
+		p->stats.tx_acked += s->len;
+		p->tx_base += 1;
+	}
+
+	/* anything before the last frame received is lost,
+	 * unless we sent it again after the answer left */
+	for (seq = p->tx_base; seq != last; seq++) {
+		struct irpkt_slot *s = &p->tx[seq % IRPKT_WINDOW];
+
+		if (s->state == SLOT_SENT && elapsed(now, s->sent) >= p->ack_delay)
+			s->state = SLOT_QUEUED;
+	}
+}
+
+void
+irpkt_input(struct irpkt *p, uint8_t c, uint32_t now)
+{
+	const uint8_t *buf = p->rx.buf;
+	int len;
+
+	p->rx_last = now;
+	len = irframe_feed(&p->rx, c);
+	if (len <= 0)
+		return;
+
+	if (buf[0] < IRPKT_TYPE_MIN) {
+		if (p->other)
+			p->other(p, buf, len);
+		return;
+	}
+	if (len < IRPKT_HEADER)
+		return;
+	if (buf[1] == p->id) {
+		p->stats.rx_echoes += 1;
+		return;
+	}
+
+	switch (buf[0]) {
+	case IRPKT_DATA:
+		irpkt_data(p, buf, len);
+		break;
+	case IRPKT_ACK:
+		if (len == 4)
+			irpkt_acked(p, buf, now);
+		break;
+	}
+}
+
+void
+irpkt_poll(struct irpkt *p, uint32_t now)
+{
+	uint32_t quiet = elapsed(now, p->rx_last);
+	uint8_t seq;
+
+	/* don't talk over the other end, answers
+	 * go first and data waits a little longer */
+	if (quiet < p->ack_delay)
+		return;
+	if (p->ack_due)
+		irpkt_ack(p);
+	if (quiet < 2 * p->ack_delay)
+		return;
+
+	for (seq = p->tx_base; seq != p->tx_next; seq++) {
+		struct irpkt_slot *s = &p->tx[seq % IRPKT_WINDOW];
+
+		if (s->state == SLOT_QUEUED
+				|| (s->state == SLOT_SENT && elapsed(now, s->sent) >= p->rto))
+			irpkt_transmit(p, seq, now);
+	}
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IRPKT_H
+#define _IRPKT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "irframe.h"
+
+/*
+ * Reliable, ordered packets on top of irframe.
+ *
+ * Data frames carry an 8bit sequence number and
+ * the receiver answers with the next sequence number
+ * it expects plus a bit mask of the frames after that
+ * it already has. The sender keeps up to IRPKT_WINDOW
+ * frames in flight and only sends again the ones missing.
+ *
+ * Every frame carries the id of the sender, so frames
+ * we hear from our own transmitter are dropped. Pick
+ * a new id for every session, the receiver starts
+ * over when it sees a new one.
+ *
+ * Frame types below IRPKT_TYPE_MIN are handed to the
+ * other() callback, so apps can mix in their own frames.
+ *
+ * Times are in ms and wrap at 24 bits like timer_now().
+ * This file doesn't touch any hardware either.
+ */
+#define IRPKT_WINDOW    4 /* must be a power of 2 and at most 8 */
+#define IRPKT_HEADER    3
+#define IRPKT_MTU       (IRFRAME_MAX - IRPKT_HEADER)
+#define IRPKT_TYPE_MIN  0x40
+#define IRPKT_TIME_MASK 0xFFFFFFU
+
+struct irpkt_stats {
+	uint32_t tx_frames;  /* data frames including resends */
+	uint32_t tx_resends;
+	uint32_t tx_acked;   /* payload bytes acknowledged */
+	uint32_t rx_frames;  /* data frames received */
+	uint32_t rx_dups;
+	uint32_t rx_bytes;   /* payload bytes delivered */
+	uint32_t rx_echoes;
+	uint32_t acks_sent;
+	uint32_t acks_rcvd;
+};
+
+struct irpkt_slot {
+	uint32_t sent;
+	uint8_t state;
+	uint8_t tries;
+	uint8_t len;
+	uint8_t data[IRPKT_MTU];
+};
+
+struct irpkt;
+typedef void irpkt_out(struct irpkt *p, const uint8_t *buf, size_t len);
+
+struct irpkt {
+	irpkt_out *output;  /* raw bytes to the transmitter */
+	irpkt_out *deliver; /* received payloads, in order */
+	irpkt_out *other;   /* other frames, may be NULL */
+	void *priv;
+	uint16_t rto;       /* ms before a frame is sent again */
+	uint16_t ack_delay; /* ms of silence before we answer */
+	uint8_t id;
+	uint8_t peer;
+	uint8_t tx_base;
+	uint8_t tx_next;
+	uint8_t rx_next;
+	uint8_t rx_mask;
+	bool ack_due;
+	uint32_t rx_last;
+	struct irframe_rx rx;
+	struct irpkt_slot tx[IRPKT_WINDOW];
+	struct irpkt_slot rxq[IRPKT_WINDOW];
+	struct irpkt_stats stats;
+};
+
+void irpkt_init(struct irpkt *p, uint8_t id, uint32_t baud);
+bool irpkt_send(struct irpkt *p, const uint8_t *data, size_t len);
+void irpkt_input(struct irpkt *p, uint8_t c, uint32_t now);
+void irpkt_poll(struct irpkt *p, uint32_t now);
+
+static inline bool
+irpkt_idle(const struct irpkt *p)
+{
+	return p->tx_base == p->tx_next;
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "ir.h"
+#include "irpkt.h"
+#include "irlink.h"
+
+/*
+ * IR throughput test between two badges. The data
+ * goes through irpkt, so the numbers shown are what
+ * actually made it across.
+ */
+
+#define FG444 0xCB0
+#define BG444 0x000
+
+#define TEST_MS   5000
+#define GIVEUP_MS 10000
+
+enum events {
+	EV_EXIT = 1,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+static uint32_t
+ms_since(uint32_t start)
+{
+	return (timer_now() - start) & 0xFFFFFFU;
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+pkt_deliver(struct irpkt *p, const uint8_t *buf, size_t len)
+{
+	(void)p;
+	(void)buf;
+	(void)len;
+}
+
+static int
+send_data(int rate, char *buf)
+{
+	struct irpkt *p = irlink_start(rate, pkt_deliver, NULL);
+	uint8_t data[IRPKT_MTU];
+	uint32_t start = timer_now();
+	uint32_t shown = start;
+	uint32_t ms;
+	unsigned int i;
+
+	if (p == NULL) {
+		show(3, "Out of memory");
+		return 0;
+	}
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = i;
+
+	while (1) {
+		struct event ev;
+
+		if (event_poll(&ev) && ev.type == EV_EXIT)
+			return IRLINK_EXIT;
+
+		ms = ms_since(start);
+		if (ms < TEST_MS) {
+			while (irpkt_send(p, data, ARRAY_SIZE(data)))
+				/* fill the window */;
+		} else if (irpkt_idle(p) || ms >= TEST_MS + GIVEUP_MS)
+			break;
+		irlink_poll(p);
+
+		if (ms_since(shown) >= 500) {
+			shown = timer_now();
+			sprintf(buf, "Acked %lu B", (unsigned long)p->stats.tx_acked);
+			show(3, buf);
+		}
+	}
+
+	sprintf(buf, "Acked %lu B", (unsigned long)p->stats.tx_acked);
+	show(3, buf);
+	sprintf(buf, "  %lu B/s", (unsigned long)(p->stats.tx_acked * 1000 / ms));
+	show(4, buf);
+	sprintf(buf, "Frames %lu", (unsigned long)p->stats.tx_frames);
+	show(5, buf);
+	sprintf(buf, "Resent %lu", (unsigned long)p->stats.tx_resends);
+	show(6, buf);
+	if (!irpkt_idle(p))
+		show(7, "Peer lost");
+	return 0;
+}
+
+static int
+recv_data(int rate, char *buf)
+{
+	struct irpkt *p = irlink_start(rate, pkt_deliver, NULL);
+	uint32_t start = 0;
+	uint32_t shown = timer_now();
+	uint32_t ms;
+
+	if (p == NULL) {
+		show(3, "Out of memory");
+		return 0;
+	}
+	show(3, "Receiving..");
+	while (1) {
+		struct event ev;
+
+		if (event_poll(&ev) && ev.type == EV_EXIT)
+			return IRLINK_EXIT;
+
+		irlink_poll(p);
+		if (p->stats.rx_bytes == 0) {
+			start = timer_now();
+			continue;
+		}
+		if (ms_since(p->rx_last) >= 2000)
+			break;
+
+		if (ms_since(shown) >= 500) {
+			shown = timer_now();
+			sprintf(buf, "Got  %lu B", (unsigned long)p->stats.rx_bytes);
+			show(3, buf);
+		}
+	}
+
+	ms = (p->rx_last - start) & 0xFFFFFFU;
+	sprintf(buf, "Got  %lu B", (unsigned long)p->stats.rx_bytes);
+	show(3, buf);
+	if (ms > 0) {
+		sprintf(buf, "  %lu B/s", (unsigned long)(p->stats.rx_bytes * 1000 / ms));
+		show(4, buf);
+	}
+	sprintf(buf, "Dups %lu", (unsigned long)p->stats.rx_dups);
+	show(5, buf);
+	sprintf(buf, "Errors %lu", (unsigned long)p->rx.errors);
+	show(6, buf);
+	return 0;
+}
+
+static void
+irspeed_run(int (*negotiate)(uint8_t exit),
+		int (*test)(int rate, char *buf))
+{
+	char buf[24];
+	int ret;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	show(0, "Looking for peer");
+	buttons_config(buttons);
+
+	ir_init();
+
+	ret = negotiate(EV_EXIT);
+	if (ret == IRLINK_EXIT)
+		goto out;
+	if (ret == IRLINK_TIMEOUT) {
+		show(0, "No peer found");
+		goto wait;
+	}
+
+	sprintf(buf, "%lu baud", (unsigned long)ir_baud(ret));
+	show(0, buf);
+
+	if (test(ret, buf) == IRLINK_EXIT)
+		goto out;
+wait:
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+out:
+	ir_uninit();
+}
+
+static void
+irspeed_send(void)
+{
+	irspeed_run(irlink_connect, send_data);
+}
+
+static void
+irspeed_recv(void)
+{
+	irspeed_run(irlink_accept, recv_data);
+}
+
+void
+irspeed(void)
+{
+	static const struct menuitem irspeed_menu[] = {
+		{ .label = "Send",    .cb = irspeed_send, },
+		{ .label = "Receive", .cb = irspeed_recv, },
+	};
+
+	menu(irspeed_menu, ARRAY_SIZE(irspeed_menu), FG444, BG444);
+}
@@ -0,0 +1,213 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency.h"
+
+unsigned int irq_depth;
+
+#if LATENCY
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "timer.h"
+#include "speed.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+
+#define FG444 0xF80
+#define BG444 0x000
+
+enum events {
+	EV_EXIT = 1,
+	EV_RESET,
+	EV_PREV,
+	EV_NEXT,
+	EV_TICK,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_CENTER] = { .press = EV_RESET, },
+	[BTN_UP]     = { .press = EV_PREV, },
+	[BTN_DOWN]   = { .press = EV_NEXT, },
+};
+
+static const char *const latency_title[LATENCY_MAX] = {
+	[LATENCY_IRQOFF] = "IRQs off",
+	[LATENCY_PRIO1]  = "Prio 1: IR, TIMER1",
+	[LATENCY_PRIO2]  = "Prio 2: RTC",
+	[LATENCY_PRIO3]  = "Prio 3: GPIO",
+};
+
+static const char *const latency_label[LATENCY_BUCKETS] = {
+	"<16", "<64", "<256", "<1k", "<4k", "more",
+};
+
+static struct latency_hist latency_tab[LATENCY_MAX];
+static uint32_t latency_start;
+static uint32_t latency_switches;
+static uint32_t latency_switches_tick;
+static unsigned int latency_probe;
+
+static void
+latency_add(struct latency_hist *h, uint32_t cycles, const char *site)
+{
+	unsigned int i;
+
+	for (i = 0; i < LATENCY_BUCKETS - 1; i++) {
+		if (cycles < (16U << (2 * i)))
+			break;
+	}
+	h->bucket[i] += 1;
+	h->count += 1;
+	if (cycles >= h->max) {
+		h->max = cycles;
+		h->site = site;
+	}
+}
+
+void
+latency_off(void)
+{
+	latency_switches = speed_switches();
+	latency_start = timer_cycles();
+}
+
+/* called with interrupts still masked */
+void
+latency_on(const char *site)
+{
+	uint32_t cycles = timer_cycles_since(latency_start);
+
+	if (speed_switches() == latency_switches)
+		latency_add(&latency_tab[LATENCY_IRQOFF], cycles, site);
+}
+
+void
+SysTick_Handler(void)
+{
+	/* the counter reloaded to 0xFFFFFF when it fired */
+	uint32_t cycles = 0xFFFFFFU - SysTick->VAL;
+
+	/*
+	 * Waking up from EM1 switches back to full speed, so
+	 * leave out wraps that happened at the slow clock.
+	 */
+	if (speed_switches() == latency_switches_tick ||
+			timer_cycles_since(speed_switched_at()) >= cycles)
+		latency_add(&latency_tab[LATENCY_PRIO1 + latency_probe], cycles, NULL);
+	latency_switches_tick = speed_switches();
+	latency_probe = (latency_probe + 1) % 3;
+	NVIC_SetPriority(SysTick_IRQn, 1 + latency_probe);
+}
+
+void
+latency_init(void)
+{
+	latency_probe = 0;
+	NVIC_SetPriority(SysTick_IRQn, 1);
+	SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+}
+
+void
+latency_get(enum latency_kind k, struct latency_hist *h)
+{
+	irq_off();
+	*h = latency_tab[k];
+	irq_on();
+}
+
+void
+latency_reset(void)
+{
+	irq_off();
+	memset(latency_tab, 0, sizeof(latency_tab));
+	irq_on();
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+latency_render(enum latency_kind k)
+{
+	struct latency_hist h;
+	char buf[32];
+	unsigned int i;
+
+	latency_get(k, &h);
+
+	show(0, latency_title[k]);
+	sprintf(buf, "%lu samples", (unsigned long)h.count);
+	show(1, buf);
+	sprintf(buf, "max %lu cycles", (unsigned long)h.max);
+	show(2, buf);
+	if (h.site) {
+		sprintf(buf, "in %.17s", h.site);
+		show(3, buf);
+	} else
+		show(3, "");
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		sprintf(buf, "%-5s %12lu", latency_label[i],
+				(unsigned long)h.bucket[i]);
+		show(4 + i, buf);
+	}
+}
+
+void
+irqlatency(void)
+{
+	enum latency_kind k = LATENCY_IRQOFF;
+	struct ticker tick;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	latency_render(k);
+
+	ticker_start(&tick, 500, EV_TICK);
+	while (1) {
+		switch ((enum events)event_wait()) {
+		case EV_EXIT:
+			ticker_stop(&tick);
+			return;
+		case EV_RESET:
+			latency_reset();
+			break;
+		case EV_PREV:
+			k = (k + LATENCY_MAX - 1) % LATENCY_MAX;
+			break;
+		case EV_NEXT:
+			k = (k + 1) % LATENCY_MAX;
+			break;
+		case EV_TICK:
+			break;
+		}
+		latency_render(k);
+	}
+}
+#endif
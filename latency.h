@@ -0,0 +1,101 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <stdint.h>
+
+#include "geckonator/common.h"
+
+/*
+ * How long interrupts stay masked and how late
+ * handlers get to run. Build with -DLATENCY=1 to get
+ * the "IRQ latency" screen; otherwise irq_off() and
+ * irq_on() only mask and unmask interrupts.
+ *
+ * irq_off() and irq_on() nest, only the outermost pair
+ * touches the mask, so it's fine to call something that
+ * masks interrupts itself. Don't mix them with bare
+ * __disable_irq() and __enable_irq().
+ *
+ * Masked sections are timed with SysTick from irq_off()
+ * to irq_on(), and the function holding the longest one
+ * is remembered. Samples the core clock was switched in
+ * are left out, see speed_switches().
+ *
+ * Entry latency is sampled with the SysTick exception,
+ * which fires when the counter wraps every 2^24 cycles,
+ * so exactly how long ago it wrapped is known when the
+ * handler runs. It takes turns at the priority of the
+ * IR/TIMER1 (1), RTC (2) and GPIO (3) handlers, and is
+ * kept waiting by the same things they are.
+ */
+#ifndef LATENCY
+#define LATENCY 0
+#endif
+
+enum latency_kind {
+	LATENCY_IRQOFF,
+	LATENCY_PRIO1,
+	LATENCY_PRIO2,
+	LATENCY_PRIO3,
+	LATENCY_MAX,
+};
+
+/* below 16, 64, 256, 1k, 4k cycles and the rest */
+#define LATENCY_BUCKETS 6
+
+struct latency_hist {
+	uint32_t count;
+	uint32_t max;
+	const char *site; /* of max, masked sections only */
+	uint32_t bucket[LATENCY_BUCKETS];
+};
+
+/* only touched with interrupts masked */
+extern unsigned int irq_depth;
+
+#if LATENCY
+void latency_init(void);
+void latency_off(void);
+void latency_on(const char *site);
+void latency_get(enum latency_kind k, struct latency_hist *h);
+void latency_reset(void);
+
+#define irq_off() do { \
+	__disable_irq(); \
+	if (irq_depth++ == 0) \
+		latency_off(); \
+} while (0)
+#define irq_on() do { \
+	if (--irq_depth == 0) { \
+		latency_on(__func__); \
+		__enable_irq(); \
+	} \
+} while (0)
+/* don't count sleeping with interrupts masked */
+#define irq_woken() latency_off()
+#else
+#define latency_init() do { } while (0)
+#define irq_off()   do { __disable_irq(); irq_depth++; } while (0)
+#define irq_on()    do { if (--irq_depth == 0) __enable_irq(); } while (0)
+#define irq_woken() do { } while (0)
+#endif
+
+#endif
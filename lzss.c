@@ -0,0 +1,133 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "lzss.h"
+
+enum {
+	DEC_FLAGS,
+	DEC_ITEM,
+	DEC_MATCH,
+};
+
+/*
+ * Plain search through the block for the longest
+ * match. Slow on noise, but needs no tables.
+ */
+size_t
+lzss_compress(uint8_t *out, const uint8_t *in, size_t len)
+{
+	size_t flags = 0;
+	size_t o = 0;
+	size_t i = 0;
+	unsigned int bit = 8;
+
+	while (i < len) {
+		size_t max = len - i;
+		size_t best = 0;
+		size_t dist = 0;
+		size_t j;
+
+		if (bit == 8) {
+			flags = o++;
+			out[flags] = 0;
+			bit = 0;
+		}
+
+		if (max > LZSS_MAXLEN)
+			max = LZSS_MAXLEN;
+		for (j = 0; j < i; j++) {
+			size_t n;
+
+			if (in[j] != in[i])
+				continue;
+			for (n = 1; n < max && in[j + n] == in[i + n]; n++)
+				/* count */;
+			if (n > best) {
+				best = n;
+				dist = i - j;
+				if (n == max)
+					break;
+			}
+		}
+
+		if (best >= LZSS_MINLEN) {
+			dist -= 1;
+			out[o++] = dist;
+			out[o++] = ((dist >> 8) << 7) | (best - LZSS_MINLEN);
+			i += best;
+		} else {
+			out[flags] |= 1U << bit;
+			out[o++] = in[i++];
+		}
+		bit += 1;
+	}
+	return o;
+}
+
+void
+lzss_dec_init(struct lzss_dec *d, uint8_t *out, size_t max)
+{
+	d->out = out;
+	d->pos = 0;
+	d->max = max;
+	d->state = DEC_FLAGS;
+}
+
+/*
+ * Returns -1 on input that doesn't
+ * fit the block, 0 otherwise.
+ */
+int
+lzss_dec_feed(struct lzss_dec *d, uint8_t c)
+{
+	unsigned int dist;
+	unsigned int n;
+
+	switch (d->state) {
+	case DEC_FLAGS:
+		d->flags = c;
+		d->bit = 0;
+		d->state = DEC_ITEM;
+		return 0;
+	case DEC_ITEM:
+		if (!(d->flags & (1U << d->bit))) {
+			d->lo = c;
+			d->state = DEC_MATCH;
+			return 0;
+		}
+		if (d->pos == d->max)
+			return -1;
+		d->out[d->pos++] = c;
+		break;
+	case DEC_MATCH:
+		dist = (d->lo | ((c >> 7) << 8)) + 1;
+		n = (c & 0x7F) + LZSS_MINLEN;
+		if (dist > d->pos || n > (unsigned int)(d->max - d->pos))
+			return -1;
+		for (; n > 0; n--, d->pos++)
+			d->out[d->pos] = d->out[d->pos - dist];
+		d->state = DEC_ITEM;
+		break;
+	}
+	if (++d->bit == 8)
+		d->state = DEC_FLAGS;
+	return 0;
+}
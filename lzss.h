@@ -0,0 +1,58 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LZSS_H
+#define _LZSS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Small LZSS for blocks of up to LZSS_BLOCK bytes.
+ *
+ * A flag byte says what the next 8 items are,
+ * lowest bit first. Set means a literal byte,
+ * clear means a 2 byte match:
+ *
+ *   DIST_LO  DIST_HI:1 LEN:7
+ *
+ * copying LEN + 3 bytes from DIST + 1 bytes back.
+ * Matches never reach outside the block, so the
+ * decoder needs no more RAM than the block itself
+ * and can be fed a byte at a time.
+ */
+#define LZSS_BLOCK  512
+#define LZSS_MINLEN 3
+#define LZSS_MAXLEN (127 + LZSS_MINLEN)
+#define LZSS_BOUND(len) ((len) + ((len) + 7) / 8)
+
+struct lzss_dec {
+	uint8_t *out;
+	uint16_t pos;
+	uint16_t max;
+	uint8_t state;
+	uint8_t flags;
+	uint8_t bit;
+	uint8_t lo;
+};
+
+size_t lzss_compress(uint8_t *out, const uint8_t *in, size_t len);
+void lzss_dec_init(struct lzss_dec *d, uint8_t *out, size_t max);
+int lzss_dec_feed(struct lzss_dec *d, uint8_t c);
+
+#endif
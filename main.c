@@ -21,6 +21,7 @@
 #include "geckonator/clock.h"
 #include "geckonator/gpio.h"
 
+#include "work.h"
 #include "timer.h"
 #include "leds.h"
 #include "events.h"
@@ -30,6 +31,12 @@
 #include "display.h"
 #include "sdcard.h"
 #include "menu.h"
+#include "arena.h"
+#include "spitune.h"
+#include "cycles.h"
+#include "latency.h"
+#include "photon.h"
+#include "stack.h"
 
 #ifdef NDEBUG
 #define debug(...)
@@ -54,18 +61,23 @@ extern const struct dp_cimage logo;
 
 static FRESULT show_logo(void)
 {
-	FATFS fs;
-	FRESULT res;
+	unsigned int mark = arena_mark();
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	FRESULT res = FR_NOT_ENOUGH_CORE;
 
 	sd_init();
 
-	res = f_mount(&fs, "", 1);
+	if (fs)
+		res = f_mount(fs, "", 1);
 	if (res != FR_OK)
 		goto err;
 
+	/* before drawing, so the logo gets the tuned clocks */
+	spitune_load();
 	res = dp_showbmp_at("LOGO.BMP", 0, 0);
 err:
 	sd_uninit();
+	arena_release(mark);
 	return res;
 }
 
@@ -96,29 +108,72 @@ void program(void);
 void buttontest(void);
 void showbmp(void);
 void dumpir(void);
+void irspeed(void);
+void irfile(void);
+void remote(void);
+void meshchat(void);
+void discover(void);
 void snakemenu(void);
+void benchmarks(void);
+void profiler(void);
+void stackview(void);
+void speedview(void);
+void spitune(void);
+void taskview(void);
+#if CYCLES
+void cyclecounters(void);
+#endif
+#if LATENCY
+void irqlatency(void);
+#endif
+#if PHOTON
+void photonview(void);
+#endif
 
 static const struct menuitem main_menu[] = {
 	{ .label = "Browse program", .cb = program, },
 	{ .label = "Button test",    .cb = buttontest, },
 	{ .label = "Show BMP",       .cb = showbmp, },
 	{ .label = "Dump IR data",   .cb = dumpir, },
+	{ .label = "IR speed test",  .cb = irspeed, },
+	{ .label = "IR file transfer", .cb = irfile, },
+	{ .label = "IR remote",      .cb = remote, },
+	{ .label = "IR mesh",        .cb = meshchat, },
+	{ .label = "Find badges",    .cb = discover, },
 	{ .label = "Snake",          .cb = snakemenu, },
+	{ .label = "Benchmarks",     .cb = benchmarks, },
+	{ .label = "Profiler",       .cb = profiler, },
+	{ .label = "Stack usage",    .cb = stackview, },
+	{ .label = "Clock speeds",   .cb = speedview, },
+	{ .label = "SPI clocks",     .cb = spitune, },
+	{ .label = "Tasks",          .cb = taskview, },
+#if CYCLES
+	{ .label = "Cycle counters", .cb = cyclecounters, },
+#endif
+#if LATENCY
+	{ .label = "IRQ latency",    .cb = irqlatency, },
+#endif
+#if PHOTON
+	{ .label = "Input latency",  .cb = photonview, },
+#endif
 };
 
+const struct menuitem *
+main_menu_items(size_t *len)
+{
+	*len = ARRAY_SIZE(main_menu);
+	return main_menu;
+}
+
 void __noreturn
 main(void)
 {
+	/* before anything else has had a chance to use the stack */
+	stack_init();
+
 	/* switch to 48MHz / 2 ushfrco as core clock */
-	clock_ushfrco_48mhz_div2();
-	clock_ushfrco_enable();
-	while (!clock_ushfrco_ready())
-		/* wait */;
-	clock_hfclk_select_ushfrco();
-	while (!clock_ushfrco_selected())
-		/* wait */;
+	power_hfclk();
 	clock_lfrco_enable();
-	clock_hfrco_disable();
 
 	/* disable auxfrco, only needed to program flash */
 	clock_auxhfrco_disable();
@@ -129,6 +184,7 @@ main(void)
 	while (clock_lf_syncbusy())
 		/* wait */;
 
+	work_init();
 	timer_init();
 
 	/* enable GPIOs */
@@ -25,6 +25,9 @@
 #include "display.h"
 #include "power.h"
 #include "menu.h"
+#include "photon.h"
+#include "stack.h"
+#include "arena.h"
 
 enum events {
 	EV_UP = 1,
@@ -45,7 +48,7 @@ static const struct button_config menubuttons[BTN_MAX] = {
 	[BTN_CENTER] = { .press   = EV_ENTER, },
 };
 
-static void
+void
 menu_render(unsigned int fg444, unsigned int bg444,
 		const struct menuitem *menu, size_t len, unsigned int sel)
 {
@@ -84,23 +87,35 @@ restart:
 	ticker_start(&tick1s, 1000, EV_TICK1S);
 
 	while (1) {
-		switch ((enum events)event_wait()) {
+		struct event ev;
+
+		event_pend(&ev);
+		/* coalesced key repeats move several lines at once */
+		switch ((enum events)ev.type) {
 		case EV_UP:
 			if (i > 0) {
-				i -= 1;
+				i -= (ev.arg < i) ? ev.arg : i;
 				menu_render(fg444, bg444, menu, len, i);
 			}
 			break;
 		case EV_DOWN:
 			if ((i + 1) < len) {
-				i += 1;
+				i += (ev.arg < len - i) ? ev.arg : len - i - 1;
 				menu_render(fg444, bg444, menu, len, i);
 			}
 			break;
 		case EV_ENTER:
 			if (menu[i].cb) {
+				unsigned int mark = arena_mark();
+
 				ticker_stop(&tick1s);
+				stack_mark();
+				photon_enter(menu[i].label);
 				menu[i].cb();
+				photon_leave();
+				stack_record(menu[i].label);
+				/* whatever the entry took from the arena */
+				arena_release(mark);
 				goto restart;
 			}
 			break;
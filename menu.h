@@ -28,6 +28,11 @@ struct menuitem {
 	menu_cb *cb;
 };
 
+void menu_render(unsigned int fg444, unsigned int bg444,
+		const struct menuitem *menu, size_t len, unsigned int sel);
 void menu(const struct menuitem *menu, size_t len, unsigned int fg444, unsigned int bg444);
 
+/* the top level menu from main.c */
+const struct menuitem *main_menu_items(size_t *len);
+
 #endif
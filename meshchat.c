@@ -0,0 +1,168 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "arena.h"
+#include "ir.h"
+#include "irmesh.h"
+#include "uid.h"
+
+/*
+ * Shout into the IR mesh (center button) and see what
+ * everyone else is shouting.
+ */
+
+#define FG444 0x5DF
+#define BG444 0x000
+
+#define MESH_RATE IR_9600
+#define LINES     6
+#define LINE_LEN  20
+
+enum events {
+	EV_EXIT = 1,
+	EV_SEND,
+	EV_TICK,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_CENTER] = { .press = EV_SEND, },
+};
+
+/* taken from the arena, so it only costs RAM while chatting */
+struct chat {
+	struct irmesh mesh;
+	char lines[LINES][LINE_LEN + 1];
+	unsigned int next;
+	bool dirty;
+};
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+mesh_output(struct irmesh *m, const uint8_t *buf, size_t len)
+{
+	const uint8_t *end = buf + len;
+
+	(void)m;
+	for (; buf < end; buf++)
+		ir_send(*buf);
+}
+
+static void
+mesh_deliver(struct irmesh *m, uint16_t origin, uint8_t hops,
+		const uint8_t *buf, size_t len)
+{
+	struct chat *c = m->priv;
+	char *line = c->lines[c->next++ % LINES];
+
+	if (len > LINE_LEN - 7)
+		len = LINE_LEN - 7;
+	sprintf(line, "%04X %u ", origin, hops);
+	strncat(line, (const char *)buf, len);
+	c->dirty = true;
+}
+
+static void
+redraw(struct chat *c, char *buf)
+{
+	const struct irmesh_stats *st = &c->mesh.stats;
+	unsigned int i;
+
+	for (i = 0; i < LINES; i++)
+		show(2 + i, c->lines[(c->next + i) % LINES]);
+	sprintf(buf, "Fwd %lu Quiet %lu",
+			(unsigned long)st->forwarded,
+			(unsigned long)st->suppressed);
+	show(9, buf);
+	c->dirty = false;
+}
+
+void
+meshchat(void)
+{
+	struct chat *c = arena_alloc(sizeof(*c));
+	struct ticker tick;
+	unsigned int count = 0;
+	char buf[24];
+
+	if (c == NULL)
+		return;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	memset(c, 0, sizeof(*c));
+
+	irmesh_init(&c->mesh, uid16(), ir_baud(MESH_RATE),
+			DEVINFO->UNIQUEL ^ timer_cycles());
+	c->mesh.output = mesh_output;
+	c->mesh.deliver = mesh_deliver;
+	c->mesh.priv = c;
+	sprintf(buf, "Badge %04X", c->mesh.id);
+	show(0, buf);
+	redraw(c, buf);
+
+	ir_init();
+	ir_rate(MESH_RATE);
+	/* backoffs are a few frame times, so check often */
+	ticker_start(&tick, 10, EV_TICK);
+
+	while (1) {
+		struct event ev;
+		int ch;
+
+		event_pend(&ev);
+		switch (ev.type) {
+		case EV_EXIT:
+			goto out;
+		case EV_SEND:
+			sprintf(buf, "Hello #%u", ++count);
+			irmesh_send(&c->mesh, (const uint8_t *)buf, strlen(buf), timer_now());
+			break;
+		}
+
+		while ((ch = ir_recv()) >= 0)
+			irmesh_input(&c->mesh, ch, timer_now());
+		irmesh_poll(&c->mesh, timer_now());
+		if (c->dirty)
+			redraw(c, buf);
+	}
+out:
+	ticker_stop(&tick);
+	ir_uninit();
+}
@@ -0,0 +1,337 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "photon.h"
+
+#if PHOTON
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "speed.h"
+
+#define FG444 0x0CF
+#define BG444 0x000
+
+#define PHOTON_DEPTH  4
+#define STALE_MS      2000
+#define CYCLES_PER_US (CORE_HZ / 1000000U)
+
+enum state {
+	IDLE,
+	PRESSED,
+	POSTED,
+	DEQUEUED,
+	DRAWING,
+};
+
+struct stamp {
+	uint32_t ms;
+	uint32_t cycles;
+	uint32_t switches;
+};
+
+static volatile uint8_t photon_state;
+static uint8_t photon_btn;
+static uint8_t photon_type;
+static struct stamp t_irq;
+static struct stamp t_deq;
+static struct stamp t_wait;
+static struct stamp t_draw;
+static uint32_t photon_waited;
+static struct photon_app *photon_cur;
+
+static const char *photon_stack[PHOTON_DEPTH];
+static unsigned int photon_depth;
+static struct photon_app photon_apps[PHOTON_APPS];
+
+static const uint16_t photon_limit[PHOTON_BUCKETS - 1] = {
+	10, 20, 50, 100, 200,
+};
+
+static void
+stamp(struct stamp *s)
+{
+	s->ms = timer_now();
+	s->cycles = timer_cycles();
+	s->switches = speed_switches();
+}
+
+/*
+ * SysTick wraps every 0.7s, so use the RTC for longer times.
+ * It also counts slower while the clock is scaled down.
+ */
+static uint32_t
+elapsed_us(const struct stamp *from, const struct stamp *to)
+{
+	uint32_t ms = (to->ms - from->ms) & 0xFFFFFFU;
+
+	if (ms < 500 && from->switches == to->switches)
+		return ((from->cycles - to->cycles) & 0xFFFFFFU) / CYCLES_PER_US;
+	return ms * 1000;
+}
+
+static bool
+stale(const struct stamp *s)
+{
+	return ((timer_now() - s->ms) & 0xFFFFFFU) >= STALE_MS;
+}
+
+static struct photon_app *
+photon_lookup(void)
+{
+	const char *name = photon_depth ? photon_stack[photon_depth - 1] : "Main menu";
+	unsigned int i;
+
+	for (i = 0; i < PHOTON_APPS; i++) {
+		struct photon_app *a = &photon_apps[i];
+
+		if (a->name == name)
+			return a;
+		if (a->name == NULL) {
+			a->name = name;
+			return a;
+		}
+	}
+	return NULL;
+}
+
+void
+photon_enter(const char *app)
+{
+	if (photon_depth < PHOTON_DEPTH)
+		photon_stack[photon_depth] = app;
+	photon_depth += 1;
+}
+
+void
+photon_leave(void)
+{
+	photon_depth -= 1;
+}
+
+/* from the GPIO interrupt */
+void
+photon_press(unsigned int btn)
+{
+	if (photon_state != IDLE && !stale(&t_irq))
+		return;
+
+	stamp(&t_irq);
+	photon_btn = btn;
+	photon_waited = 0;
+	photon_state = PRESSED;
+}
+
+void
+photon_posted(unsigned int btn, uint8_t type)
+{
+	if (photon_state != PRESSED || btn != photon_btn)
+		return;
+
+	if (type == 0) {
+		photon_state = IDLE;
+		return;
+	}
+	photon_type = type;
+	photon_state = POSTED;
+}
+
+void
+photon_dequeued(uint8_t type)
+{
+	if (photon_state != POSTED || type != photon_type)
+		return;
+
+	stamp(&t_deq);
+	photon_cur = photon_lookup();
+	photon_state = DEQUEUED;
+}
+
+void
+photon_wait_begin(void)
+{
+	if (photon_state == DEQUEUED)
+		stamp(&t_wait);
+}
+
+void
+photon_wait_end(void)
+{
+	struct stamp now;
+
+	if (photon_state != DEQUEUED)
+		return;
+
+	stamp(&now);
+	photon_waited += elapsed_us(&t_wait, &now);
+}
+
+void
+photon_draw(void)
+{
+	if (photon_state != DEQUEUED)
+		return;
+
+	stamp(&t_draw);
+	photon_state = DRAWING;
+}
+
+void
+photon_poll(void)
+{
+	struct photon_app *a = photon_cur;
+	struct stamp now;
+	uint32_t total;
+	uint32_t app;
+	unsigned int i;
+
+	if (photon_state == DEQUEUED && stale(&t_deq))
+		photon_state = IDLE;
+	if (photon_state != DRAWING)
+		return;
+	photon_state = IDLE;
+	if (a == NULL)
+		return;
+
+	stamp(&now);
+	total = elapsed_us(&t_irq, &now);
+	app = elapsed_us(&t_deq, &t_draw);
+	app = (app > photon_waited) ? app - photon_waited : 0;
+
+	a->presses += 1;
+	a->queue_us += elapsed_us(&t_irq, &t_deq);
+	a->wait_us += photon_waited;
+	a->app_us += app;
+	a->draw_us += elapsed_us(&t_draw, &now);
+	if (total > a->max_us)
+		a->max_us = total;
+	for (i = 0; i < PHOTON_BUCKETS - 1; i++) {
+		if (total < photon_limit[i] * 1000U)
+			break;
+	}
+	a->bucket[i] += 1;
+}
+
+enum events {
+	EV_EXIT = 1,
+	EV_RESET,
+	EV_PREV,
+	EV_NEXT,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_CENTER] = { .press = EV_RESET, },
+	[BTN_UP]     = { .press = EV_PREV, },
+	[BTN_DOWN]   = { .press = EV_NEXT, },
+};
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+show_ms(unsigned int line, const char *label, uint32_t us)
+{
+	char buf[32];
+
+	sprintf(buf, "%-8s%6lu.%lu ms", label,
+			(unsigned long)(us / 1000),
+			(unsigned long)(us / 100 % 10));
+	show(line, buf);
+}
+
+static void
+photon_render(unsigned int page)
+{
+	static const char *const label[PHOTON_BUCKETS] = {
+		"<10", "<20", "<50", "<100", "<200", "more",
+	};
+	struct photon_app a = photon_apps[page];
+	uint32_t n = a.presses ? a.presses : 1;
+	char buf[32];
+	unsigned int i;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	if (a.name == NULL) {
+		show(0, "No presses yet");
+		return;
+	}
+	show(0, a.name);
+	sprintf(buf, "%lu presses", (unsigned long)a.presses);
+	show(1, buf);
+	show_ms(2, "queue", a.queue_us / n);
+	show_ms(3, "release", a.wait_us / n);
+	show_ms(4, "app", a.app_us / n);
+	show_ms(5, "draw", a.draw_us / n);
+	show_ms(6, "max", a.max_us);
+	for (i = 0; i < PHOTON_BUCKETS; i += 2) {
+		sprintf(buf, "%-4s%5u %-4s%5u",
+				label[i], a.bucket[i],
+				label[i + 1], a.bucket[i + 1]);
+		show(7 + i / 2, buf);
+	}
+}
+
+void
+photonview(void)
+{
+	unsigned int page = 0;
+
+	buttons_config(buttons);
+	while (1) {
+		unsigned int pages;
+
+		for (pages = 1; pages < PHOTON_APPS; pages++) {
+			if (photon_apps[pages].name == NULL)
+				break;
+		}
+		photon_render(page);
+
+		switch ((enum events)event_wait()) {
+		case EV_EXIT:
+			return;
+		case EV_RESET:
+			memset(photon_apps, 0, sizeof(photon_apps));
+			page = 0;
+			break;
+		case EV_PREV:
+			page = (page + pages - 1) % pages;
+			break;
+		case EV_NEXT:
+			page = (page + 1) % pages;
+			break;
+		}
+	}
+}
+#endif
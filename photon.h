@@ -0,0 +1,88 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PHOTON_H
+#define _PHOTON_H
+
+#include <stdint.h>
+
+/*
+ * Input to photon latency. Build with -DPHOTON=1 to
+ * follow button presses from the GPIO interrupt until
+ * what they caused has been sent to the display, and
+ * to get the "Input latency" screen. Otherwise all of
+ * this compiles to nothing.
+ *
+ * One press is followed at a time through
+ *
+ *   irq     button_irq() sees the pin fall
+ *   dequeue event_poll() hands out the press event
+ *   draw    dp__setbox() starts the first transfer
+ *   done    the app polls for events again
+ *
+ * and the time spent in buttons_config() waiting for
+ * the button to be let go is taken out of the app's
+ * share. Drawing is synchronous, so by the time the app
+ * asks for the next event the transfer has ended.
+ *
+ * Presses are counted against the app handling the
+ * event, which menu() sets with photon_enter() and
+ * photon_leave() around running an entry.
+ */
+#ifndef PHOTON
+#define PHOTON 0
+#endif
+
+#define PHOTON_APPS    8
+#define PHOTON_BUCKETS 6 /* below 10, 20, 50, 100, 200ms and the rest */
+
+struct photon_app {
+	const char *name;
+	uint32_t presses;
+	uint32_t max_us;
+	/* sums over all presses */
+	uint32_t queue_us;
+	uint32_t wait_us;
+	uint32_t app_us;
+	uint32_t draw_us;
+	uint16_t bucket[PHOTON_BUCKETS];
+};
+
+#if PHOTON
+void photon_enter(const char *app);
+void photon_leave(void);
+void photon_press(unsigned int btn);
+void photon_posted(unsigned int btn, uint8_t type);
+void photon_poll(void);
+void photon_dequeued(uint8_t type);
+void photon_wait_begin(void);
+void photon_wait_end(void);
+void photon_draw(void);
+#else
+#define photon_enter(app)         do { } while (0)
+#define photon_leave()            do { } while (0)
+#define photon_press(btn)         do { } while (0)
+#define photon_posted(btn, type)  do { } while (0)
+#define photon_poll()             do { } while (0)
+#define photon_dequeued(type)     do { } while (0)
+#define photon_wait_begin()       do { } while (0)
+#define photon_wait_end()         do { } while (0)
+#define photon_draw()             do { } while (0)
+#endif
+
+#endif
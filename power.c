@@ -16,6 +16,10 @@
  * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "geckonator/clock.h"
 #include "geckonator/gpio.h"
 #include "geckonator/emu.h"
 
@@ -24,8 +28,60 @@
 #include "buttons.h"
 #include "display.h"
 #include "sdcard.h"
+#include "speed.h"
 #include "power.h"
 
+static bool power_deep;
+
+/* 48MHz / 2 ushfrco as core clock */
+void
+power_hfclk(void)
+{
+	clock_ushfrco_48mhz_div2();
+	clock_ushfrco_enable();
+	while (!clock_ushfrco_ready())
+		/* wait */;
+	clock_hfclk_select_ushfrco();
+	while (!clock_ushfrco_selected())
+		/* wait */;
+	clock_hfrco_disable();
+}
+
+/*
+ * Let power_sleep() go down to EM2. Only the rtc,
+ * gpio interrupts and other low energy peripherals
+ * keep running there, so only allow it while no
+ * usart or timer is in use.
+ */
+void
+power_em2(bool allow)
+{
+	power_deep = allow;
+}
+
+/*
+ * Call with interrupts disabled. We come back
+ * from EM2 running on the hfrco, so switch back
+ * before any interrupt handler gets to run.
+ */
+void
+power_sleep(void)
+{
+	if (!power_deep) {
+		speed_sleep(false);
+		__WFI();
+		speed_wake();
+		return;
+	}
+
+	speed_sleep(true);
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	__WFI();
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+	power_hfclk();
+	speed_wake();
+}
+
 void __noreturn
 power_off(void)
 {
@@ -19,6 +19,9 @@
 #ifndef _POWER_H
 #define _POWER_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "geckonator/gpio.h"
 
 static inline uint32_t
@@ -27,6 +30,9 @@ power_pressed(void)
 	return !gpio_in(GPIO_PC4);
 }
 
+void power_hfclk(void);
+void power_em2(bool allow);
+void power_sleep(void);
 void power_off(void);
 
 #endif
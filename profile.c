@@ -0,0 +1,188 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "geckonator/clock.h"
+
+#include "speed.h"
+#include "latency.h"
+#include "profile.h"
+
+/*
+ * TIMER0 runs at CORE_HZ / 16 = 1.5MHz. PROFILE_HZ is
+ * picked not to divide the 1kHz RTC so we don't keep
+ * sampling the same spot of the timer interrupt.
+ */
+#define PROFILE_TOP    (CORE_HZ / 16U / PROFILE_HZ - 1U)
+#define PROFILE_PROBES 16
+
+/*
+ * Keys are PC / 2, which fits 15 bits for the 64kB of
+ * flash. Code in RAM sets the top bit. 0 is the vector
+ * table, so it marks an empty slot.
+ */
+#define KEY_RAM 0x8000U
+
+struct slot {
+	uint16_t key;
+	uint16_t count;
+};
+
+/*
+ * Not from the arena like other app state: sampling goes on
+ * while other apps run and take the arena for themselves.
+ */
+static struct slot profile_tab[PROFILE_SLOTS];
+static uint32_t profile_samples;
+static uint32_t profile_dropped;
+static uint16_t profile_pcs;
+static bool profile_on;
+
+static void __used
+profile_sample(uint32_t pc)
+{
+	unsigned int key = (pc >> 1) & 0x7FFFU;
+	unsigned int h;
+	unsigned int i;
+
+	TIMER0->IFC = TIMER_IF_OF;
+
+	if (pc >= 0x20000000U)
+		key |= KEY_RAM;
+	h = (key * 0x9E37U) >> 8;
+
+	profile_samples += 1;
+	for (i = 0; i < PROFILE_PROBES; i++) {
+		struct slot *s = &profile_tab[(h + i) & (PROFILE_SLOTS - 1)];
+
+		if (s->key == key) {
+			if (s->count < 0xFFFFU)
+				s->count += 1;
+			return;
+		}
+		if (s->key == 0) {
+			s->key = key;
+			s->count = 1;
+			profile_pcs += 1;
+			return;
+		}
+	}
+	profile_dropped += 1;
+}
+
+#ifdef __arm__
+/*
+ * Everything runs on the main stack, so the interrupted
+ * PC is in the exception frame right at msp + 24. Tail
+ * call profile_sample() with it, which then returns from
+ * the exception for us.
+ */
+void __attribute__((naked))
+TIMER0_IRQHandler(void)
+{
+	__asm__ volatile (
+		"mrs r0, msp\n\t"
+		"ldr r0, [r0, #24]\n\t"
+		"ldr r1, =profile_sample\n\t"
+		"bx  r1\n\t"
+		".ltorg\n\t"
+	);
+}
+#else
+/* no exception frame to look at in the host simulator */
+void
+TIMER0_IRQHandler(void)
+{
+	profile_sample(0);
+}
+#endif
+
+void
+profile_start(void)
+{
+	profile_stop();
+
+	memset(profile_tab, 0, sizeof(profile_tab));
+	profile_samples = 0;
+	profile_dropped = 0;
+	profile_pcs = 0;
+
+	clock_timer0_enable();
+	TIMER0->CTRL = TIMER_CTRL_PRESC_DIV16 | TIMER_CTRL_MODE_UP;
+	TIMER0->TOP = PROFILE_TOP;
+	TIMER0->CNT = 0;
+	TIMER0->IFC = ~0U;
+	TIMER0->IEN = TIMER_IEN_OF;
+	/* above everything so interrupt handlers get sampled too */
+	NVIC_SetPriority(TIMER0_IRQn, 0);
+	NVIC_EnableIRQ(TIMER0_IRQn);
+	TIMER0->CMD = TIMER_CMD_START;
+	speed_hold();
+	profile_on = true;
+}
+
+void
+profile_stop(void)
+{
+	if (!profile_on)
+		return;
+
+	NVIC_DisableIRQ(TIMER0_IRQn);
+	TIMER0->CMD = TIMER_CMD_STOP;
+	TIMER0->IEN = 0;
+	clock_timer0_disable();
+	speed_release();
+	profile_on = false;
+}
+
+bool
+profile_running(void)
+{
+	return profile_on;
+}
+
+void
+profile_stats(struct profile_stats *st)
+{
+	irq_off();
+	st->samples = profile_samples;
+	st->dropped = profile_dropped;
+	st->pcs = profile_pcs;
+	irq_on();
+}
+
+uint32_t
+profile_slot(unsigned int i, uint32_t *pc)
+{
+	struct slot s;
+
+	irq_off();
+	s = profile_tab[i];
+	irq_on();
+
+	if (s.key == 0)
+		return 0;
+	if (s.key & KEY_RAM)
+		*pc = 0x20000000U | ((s.key & ~KEY_RAM) << 1);
+	else
+		*pc = s.key << 1;
+	return s.count;
+}
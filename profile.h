@@ -0,0 +1,57 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Statistical profiler. The M0+ has no cycle counter
+ * to speak of, so instead TIMER0 interrupts about a
+ * thousand times a second and counts the PC it
+ * interrupted in a small hash table in RAM.
+ *
+ * Code running with interrupts off is charged to the
+ * instruction that turns them back on, and time spent
+ * sleeping in EM1 shows up on the wfi. EM2 stops the
+ * timer, so deep sleep isn't sampled at all.
+ *
+ * Samples are kept as exact PCs, so symbolizing them
+ * against the ELF with host/profsym is left to the host.
+ * When the table fills up new PCs are only counted as
+ * dropped.
+ */
+#define PROFILE_SLOTS 256
+#define PROFILE_HZ    985
+
+struct profile_stats {
+	uint32_t samples;
+	uint32_t dropped;
+	uint16_t pcs;     /* distinct PCs seen */
+};
+
+void profile_start(void);
+void profile_stop(void);
+bool profile_running(void);
+void profile_stats(struct profile_stats *st);
+/* returns the samples in slot i and its PC, 0 if empty */
+uint32_t profile_slot(unsigned int i, uint32_t *pc);
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "menu.h"
+#include "sdcard.h"
+#include "ff.h"
+#include "arena.h"
+#include "profile.h"
+
+/*
+ * Start the sampling profiler, go use whatever is slow
+ * and come back here to stop it. The samples are written
+ * to PROFILE_FILE on the card as lines of
+ *
+ *   PC COUNT
+ *
+ * in hex and decimal, which host/profsym turns into a
+ * flat profile with the ELF of the same build.
+ */
+
+#define FG444 0xCB0
+#define BG444 0x000
+
+#define PROFILE_FILE "PROFILE.TXT"
+#define TOP_LINES    4
+
+enum events {
+	EV_EXIT = 1,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static FRESULT
+profiler_write(const struct profile_stats *st)
+{
+	char buf[64];
+	FIL f;
+	FRESULT res;
+	unsigned int i;
+	UINT len;
+
+	res = f_open(&f, PROFILE_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+	if (res != FR_OK)
+		return res;
+
+	len = sprintf(buf, "# %lu samples at %u Hz, %u pcs, %lu dropped\r\n",
+			(unsigned long)st->samples, PROFILE_HZ,
+			st->pcs, (unsigned long)st->dropped);
+	res = f_write(&f, buf, len, &len);
+
+	for (i = 0; res == FR_OK && i < PROFILE_SLOTS; i++) {
+		uint32_t pc;
+		uint32_t count = profile_slot(i, &pc);
+
+		if (count == 0)
+			continue;
+		len = sprintf(buf, "%08lx %lu\r\n",
+				(unsigned long)pc, (unsigned long)count);
+		res = f_write(&f, buf, len, &len);
+	}
+
+	if (res != FR_OK) {
+		f_close(&f);
+		return res;
+	}
+	return f_close(&f);
+}
+
+/* the hottest PCs, so there's something to look at right away */
+static void
+profiler_top(const struct profile_stats *st, char *buf)
+{
+	unsigned int taken[TOP_LINES];
+	unsigned int line;
+
+	if (st->samples == 0)
+		return;
+
+	for (line = 0; line < TOP_LINES; line++) {
+		uint32_t best = 0;
+		uint32_t best_pc = 0;
+		unsigned int i, j;
+
+		for (i = 0; i < PROFILE_SLOTS; i++) {
+			uint32_t pc;
+			uint32_t count = profile_slot(i, &pc);
+
+			if (count <= best)
+				continue;
+			for (j = 0; j < line && taken[j] != i; j++)
+				/* search */;
+			if (j < line)
+				continue;
+			best = count;
+			best_pc = pc;
+			taken[line] = i;
+		}
+		if (best == 0)
+			break;
+		sprintf(buf, "%08lx %3lu%%", (unsigned long)best_pc,
+				(unsigned long)(best * 100 / st->samples));
+		show(5 + line, buf);
+	}
+}
+
+static void
+profiler_start(void)
+{
+	char buf[24];
+
+	dp_fill(0, 0, 240, 240, BG444);
+	profile_start();
+	sprintf(buf, "Sampling at %u Hz", PROFILE_HZ);
+	show(0, buf);
+	show(2, "Go do something");
+	show(3, "slow, then come");
+	show(4, "back and stop.");
+
+	buttons_config(buttons);
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+}
+
+static void
+profiler_stop(void)
+{
+	struct profile_stats st;
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	FRESULT res = FR_NOT_ENOUGH_CORE;
+	char buf[24];
+
+	profile_stop();
+	profile_stats(&st);
+
+	dp_fill(0, 0, 240, 240, BG444);
+	sprintf(buf, "%lu samples", (unsigned long)st.samples);
+	show(0, buf);
+	sprintf(buf, "%u PCs", st.pcs);
+	show(1, buf);
+	sprintf(buf, "%lu dropped", (unsigned long)st.dropped);
+	show(2, buf);
+
+	sd_init();
+	if (fs)
+		res = f_mount(fs, "", 1);
+	if (res == FR_OK)
+		res = profiler_write(&st);
+	sd_uninit();
+	if (res == FR_OK)
+		show(3, "Saved " PROFILE_FILE);
+	else {
+		sprintf(buf, "SD error: %u", res);
+		show(3, buf);
+	}
+
+	profiler_top(&st, buf);
+
+	buttons_config(buttons);
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+}
+
+void
+profiler(void)
+{
+	static const struct menuitem profiler_menu[] = {
+		{ .label = "Start sampling", .cb = profiler_start, },
+		{ .label = "Stop and save",  .cb = profiler_stop, },
+	};
+
+	menu(profiler_menu, ARRAY_SIZE(profiler_menu), FG444, BG444);
+}
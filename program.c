@@ -11,7 +11,7 @@
 #define FG444 0xCB0
 #define BG444 0x000
 
-struct event {
+struct program_event {
 	const char **lines;
 	size_t len;
 };
@@ -34,7 +34,7 @@ static const struct button_config buttons[BTN_MAX] = {
 };
 
 static void
-render(const struct event *e)
+render(const struct program_event *e)
 {
 	unsigned int y = 0;
 	unsigned int i;
@@ -55,7 +55,7 @@ render(const struct event *e)
 }
 
 static void
-browse_day(const char *name, const struct event *day, size_t len)
+browse_day(const char *name, const struct program_event *day, size_t len)
 {
 	unsigned int i = 0;
 
@@ -0,0 +1,38 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ramfunc.h"
+
+#if RAMFUNC
+bool ramfunc_flash;
+#endif
+
+const uint16_t ramfunc_budget[RAMFUNC_MAX] = {
+#define RAMFUNC_BUDGET(fn, budget) [RAMFUNC_##fn] = budget,
+	RAMFUNCS(RAMFUNC_BUDGET)
+#undef RAMFUNC_BUDGET
+};
+
+#if RAMFUNC && defined(__arm__)
+/* absolute symbols for host/ramcheck, they take no space */
+#define RAMFUNC_SYMBOL(fn, budget) \
+	__asm__(".globl __ramfunc_budget_" #fn "\n" \
+		".set __ramfunc_budget_" #fn ", " #budget);
+RAMFUNCS(RAMFUNC_SYMBOL)
+#undef RAMFUNC_SYMBOL
+#endif
@@ -0,0 +1,94 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RAMFUNC_H
+#define _RAMFUNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Hot loops run from RAM. At 24MHz every flash fetch
+ * costs a wait state, RAM has none. A function marked
+ * __ramfunc goes in .data, so the startup code copies it
+ * to RAM with the rest of the initialised data, and is
+ * always called through a register since RAM is out of
+ * reach of a bl from flash.
+ *
+ * Every RAM function is listed in RAMFUNCS below with
+ * the most bytes of RAM it may take. host/ramcheck holds
+ * the ELF to that. The body is written once, inlined into
+ * the RAM copy and a flash copy, and RAMFUNC_CALL() picks
+ * between them so Benchmarks can compare the two.
+ *
+ * Build with -DRAMFUNC=0 to keep everything in flash.
+ * Anything a RAM function calls must be inlined into it,
+ * or it runs from flash again.
+ */
+#ifndef RAMFUNC
+#define RAMFUNC 1
+#endif
+
+#define RAMFUNCS(X) \
+	X(dp__fill_pixels,     64) \
+	X(dp__putchar_pixels, 160) \
+	X(dp__cimage_pixels,  320) \
+	X(sd__rxblock,         48)
+
+enum ramfunc_id {
+#define RAMFUNC_ENUM(fn, budget) RAMFUNC_##fn,
+	RAMFUNCS(RAMFUNC_ENUM)
+#undef RAMFUNC_ENUM
+	RAMFUNC_MAX,
+};
+
+#if RAMFUNC && defined(__arm__)
+/*
+ * The section flags are spelled out as those of .data,
+ * and the @ turns the "ax" gcc adds for code into a
+ * comment, or gas warns about every RAM function.
+ */
+#define __ramfunc __attribute__((section(".data.ramfunc,\"aw\",%progbits @"), \
+			noinline, long_call))
+#else
+#define __ramfunc __attribute__((noinline))
+#endif
+
+/* for the body and everything it calls */
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+
+#if RAMFUNC
+/* run the flash copies instead */
+extern bool ramfunc_flash;
+
+#define RAMFUNC_DEFINE(fn, params, args) \
+	static void __attribute__((noinline)) fn##_flash params { fn##_body args; } \
+	static void __ramfunc fn params { fn##_body args; }
+#define RAMFUNC_CALL(fn, ...) \
+	(ramfunc_flash ? fn##_flash(__VA_ARGS__) : fn(__VA_ARGS__))
+#else
+#define RAMFUNC_DEFINE(fn, params, args) \
+	static void __attribute__((noinline)) fn params { fn##_body args; }
+#define RAMFUNC_CALL(fn, ...) fn(__VA_ARGS__)
+#endif
+
+extern const uint16_t ramfunc_budget[RAMFUNC_MAX];
+
+#endif
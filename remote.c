@@ -0,0 +1,111 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "cir.h"
+#include "cirrx.h"
+
+/*
+ * Point a TV remote at the badge and
+ * see what it sends.
+ */
+
+#define FG444 0x0C8
+#define BG444 0x000
+
+enum events {
+	EV_EXIT = 1,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+show_stats(char *buf)
+{
+	struct cirrx_stats st;
+
+	cirrx_stats(&st);
+	sprintf(buf, "Frames  %lu", (unsigned long)st.frames);
+	show(6, buf);
+	sprintf(buf, "Unknown %lu", (unsigned long)st.unknown);
+	show(7, buf);
+}
+
+void
+remote(void)
+{
+	unsigned long repeats = 0;
+	char buf[24];
+
+	dp_fill(0, 0, 240, 240, BG444);
+	show(0, "Press a key on");
+	show(1, "a remote");
+	buttons_config(buttons);
+
+	cirrx_init();
+
+	while (1) {
+		struct event ev;
+		struct cir_code code;
+
+		event_pend(&ev);
+		switch (ev.type) {
+		case EV_EXIT:
+			cirrx_uninit();
+			return;
+		case EV_CIR_KEY:
+			cirrx_last(&code);
+			repeats = 0;
+			sprintf(buf, "%s%s", cir_name(code.protocol),
+					(code.flags & CIR_TOGGLE) ? " T" : "");
+			show(0, buf);
+			sprintf(buf, "Address 0x%02X", code.address);
+			show(1, buf);
+			sprintf(buf, "Command 0x%02X", code.command);
+			show(2, buf);
+			show(3, "");
+			break;
+		case EV_CIR_REPEAT:
+			repeats += ev.arg;
+			sprintf(buf, "Repeat  %lu", repeats);
+			show(3, buf);
+			break;
+		default:
+			continue;
+		}
+		show_stats(buf);
+	}
+}
@@ -19,9 +19,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "bus.h"
 #include "sdcard.h"
+#include "cycles.h"
+#include "ramfunc.h"
+#include "speed.h"
+#include "crc16.h"
 
-#include "geckonator/clock.h"
 #include "geckonator/gpio.h"
 #include "geckonator/usart0.h"
 
@@ -36,6 +40,8 @@
 
 #define SD_TRIES (1 << 15)
 
+#define SD_ECRC 0x83 /* data crc mismatch */
+
 #if 0
 #include <stdio.h>
 #define debug(...) printf(__VA_ARGS__)
@@ -44,31 +50,31 @@
 #endif
 
 static bool block_addressing;
+static bool sd_awake; /* woken up and at sd_clockdiv_run */
+static uint32_t sd_clockdiv = SD_CLOCKDIV_INIT;
+static uint32_t sd_clockdiv_run = SD_CLOCKDIV_RUN;
 
-void
-sd_init(void)
+static void
+sd_clock(uint32_t div)
 {
-	gpio_set(SD_CD);
-	gpio_set(SD_CLK);
-	gpio_set(SD_CS);
-	gpio_set(SD_MOSI);
-	gpio_set(SD_MISO);
-	gpio_mode(SD_CD,   GPIO_MODE_INPUT);
-	gpio_mode(SD_CLK,  GPIO_MODE_PUSHPULL);
-	gpio_mode(SD_CS,   GPIO_MODE_WIREDAND);
-	gpio_mode(SD_MISO, GPIO_MODE_INPUTPULL);
-	gpio_mode(SD_MOSI, GPIO_MODE_PUSHPULL);
+	sd_clockdiv = div;
+	usart0_clock_div(speed_div(div));
+}
 
-	clock_usart0_enable();
+static void
+sd_attach(void)
+{
 	/* location4:
 	 * clk -> PB13 -> SD_CLK
 	 * cs  -> PB14 -> SD_CS
 	 * rx  -> PB8  -> SD_MISO
 	 * tx  -> PB7  -> SD_MOSI
 	 */
+	usart0_irda_config(0);
 	usart0_config(USART_CTRL_MSBF
 			| USART_CTRL_SYNC);
 	usart0_frame_bits(8);
+	usart0_clock_div(speed_div(sd_clockdiv));
 	usart0_master_enable();
 	usart0_tx_enable();
 	usart0_pins(USART_ROUTE_LOCATION_LOC4
@@ -78,17 +84,80 @@ sd_init(void)
 			| USART_ROUTE_RXPEN);
 }
 
+/* called by speed.c when the core clock changes */
 void
-sd_uninit(void)
+sd_clock_update(void)
 {
-	usart0_tx_enable();
+	if (bus_attached(BUS_SD))
+		usart0_clock_div(speed_div(sd_clockdiv));
+}
+
+/* the clock used once the card is awake */
+uint32_t
+sd_clock_get(void)
+{
+	return sd_clockdiv_run;
+}
+
+/*
+ * Set the clock used once the card is awake, see
+ * spitune.c. Takes effect at once if it is, and
+ * otherwise when sd_wakeup() next succeeds.
+ */
+void
+sd_clock_run(uint32_t div)
+{
+	sd_clockdiv_run = div;
+	if (!sd_awake)
+		return;
+	sd_clockdiv = div;
+	sd_clock_update();
+}
+
+/* every transfer waits for the usart, so nothing is in flight */
+static void
+sd_detach(void)
+{
+	usart0_rxtx_disable();
 	usart0_pins(0);
+}
+
+static const struct bus_client sd_client = {
+	.attach = sd_attach,
+	.detach = sd_detach,
+};
+
+/*
+ * The pins stay put while IR borrows the usart,
+ * so the card stays deselected with CS high.
+ */
+void
+sd_init(void)
+{
+	gpio_set(SD_CD);
+	gpio_set(SD_CLK);
+	gpio_set(SD_CS);
+	gpio_set(SD_MOSI);
+	gpio_set(SD_MISO);
+	gpio_mode(SD_CD,   GPIO_MODE_INPUT);
+	gpio_mode(SD_CLK,  GPIO_MODE_PUSHPULL);
+	gpio_mode(SD_CS,   GPIO_MODE_WIREDAND);
+	gpio_mode(SD_MISO, GPIO_MODE_INPUTPULL);
+	gpio_mode(SD_MOSI, GPIO_MODE_PUSHPULL);
+
+	bus_enable(BUS_SD, &sd_client);
+}
+
+void
+sd_uninit(void)
+{
+	sd_awake = false;
+	bus_disable(BUS_SD);
 	gpio_mode(SD_CD,   GPIO_MODE_DISABLED);
 	gpio_mode(SD_CLK,  GPIO_MODE_DISABLED);
 	gpio_mode(SD_CS,   GPIO_MODE_DISABLED);
 	gpio_mode(SD_MISO, GPIO_MODE_DISABLED);
 	gpio_mode(SD_MOSI, GPIO_MODE_DISABLED);
-	clock_usart0_disable();
 }
 
 static uint8_t
@@ -99,6 +168,18 @@ sd__getbyte(void)
 	return usart0_rxdata();
 }
 
+static __always_inline void
+sd__rxblock_body(uint8_t *buf, unsigned int len)
+{
+	for (; len > 0; len--) {
+		usart0_txdata(0xFF);
+		while (!usart0_rx_valid())
+			/* wait */;
+		*buf++ = usart0_rxdata();
+	}
+}
+RAMFUNC_DEFINE(sd__rxblock, (uint8_t *buf, unsigned int len), (buf, len))
+
 static uint8_t
 sd__cmd(const uint8_t cmd[6], uint8_t *response, unsigned int len)
 {
@@ -165,8 +246,9 @@ sd_wakeup(void)
 	const uint8_t cmd16[6]   = { 0x50, 0x00, 0x00, 0x02, 0x00, 0xFF };
 	uint8_t ret;
 
+	sd_awake = false;
 	block_addressing = false;
-	usart0_clock_div(SD_CLOCKDIV_INIT);
+	sd_clock(SD_CLOCKDIV_INIT);
 
 	gpio_clear(SD_CS);
 
@@ -260,7 +342,11 @@ out:
 	while (!usart0_tx_complete())
 		/* wait */;
 	gpio_set(SD_CS);
-	usart0_clock_div(SD_CLOCKDIV_RUN);
+	/* a card that didn't wake up stays at the init clock */
+	if (ret == 0x00) {
+		sd_awake = true;
+		sd_clock(sd_clockdiv_run);
+	}
 	return ret;
 }
 
@@ -272,10 +358,12 @@ sd_status(uint8_t *status)
 }
 
 static uint8_t
-sd__read(const uint8_t cmd[5], uint8_t *buf, unsigned int len)
+sd__read(const uint8_t cmd[5], uint8_t *buf, unsigned int len, uint16_t *crc)
 {
+	uint16_t c = 0;
 	unsigned int i;
 	uint8_t ret;
+	CYCLES_BEGIN(sd_read);
 
 	gpio_clear(SD_CS);
 
@@ -315,20 +403,20 @@ sd__read(const uint8_t cmd[5], uint8_t *buf, unsigned int len)
 		debug("data token: %02x\r\n", ret);
 		goto out;
 	}
-	for (; len > 0; len--) {
-		usart0_txdata(0xFF);
-		*buf++ = sd__getbyte();
-	}
+	RAMFUNC_CALL(sd__rxblock, buf, len);
 	for (i = 2; i > 0; i--) {
 		usart0_txdata(0xFF);
-		sd__getbyte();
+		c = (c << 8) | sd__getbyte();
 	}
+	if (crc)
+		*crc = c;
 	ret = 0x00;
 out:
 	usart0_rx_disable();
 	while (!usart0_tx_complete())
 		/* wait */;
 	gpio_set(SD_CS);
+	CYCLES_END(sd_read);
 	return ret;
 }
 
@@ -338,7 +426,7 @@ sd_getcsd(uint8_t csd[16])
 	const uint8_t cmd9[5] = { 0x49, 0x00, 0x00, 0x00, 0x00 };
 
 	debug("sd_getcsd(buf):\r\n");
-	return sd__read(cmd9, csd, 16);
+	return sd__read(cmd9, csd, 16, NULL);
 }
 
 uint8_t
@@ -347,7 +435,7 @@ sd_getcid(uint8_t cid[16])
 	const uint8_t cmd10[5] = { 0x4A, 0x00, 0x00, 0x00, 0x00 };
 
 	debug("sd_getcid(buf):\r\n");
-	return sd__read(cmd10, cid, 16);
+	return sd__read(cmd10, cid, 16, NULL);
 }
 
 uint8_t
@@ -412,8 +500,8 @@ sd_getblocks(uint32_t *blocks)
 	return ret;
 }
 
-uint8_t
-sd_readblock(uint32_t lba, uint8_t buf[512])
+static uint8_t
+sd__readblock(uint32_t lba, uint8_t buf[512], uint16_t *crc)
 {
 	uint8_t cmd17[5];
 
@@ -428,7 +516,30 @@ sd_readblock(uint32_t lba, uint8_t buf[512])
 	cmd17[1] = lba & 0xFF;
 	cmd17[0] = 0x51;
 
-	return sd__read(cmd17, buf, 512);
+	return sd__read(cmd17, buf, 512, crc);
+}
+
+uint8_t
+sd_readblock(uint32_t lba, uint8_t buf[512])
+{
+	return sd__readblock(lba, buf, NULL);
+}
+
+/*
+ * The card sends a crc with every data block even
+ * when crc checking is off. It's CRC-16/CCITT like
+ * the IR frames use, starting from 0.
+ */
+uint8_t
+sd_readblock_check(uint32_t lba, uint8_t buf[512])
+{
+	uint16_t crc;
+	uint8_t ret;
+
+	ret = sd__readblock(lba, buf, &crc);
+	if (ret == 0x00 && crc != crc16(0, buf, 512))
+		ret = SD_ECRC;
+	return ret;
 }
 
 uint8_t
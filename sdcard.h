@@ -23,6 +23,9 @@
 
 void sd_init(void);
 void sd_uninit(void);
+void sd_clock_update(void);
+uint32_t sd_clock_get(void);
+void sd_clock_run(uint32_t div);
 uint8_t sd_cmd(const uint8_t cmd[6], uint8_t *response, unsigned int len);
 uint8_t sd_wakeup(void);
 uint8_t sd_status(uint8_t *status);
@@ -30,6 +33,7 @@ uint8_t sd_getcsd(uint8_t csd[16]);
 uint8_t sd_getcid(uint8_t cid[16]);
 uint8_t sd_getblocks(uint32_t *blocks);
 uint8_t sd_readblock(uint32_t lba, uint8_t buf[512]);
+uint8_t sd_readblock_check(uint32_t lba, uint8_t buf[512]);
 uint8_t sd_writeblock(uint32_t lba, const uint8_t buf[512]);
 
 #endif
@@ -27,8 +27,11 @@
 #include "sdcard.h"
 #include "ff.h"
 #include "filepicker.h"
+#include "arena.h"
 
 
+#define PATH_LEN 255
+
 enum events {
 	EV_PUSH = 1,
 };
@@ -47,8 +50,12 @@ static const struct button_config anybutton[BTN_MAX] = {
 void
 showbmp(void)
 {
-	FATFS fs;
-	char path[255];
+	/* given back when menu() gets control again */
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	char *path = arena_alloc(PATH_LEN);
+
+	if (fs == NULL || path == NULL)
+		return;
 
 	/* init sdcard */
 	sd_init();
@@ -57,7 +64,7 @@ showbmp(void)
 		FRESULT res;
 
 		path[0] = '\0';
-		res = filepicker(&fs, path, ARRAY_SIZE(path), 0x888, 0x000);
+		res = filepicker(fs, path, PATH_LEN, 0x888, 0x000);
 		if (res == FR_NO_FILE)
 			break;
 
@@ -0,0 +1,230 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "sdcard.h"
+#include "latency.h"
+#include "speed.h"
+
+#define FG444 0x8F8
+#define BG444 0x000
+
+enum events {
+	EV_EXIT = 1,
+	EV_RESET,
+	EV_TICK,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_CENTER] = { .press = EV_RESET, },
+};
+
+static enum speed speed_cur = SPEED_FAST;
+static unsigned int speed_holds;
+static uint32_t speed_since;
+static struct speed_stats stats;
+static uint32_t speed_epoch;
+static uint32_t speed_epoch_at;
+
+static void
+speed_account(enum speed next)
+{
+	uint32_t now = timer_now();
+
+	stats.ms[speed_cur] += (now - speed_since) & 0xFFFFFFU;
+	speed_since = now;
+	speed_cur = next;
+}
+
+/* HFCLKDIV divides both the core and peripheral clocks */
+static void
+speed_clock(unsigned int shift)
+{
+	CMU->CTRL = (CMU->CTRL & ~_CMU_CTRL_HFCLKDIV_MASK)
+		| (((1U << shift) - 1U) << _CMU_CTRL_HFCLKDIV_SHIFT);
+	dp_clock_update();
+	sd_clock_update();
+	stats.switches += 1;
+	speed_epoch += 1;
+	speed_epoch_at = timer_cycles();
+}
+
+void
+speed_hold(void)
+{
+	speed_holds += 1;
+}
+
+void
+speed_release(void)
+{
+	if (speed_holds > 0)
+		speed_holds -= 1;
+}
+
+/* called by power_sleep() with interrupts disabled */
+void
+speed_sleep(bool deep)
+{
+	if (deep) {
+		speed_account(SPEED_EM2);
+		return;
+	}
+	if (SPEED_SLOW_SHIFT == 0 || speed_holds > 0)
+		return;
+	speed_account(SPEED_SLOW);
+	speed_clock(SPEED_SLOW_SHIFT);
+}
+
+void
+speed_wake(void)
+{
+	enum speed was = speed_cur;
+
+	if (was == SPEED_FAST)
+		return;
+	speed_account(SPEED_FAST);
+	if (was == SPEED_SLOW)
+		speed_clock(0);
+}
+
+/*
+ * A usart clock divider worked out for CORE_HZ, for the
+ * clock we run at now. It is rounded up to what the
+ * usart can do, so the baud rate never ends up higher.
+ */
+uint32_t
+speed_div(uint32_t div)
+{
+	if (speed_cur != SPEED_SLOW)
+		return div;
+
+	div = (div + 256U + (1U << SPEED_SLOW_SHIFT) - 1U) >> SPEED_SLOW_SHIFT;
+	if (div <= 256U)
+		return 0;
+	return (div - 256U + 63U) & ~63U;
+}
+
+uint32_t
+speed_switches(void)
+{
+	return speed_epoch;
+}
+
+uint32_t
+speed_switched_at(void)
+{
+	return speed_epoch_at;
+}
+
+void
+speed_stats(struct speed_stats *st)
+{
+	irq_off();
+	speed_account(speed_cur);
+	*st = stats;
+	irq_on();
+	st->holds = speed_holds;
+}
+
+void
+speed_stats_reset(void)
+{
+	irq_off();
+	memset(&stats, 0, sizeof(stats));
+	speed_since = timer_now();
+	irq_on();
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+speedview_render(void)
+{
+	struct speed_stats st;
+	uint64_t total = 0;
+	char buf[24];
+	unsigned int i;
+
+	speed_stats(&st);
+	for (i = 0; i < SPEED_MAX; i++)
+		total += st.ms[i];
+
+	show(0, "Clock residency");
+	for (i = 0; i < SPEED_MAX; i++) {
+		uint32_t pm = total ? st.ms[i] * 1000ULL / total : 0;
+
+		if (i == SPEED_EM2)
+			sprintf(buf, "EM2  ");
+		else
+			sprintf(buf, "%2luMHz", 24UL >> (i == SPEED_SLOW ? SPEED_SLOW_SHIFT : 0));
+		sprintf(buf + 5, " %3lu.%lu%% %5lus",
+				(unsigned long)(pm / 10), (unsigned long)(pm % 10),
+				(unsigned long)(st.ms[i] / 1000));
+		show(2 + i, buf);
+	}
+	sprintf(buf, "Switches %lu", (unsigned long)st.switches);
+	show(6, buf);
+	sprintf(buf, "Holds    %u", st.holds);
+	show(7, buf);
+}
+
+void
+speedview(void)
+{
+	struct ticker tick;
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	speedview_render();
+
+	ticker_start(&tick, 1000, EV_TICK);
+	while (1) {
+		switch ((enum events)event_wait()) {
+		case EV_EXIT:
+			ticker_stop(&tick);
+			return;
+		case EV_RESET:
+			speed_stats_reset();
+			/* fallthrough */
+		case EV_TICK:
+			speedview_render();
+			break;
+		}
+	}
+}
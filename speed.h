@@ -0,0 +1,75 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPEED_H
+#define _SPEED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Core clock scaling. The badge runs at 24MHz, which is
+ * as fast as this chip goes, and power_sleep() divides
+ * the clock by 1 << SPEED_SLOW_SHIFT while it waits in
+ * EM1. The display and SD card usart dividers are set
+ * again on every switch, so their SPI clocks only drop
+ * while nothing is using them.
+ *
+ * Timers and IR can't have the clock change under them,
+ * so they keep it at full speed between speed_hold() and
+ * speed_release(). Build with -DSPEED_SLOW_SHIFT=0 to
+ * never scale.
+ */
+#ifndef SPEED_SLOW_SHIFT
+#define SPEED_SLOW_SHIFT 3
+#endif
+
+/* the full core clock, SPEED_FAST */
+#define CORE_HZ 24000000U
+
+enum speed {
+	SPEED_FAST, /* 24MHz */
+	SPEED_SLOW, /* 24MHz >> SPEED_SLOW_SHIFT */
+	SPEED_EM2,  /* no high frequency clock at all */
+	SPEED_MAX,
+};
+
+struct speed_stats {
+	uint32_t switches;
+	uint32_t ms[SPEED_MAX];
+	unsigned int holds; /* right now */
+};
+
+void speed_hold(void);
+void speed_release(void);
+void speed_sleep(bool deep);
+void speed_wake(void);
+uint32_t speed_div(uint32_t div);
+/*
+ * SysTick counts core cycles, so cycle counts taken across
+ * a switch don't add up. speed_switches() never goes back,
+ * not even on speed_stats_reset(), so comparing it before
+ * and after tells if a count can be used.
+ * speed_switched_at() is timer_cycles() at the last switch.
+ */
+uint32_t speed_switches(void);
+uint32_t speed_switched_at(void);
+void speed_stats(struct speed_stats *st);
+void speed_stats_reset(void);
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "bus.h"
+#include "sdcard.h"
+#include "arena.h"
+#include "speed.h"
+#include "spitune.h"
+
+/*
+ * Steps the display and SD clocks up from a slow
+ * clock that should always work and keeps the fastest
+ * one that still gets every byte across. The display
+ * writes a pattern and reads it back with RAMRD, the
+ * card reads blocks and checks their crc.
+ *
+ * In synchronous mode the usart tops out at half the
+ * 24MHz peripheral clock, which is where the display
+ * write and SD clocks start out anyway. So on most
+ * badges this only confirms them, but a panel or card
+ * that can't keep up gets slowed down instead of
+ * garbling data. The display read clock starts at 6MHz
+ * and often goes higher.
+ *
+ * The result is saved to SPITUNE_FILE together with the
+ * unique id of the badge, and only loaded on that badge.
+ */
+
+#define FG444 0xFC8
+#define BG444 0x000
+
+#define SPITUNE_FILE  "SPITUNE.BIN"
+#define SPITUNE_MAGIC 0x54495053 /* "SPIT" */
+
+#define ROUNDS   8
+#define TEST_ROW (240 - ROUNDS)
+
+enum events {
+	EV_EXIT = 1,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+};
+
+struct spitune_file {
+	uint32_t magic;
+	uint32_t uid[2];
+	uint16_t dp_write;
+	uint16_t dp_read;
+	uint16_t sd_run;
+	uint16_t pad;
+};
+
+/* 24MHz / (2 * (1 + div/256)), slowest first */
+static const uint16_t spitune_divs[] = { 768, 512, 256, 0 };
+
+static bool
+spitune_known(uint32_t div)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(spitune_divs); i++) {
+		if (spitune_divs[i] == div)
+			return true;
+	}
+	return false;
+}
+
+static unsigned int
+spitune_khz(uint32_t div)
+{
+	return CORE_HZ / 2000U * 256 / (256 + div);
+}
+
+FRESULT
+spitune_load(void)
+{
+	FIL *f = arena_alloc(sizeof(*f));
+	struct spitune_file t;
+	FRESULT res;
+	UINT len;
+
+	if (f == NULL)
+		return FR_NOT_ENOUGH_CORE;
+
+	res = f_open(f, SPITUNE_FILE, FA_READ);
+	if (res != FR_OK)
+		return res;
+	res = f_read(f, &t, sizeof(t), &len);
+	f_close(f);
+	if (res != FR_OK)
+		return res;
+
+	if (len != sizeof(t) || t.magic != SPITUNE_MAGIC
+			|| t.uid[0] != DEVINFO->UNIQUEL
+			|| t.uid[1] != DEVINFO->UNIQUEH
+			|| !spitune_known(t.dp_write)
+			|| !spitune_known(t.dp_read)
+			|| !spitune_known(t.sd_run))
+		return FR_NO_FILE;
+
+	dp_clock_set(t.dp_write, t.dp_read);
+	sd_clock_run(t.sd_run);
+	return FR_OK;
+}
+
+static FRESULT
+spitune_save(const struct spitune_file *t)
+{
+	FIL *f = arena_alloc(sizeof(*f));
+	FRESULT res;
+	UINT len;
+
+	if (f == NULL)
+		return FR_NOT_ENOUGH_CORE;
+
+	res = f_open(f, SPITUNE_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+	if (res != FR_OK)
+		return res;
+	res = f_write(f, t, sizeof(*t), &len);
+	if (res != FR_OK) {
+		f_close(f);
+		return res;
+	}
+	return f_close(f);
+}
+
+static bool
+dp_stable(uint32_t write, uint32_t read)
+{
+	unsigned int i;
+
+	dp_clock_set(write, read);
+	for (i = 0; i < ROUNDS; i++) {
+		if (!dp_verify(TEST_ROW + i, i))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * The write clock is checked reading back at the
+ * slowest clock, then the read clock on top of the
+ * fastest good write clock.
+ */
+static bool
+spitune_dp(struct spitune_file *t)
+{
+	uint32_t write;
+	uint32_t read;
+	unsigned int i;
+
+	if (!dp_stable(spitune_divs[0], spitune_divs[0])) {
+		dp_clock_set(t->dp_write, t->dp_read);
+		return false;
+	}
+
+	write = spitune_divs[0];
+	for (i = 1; i < ARRAY_SIZE(spitune_divs); i++) {
+		if (!dp_stable(spitune_divs[i], spitune_divs[0]))
+			break;
+		write = spitune_divs[i];
+	}
+	read = spitune_divs[0];
+	for (i = 1; i < ARRAY_SIZE(spitune_divs); i++) {
+		if (!dp_stable(write, spitune_divs[i]))
+			break;
+		read = spitune_divs[i];
+	}
+
+	dp_clock_set(write, read);
+	t->dp_write = write;
+	t->dp_read = read;
+	return true;
+}
+
+static bool
+sd_stable(uint32_t div, uint8_t *buf)
+{
+	unsigned int i;
+
+	sd_clock_run(div);
+	for (i = 0; i < ROUNDS; i++) {
+		if (sd_readblock_check(i, buf) != 0x00)
+			return false;
+	}
+	return true;
+}
+
+/* call with the card awake and the bus held */
+static bool
+spitune_sd(struct spitune_file *t, uint8_t *buf)
+{
+	uint32_t div;
+	unsigned int i;
+
+	if (!sd_stable(spitune_divs[0], buf)) {
+		sd_clock_run(t->sd_run);
+		return false;
+	}
+
+	div = spitune_divs[0];
+	for (i = 1; i < ARRAY_SIZE(spitune_divs); i++) {
+		if (!sd_stable(spitune_divs[i], buf))
+			break;
+		div = spitune_divs[i];
+	}
+
+	sd_clock_run(div);
+	t->sd_run = div;
+	return true;
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+void
+spitune(void)
+{
+	FATFS *fs = arena_alloc(sizeof(*fs));
+	uint8_t *buf = arena_alloc(512);
+	struct spitune_file t;
+	FRESULT res = FR_NOT_ENOUGH_CORE;
+	uint32_t write;
+	uint32_t read;
+	char line[24];
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+
+	t.magic = SPITUNE_MAGIC;
+	t.uid[0] = DEVINFO->UNIQUEL;
+	t.uid[1] = DEVINFO->UNIQUEH;
+	dp_clock_get(&write, &read);
+	t.dp_write = write;
+	t.dp_read = read;
+	t.sd_run = sd_clock_get();
+	t.pad = 0;
+
+	show(0, "Tuning display..");
+	if (spitune_dp(&t)) {
+		sprintf(line, "Write %5ukHz", spitune_khz(t.dp_write));
+		show(1, line);
+		sprintf(line, "Read  %5ukHz", spitune_khz(t.dp_read));
+		show(2, line);
+	} else
+		show(1, "No readback");
+	dp_fill(0, TEST_ROW, 240, ROUNDS, BG444);
+	show(0, "Display");
+
+	show(4, "Tuning SD..");
+	sd_init();
+	if (fs && buf)
+		res = f_mount(fs, "", 1);
+	if (res == FR_OK) {
+		bool ok;
+
+		bus_acquire(BUS_SD);
+		ok = spitune_sd(&t, buf);
+		bus_release(BUS_SD);
+		if (ok) {
+			sprintf(line, "Read  %5ukHz", spitune_khz(t.sd_run));
+			show(5, line);
+		} else
+			show(5, "Bad crc");
+		res = spitune_save(&t);
+	}
+	sd_uninit();
+	show(4, "SD card");
+
+	if (res == FR_OK)
+		show(7, "Saved " SPITUNE_FILE);
+	else {
+		sprintf(line, "SD error: %u", res);
+		show(7, line);
+	}
+
+	while (event_wait() != EV_EXIT)
+		/* wait */;
+}
@@ -0,0 +1,31 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPITUNE_H
+#define _SPITUNE_H
+
+#include "ff.h"
+
+/*
+ * The fastest spi clocks the display and SD card on
+ * this badge have been seen to keep up with, as found
+ * by the SPI clocks app. Call with the card mounted.
+ */
+FRESULT spitune_load(void);
+
+#endif
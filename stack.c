@@ -0,0 +1,253 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "stack.h"
+#include "arena.h"
+
+#define FG444 0xCB0
+#define BG444 0x000
+
+#define PAINT      0xC5C5C5C5U
+#define RAM_START  0x20000000U
+#define MARK_DEPTH 4
+#define APP_LINES  6
+
+/* end of .bss, weak so a linker script without it just turns this off */
+extern uint32_t end[] __attribute__((weak));
+
+static uint32_t *stack_top;
+static uint32_t *stack_low;
+static uint32_t *mark_sp[MARK_DEPTH];
+static uint32_t *mark_low[MARK_DEPTH];
+static unsigned int marks;
+static struct stack_app stack_apps[STACK_APPS];
+
+static inline uint32_t *
+stack_pointer(void)
+{
+#ifdef __arm__
+	uint32_t *sp;
+
+	__asm__ volatile ("mov %0, sp" : "=r" (sp));
+	return sp;
+#else
+	return NULL;
+#endif
+}
+
+/* everything below our own frame is free */
+static void __attribute__((noinline))
+stack_paint(void)
+{
+	uint32_t *sp = stack_pointer();
+	uint32_t *p;
+
+	for (p = end; p < sp; p++)
+		*p = PAINT;
+}
+
+static uint32_t *
+stack_scan(void)
+{
+	uint32_t *p = end;
+
+	while (p < stack_top && *p == PAINT)
+		p++;
+	if (p < stack_low)
+		stack_low = p;
+	return p;
+}
+
+void
+stack_init(void)
+{
+#ifdef __arm__
+	if (end == NULL)
+		return;
+
+	/* the initial stack pointer is the first word of the vector table */
+	stack_top = *(uint32_t **)SCB->VTOR;
+	stack_low = stack_top;
+	stack_paint();
+#endif
+}
+
+void
+stack_mark(void)
+{
+	uint32_t *low;
+	unsigned int i;
+
+	if (stack_top == NULL)
+		return;
+
+	low = stack_scan();
+	for (i = 0; i < marks && i < MARK_DEPTH; i++) {
+		if (low < mark_low[i])
+			mark_low[i] = low;
+	}
+	if (marks < MARK_DEPTH) {
+		mark_sp[marks] = stack_pointer();
+		mark_low[marks] = mark_sp[marks];
+	}
+	marks += 1;
+	stack_paint();
+}
+
+void
+stack_record(const char *name)
+{
+	uint32_t *low;
+	uint32_t depth;
+	unsigned int i;
+
+	if (stack_top == NULL || marks == 0)
+		return;
+
+	marks -= 1;
+	if (marks >= MARK_DEPTH)
+		return;
+
+	low = stack_scan();
+	for (i = 0; i <= marks; i++) {
+		if (low < mark_low[i])
+			mark_low[i] = low;
+	}
+	depth = (mark_sp[marks] - mark_low[marks]) * sizeof(uint32_t);
+
+	for (i = 0; i < STACK_APPS; i++) {
+		struct stack_app *a = &stack_apps[i];
+
+		if (a->name == NULL)
+			a->name = name;
+		if (a->name != name)
+			continue;
+		if (depth > a->depth)
+			a->depth = depth;
+		break;
+	}
+}
+
+void
+stack_stats(struct stack_stats *st)
+{
+	if (stack_top == NULL) {
+		st->ram = st->stack = st->used = 0;
+		return;
+	}
+	stack_scan();
+	st->ram = (uintptr_t)end - RAM_START;
+	st->stack = (stack_top - end) * sizeof(uint32_t);
+	st->used = (stack_top - stack_low) * sizeof(uint32_t);
+}
+
+const struct stack_app *
+stack_app(unsigned int i)
+{
+	if (i >= STACK_APPS || stack_apps[i].name == NULL)
+		return NULL;
+	return &stack_apps[i];
+}
+
+enum events {
+	EV_EXIT = 1,
+	EV_UP,
+	EV_DOWN,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_UP]     = { .press = EV_UP, },
+	[BTN_DOWN]   = { .press = EV_DOWN, },
+};
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+static void
+stackview_render(unsigned int first)
+{
+	struct stack_stats st;
+	char buf[32];
+	unsigned int i;
+
+	stack_stats(&st);
+	dp_fill(0, 0, 240, 240, BG444);
+	if (st.stack == 0)
+		show(0, "No stack paint");
+	else {
+		sprintf(buf, "Static %6lu B", (unsigned long)st.ram);
+		show(0, buf);
+		sprintf(buf, "Stack  %6lu B", (unsigned long)st.stack);
+		show(1, buf);
+		sprintf(buf, "  used %6lu B", (unsigned long)st.used);
+		show(2, buf);
+	}
+	sprintf(buf, "Arena %4u of %4u", arena_peak(), ARENA_SIZE);
+	show(3, buf);
+
+	for (i = 0; i < APP_LINES; i++) {
+		const struct stack_app *a = stack_app(first + i);
+
+		if (a == NULL)
+			break;
+		sprintf(buf, "%-14.14s%5u", a->name, a->depth);
+		show(4 + i, buf);
+	}
+}
+
+void
+stackview(void)
+{
+	unsigned int first = 0;
+
+	buttons_config(buttons);
+	while (1) {
+		stackview_render(first);
+
+		switch (event_wait()) {
+		case EV_EXIT:
+			return;
+		case EV_UP:
+			if (first > 0)
+				first -= 1;
+			break;
+		case EV_DOWN:
+			if (stack_app(first + APP_LINES))
+				first += 1;
+			break;
+		}
+	}
+}
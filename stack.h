@@ -0,0 +1,56 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STACK_H
+#define _STACK_H
+
+#include <stdint.h>
+
+/*
+ * Stack watermarks. stack_init() paints the RAM between
+ * the end of .bss and the stack pointer, and the deepest
+ * the stack has been is where the paint stops.
+ *
+ * menu() calls stack_mark() before running an entry,
+ * which paints again below itself, and stack_record()
+ * afterwards to keep how deep the entry went. Marks
+ * nest, so submenus count towards their parent too.
+ *
+ * For the worst case, rather than the worst seen so far,
+ * build with STACKUSAGE=1 and run host/stackreport.
+ */
+#define STACK_APPS 16
+
+struct stack_app {
+	const char *name;
+	uint16_t depth; /* bytes below menu() */
+};
+
+struct stack_stats {
+	uint32_t ram;    /* .data and .bss */
+	uint32_t stack;  /* from the top of RAM to the end of .bss */
+	uint32_t used;   /* most ever used */
+};
+
+void stack_init(void);
+void stack_mark(void);
+void stack_record(const char *name);
+void stack_stats(struct stack_stats *st);
+const struct stack_app *stack_app(unsigned int i);
+
+#endif
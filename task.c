@@ -0,0 +1,146 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "latency.h"
+#include "task.h"
+
+static struct task *tasklist;
+static volatile bool woken;
+
+void
+task_start(struct task *t, task_fn *fn, const char *name)
+{
+	t->fn = fn;
+	t->name = name;
+	t->line = 0;
+	t->armed = false;
+	t->runs = 0;
+	t->cycles = 0;
+	t->next = tasklist;
+	tasklist = t;
+	task_wake(t);
+}
+
+void
+task_stop(struct task *t)
+{
+	struct task **p;
+
+	/* the timer may expire and unlink n under us */
+	irq_off();
+	if (t->armed)
+		timer_remove(&t->n);
+	t->armed = false;
+	irq_on();
+
+	for (p = &tasklist; *p; p = &(*p)->next) {
+		if (*p == t) {
+			*p = t->next;
+			break;
+		}
+	}
+}
+
+/* safe to call from interrupts and work callbacks */
+void
+task_wake(struct task *t)
+{
+	t->ready = true;
+	woken = true;
+}
+
+static void
+task_sleep_cb(struct timer_node *n)
+{
+	struct task *t = (struct task *)n;
+
+	t->armed = false;
+	task_wake(t);
+}
+
+void
+task_sleep(struct task *t, uint32_t ms)
+{
+	irq_off();
+	if (t->armed)
+		timer_remove(&t->n);
+	t->armed = true;
+	t->n.timeout = timer_now() + ms;
+	t->n.cb = task_sleep_cb;
+	timer_add(&t->n);
+	irq_on();
+}
+
+bool
+task_ready(void)
+{
+	return woken;
+}
+
+/*
+ * Run every ready task once. Returns true if
+ * anything ran, so the caller knows to check
+ * for new events before going to sleep.
+ */
+bool
+task_run(void)
+{
+	static bool running;
+	struct task *t;
+	struct task *next;
+	bool ret = false;
+
+	if (running || !woken)
+		return false;
+
+	running = true;
+	woken = false;
+	for (t = tasklist; t; t = next) {
+		uint32_t start;
+		int state;
+
+		next = t->next;
+		if (!t->ready)
+			continue;
+
+		t->ready = false;
+		start = timer_cycles();
+		state = t->fn(t);
+		t->cycles += timer_cycles_since(start);
+		t->runs += 1;
+		ret = true;
+
+		if (state == TASK_EXITED)
+			task_stop(t);
+	}
+	running = false;
+	return ret;
+}
+
+const struct task *
+task_list(void)
+{
+	return tasklist;
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TASK_H
+#define _TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "timer.h"
+
+/*
+ * Stackless background tasks. A task function is
+ * called again every time the task is woken and
+ * resumes where it last blocked, so local variables
+ * don't survive blocking. Keep state in a struct
+ * embedding struct task instead.
+ *
+ * Tasks run from event_pend() whenever the app in
+ * the foreground is waiting for events.
+ */
+
+struct task;
+
+typedef int task_fn(struct task *t);
+
+struct task {
+	struct timer_node n;
+	struct task *next;
+	task_fn *fn;
+	const char *name;
+	uint16_t line;
+	volatile bool ready;
+	volatile bool armed; /* n is in the timer list */
+	uint32_t runs;
+	uint32_t cycles;
+};
+
+enum {
+	TASK_BLOCKED,
+	TASK_EXITED,
+};
+
+#define TASK_BEGIN(t) switch ((t)->line) { case 0:
+#define TASK_END(t) } (t)->line = 0; return TASK_EXITED
+
+/* block until task_wake() is called */
+#define TASK_WAIT(t) do { \
+	(t)->line = __LINE__; return TASK_BLOCKED; case __LINE__:; \
+} while (0)
+
+/* block until woken with cond true */
+#define TASK_WAIT_UNTIL(t, cond) do { \
+	(t)->line = __LINE__; case __LINE__: \
+	if (!(cond)) return TASK_BLOCKED; \
+} while (0)
+
+#define TASK_YIELD(t) do { task_wake(t); TASK_WAIT(t); } while (0)
+#define TASK_SLEEP(t, ms) do { task_sleep(t, ms); TASK_WAIT(t); } while (0)
+
+void task_start(struct task *t, task_fn *fn, const char *name);
+void task_stop(struct task *t);
+void task_wake(struct task *t);
+void task_sleep(struct task *t, uint32_t ms);
+bool task_ready(void);
+bool task_run(void);
+const struct task *task_list(void);
+
+#endif
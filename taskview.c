@@ -0,0 +1,162 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "events.h"
+#include "buttons.h"
+#include "font.h"
+#include "display.h"
+#include "leds.h"
+#include "speed.h"
+#include "task.h"
+
+/*
+ * List the background tasks with how often they ran
+ * and how much of the CPU they took, over the last
+ * second and in total. The center button starts and
+ * stops a demo task blinking the green LED, which
+ * keeps going after leaving here until stopped again.
+ */
+
+#define FG444 0xCCF
+#define BG444 0x000
+
+#define CYCLES_PER_MS (CORE_HZ / 1000)
+#define TASK_LINES    4
+
+#define BLINK_MS      1000
+#define BLINK_ON_MS   20
+
+enum events {
+	EV_EXIT = 1,
+	EV_BLINK,
+	EV_TICK,
+};
+
+static const struct button_config buttons[BTN_MAX] = {
+	[BTN_SMID]   = { .delay = 500, .longpress = EV_EXIT, },
+	[BTN_LEFT]   = { .press = EV_EXIT, },
+	[BTN_CENTER] = { .press = EV_BLINK, },
+};
+
+static struct task heartbeat;
+static bool blinking;
+
+/* a short green blink now and then */
+static int
+blink_fn(struct task *t)
+{
+	TASK_BEGIN(t);
+	while (1) {
+		led2_on();
+		TASK_SLEEP(t, BLINK_ON_MS);
+		led2_off();
+		TASK_SLEEP(t, BLINK_MS - BLINK_ON_MS);
+	}
+	TASK_END(t);
+}
+
+static void
+blink_toggle(void)
+{
+	if (blinking) {
+		task_stop(&heartbeat);
+		led2_off();
+	} else
+		task_start(&heartbeat, blink_fn, "heartbeat");
+	blinking = !blinking;
+}
+
+static void
+show(unsigned int line, const char *str)
+{
+	unsigned int y = line * font.height;
+
+	dp_fill(0, y, 240, font.height, BG444);
+	dp_puts(0, y, FG444, BG444, str);
+}
+
+/* CPU use since the last call, and in total */
+static void
+taskview_render(uint32_t prev[TASK_LINES], uint32_t ms)
+{
+	const struct task *t = task_list();
+	unsigned int i;
+	char buf[24];
+
+	show(1, blinking ? "Center: stop blink" : "Center: start blink");
+	for (i = 0; i < TASK_LINES; i++) {
+		if (t == NULL) {
+			show(3 + 2 * i, "");
+			show(4 + 2 * i, "");
+			continue;
+		}
+		if (ms > 0) {
+			uint32_t pm = (t->cycles - prev[i]) / (CYCLES_PER_MS / 1000) / ms;
+
+			sprintf(buf, "%-14.14s%3lu.%lu%%", t->name,
+					(unsigned long)(pm / 10), (unsigned long)(pm % 10));
+		} else
+			sprintf(buf, "%-14.14s", t->name);
+		show(3 + 2 * i, buf);
+		sprintf(buf, " %lu runs %lums", (unsigned long)t->runs,
+				(unsigned long)(t->cycles / CYCLES_PER_MS));
+		show(4 + 2 * i, buf);
+		prev[i] = t->cycles;
+		t = t->next;
+	}
+}
+
+void
+taskview(void)
+{
+	uint32_t prev[TASK_LINES];
+	struct ticker tick;
+	uint32_t last = timer_now();
+
+	dp_fill(0, 0, 240, 240, BG444);
+	buttons_config(buttons);
+	show(0, "Background tasks");
+	taskview_render(prev, 0);
+
+	ticker_start(&tick, 1000, EV_TICK);
+	while (1) {
+		switch ((enum events)event_wait()) {
+		case EV_EXIT:
+			ticker_stop(&tick);
+			return;
+		case EV_BLINK:
+			blink_toggle();
+			taskview_render(prev, 0);
+			break;
+		case EV_TICK: {
+			uint32_t now = timer_now();
+
+			taskview_render(prev, (now - last) & 0xFFFFFFU);
+			last = now;
+			break;
+		}
+		}
+	}
+}
@@ -23,7 +23,10 @@
 #include "geckonator/rtc.h"
 
 #include "events.h"
+#include "work.h"
 #include "timer.h"
+#include "cycles.h"
+#include "latency.h"
 
 static struct timer_node timerlist;
 
@@ -38,10 +41,11 @@ timer_add(struct timer_node *n)
 {
 	uint32_t timeout = n->timeout & 0xFFFFFFU;
 	struct timer_node *p;
+	CYCLES_BEGIN(timer_add);
 
 	n->timeout = timeout;
 
-	__disable_irq();
+	irq_off();
 	for (p = timerlist.prev; p != &timerlist; p = p->prev) {
 		if (!lessthan(timeout, p->timeout))
 			goto insert;
@@ -54,8 +58,8 @@ insert:
 	n->prev = p;
 	p->next->prev = n;
 	p->next = n;
-	__enable_irq();
-
+	irq_on();
+	CYCLES_END(timer_add);
 }
 
 void
@@ -63,17 +67,23 @@ timer_remove(struct timer_node *n)
 {
 	struct timer_node *next;
 
-	__disable_irq();
+	irq_off();
 	next = n->next;
 	if (timerlist.next == n && next != &timerlist)
 		rtc_comp0_set(next->timeout);
 	next->prev = n->prev;
 	n->prev->next = next;
-	__enable_irq();
+	irq_on();
 }
 
-void
-RTC_IRQHandler(void)
+/*
+ * Runs as deferred work, so timer callbacks never
+ * delay other interrupts. Only thread mode code
+ * and other work callbacks touch the timer list,
+ * so it doesn't need interrupts disabled here.
+ */
+static void
+timer_expire(struct work *w)
 {
 	struct timer_node *n;
 
@@ -95,6 +105,20 @@ RTC_IRQHandler(void)
 	rtc_flag_comp0_disable();
 }
 
+static struct work timer_work = {
+	.cb = timer_expire,
+};
+
+void
+RTC_IRQHandler(void)
+{
+	CYCLES_BEGIN(rtc_irq);
+
+	rtc_flag_comp0_clear();
+	work_post(&timer_work);
+	CYCLES_END(rtc_irq);
+}
+
 void
 timer_init(void)
 {
@@ -109,6 +133,12 @@ timer_init(void)
 
 	rtc_config(RTC_ENABLE);
 
+	/* let systick run freely as a cycle counter */
+	SysTick->LOAD = 0xFFFFFFU;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+	latency_init();
+
 	/* enable rtc interrupt */
 	NVIC_SetPriority(RTC_IRQn, 2);
 	NVIC_EnableIRQ(RTC_IRQn);
@@ -146,7 +176,7 @@ ticker_cb(struct timer_node *n)
 {
 	struct ticker *t = (struct ticker *)n;
 
-	event_add(t->ev);
+	event_post(t->ev, 1, EVENT_COALESCE);
 
 	t->n.timeout += t->ms;
 	timer_add(&t->n);
@@ -42,6 +42,14 @@ struct ticker {
 
 static inline uint32_t timer_now(void) { return rtc_counter(); }
 
+/* SysTick counts core clock cycles down from 0xFFFFFF */
+static inline uint32_t timer_cycles(void) { return SysTick->VAL; }
+static inline uint32_t
+timer_cycles_since(uint32_t start)
+{
+	return (start - SysTick->VAL) & 0xFFFFFFU;
+}
+
 void timer_init(void);
 void timer_add(struct timer_node *n);
 void timer_remove(struct timer_node *n);
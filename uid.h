@@ -0,0 +1,44 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UID_H
+#define _UID_H
+
+#include <stdint.h>
+
+#include "geckonator/common.h"
+
+/*
+ * A 16 bit id for telling badges apart over IR, folded
+ * from the whole 64 bit unique number of the chip, as
+ * the low word alone is often the same on chips from one
+ * wafer. Among n badges in range of each other two share
+ * an id with a chance of about n * n / 131072, under 1%
+ * for 35 badges.
+ */
+static inline uint16_t
+uid16(void)
+{
+	uint32_t x = DEVINFO->UNIQUEL ^ (DEVINFO->UNIQUEH * 0x9E3779B1U);
+
+	x ^= x >> 16;
+	x *= 0x85EBCA6BU;
+	return x ^ (x >> 16);
+}
+
+#endif
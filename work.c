@@ -0,0 +1,109 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "geckonator/common.h"
+
+#include "timer.h"
+#include "work.h"
+#include "speed.h"
+#include "latency.h"
+
+/*
+ * Interrupt handlers should only do what can't wait,
+ * and then post a work item. Posted work runs in the
+ * PendSV handler at the lowest interrupt priority, so
+ * it is still run before returning to thread mode but
+ * never holds off another interrupt.
+ */
+
+static struct work *work_head;
+static struct work *work_tail;
+
+void
+work_post(struct work *w)
+{
+	irq_off();
+	if (!w->queued) {
+		w->queued = true;
+		w->posted = timer_cycles();
+		w->switches = speed_switches();
+		w->next = NULL;
+		if (work_tail)
+			work_tail->next = w;
+		else
+			work_head = w;
+		work_tail = w;
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+	irq_on();
+}
+
+static struct work *
+work_pop(void)
+{
+	struct work *w;
+
+	irq_off();
+	w = work_head;
+	if (w) {
+		work_head = w->next;
+		if (work_head == NULL)
+			work_tail = NULL;
+		/* allow the callback to post itself again */
+		w->queued = false;
+	}
+	irq_on();
+	return w;
+}
+
+void
+PendSV_Handler(void)
+{
+	struct work *w;
+
+	while ((w = work_pop())) {
+		uint32_t switches = w->switches;
+		uint32_t start = timer_cycles();
+		uint32_t delay = timer_cycles_since(w->posted);
+		uint32_t run;
+
+		w->cb(w);
+
+		run = timer_cycles_since(start);
+		w->stats.runs += 1;
+		if (speed_switches() != switches)
+			continue;
+		w->stats.timed += 1;
+		w->stats.delay_total += delay;
+		if (delay > w->stats.delay_max)
+			w->stats.delay_max = delay;
+		w->stats.run_total += run;
+		if (run > w->stats.run_max)
+			w->stats.run_max = run;
+	}
+}
+
+void
+work_init(void)
+{
+	NVIC_SetPriority(PendSV_IRQn, 3);
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of badge2019.
+ * Copyright 2019 Emil Renner Berthing <esmil@labitat.dk>
+ *
+ * badge2019 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * badge2019 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with badge2019. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WORK_H
+#define _WORK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct work;
+
+typedef void work_cb(struct work *w);
+
+/*
+ * All times in core clock cycles, see timer_cycles(). Runs
+ * with a clock switch since the post are left out of them.
+ */
+struct work_stats {
+	uint32_t runs;
+	uint32_t timed;
+	uint32_t delay_max;
+	uint32_t delay_total;
+	uint32_t run_max;
+	uint32_t run_total;
+};
+
+struct work {
+	struct work *next;
+	work_cb *cb;
+	uint32_t posted;
+	uint32_t switches;
+	volatile bool queued;
+	struct work_stats stats;
+};
+
+void work_init(void);
+void work_post(struct work *w);
+
+#endif